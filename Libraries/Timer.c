@@ -25,6 +25,54 @@ unsigned char _running = 0;
  */
 volatile unsigned int _timeout_ticks;
 
+#define CLOCKS_PER_MILLI 16000UL // 16MHz system clock
+
+/**
+ * @brief Function registered by timer_fireEvery(), timer_fireOnce() or
+ * timer_fireFor()
+ *
+ */
+static void (*volatile _fire_func)(void) = 0;
+
+/**
+ * @brief ISR handler for TIMER4 that dispatches to the function registered
+ * with one of the timer_fire*() calls
+ *
+ */
+static void timer_fireHandler(void);
+
+/**
+ * @brief Calls left before TIMER4 shuts itself off, negative means forever
+ *
+ */
+static volatile int _fire_remaining = 0;
+
+/**
+ * @brief Configure TIMER4 as a 32-bit periodic countdown and bind the fire
+ * handler. Shared setup for the timer_fire*() functions.
+ *
+ */
+static void timer_fireStart(void (*f)(void), int millis, int times) {
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R4; // Turn on clock to TIMER4
+    while ((SYSCTL_PRTIMER_R & SYSCTL_RCGCTIMER_R4) == 0) {};
+
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;            // Disable TIMER4 for setup
+    _fire_func = f;
+    _fire_remaining = times;
+
+    TIMER4_CFG_R = TIMER_CFG_32_BIT_TIMER;      // Concatenate A and B for 32 bits
+    TIMER4_TAMR_R = TIMER_TAMR_TAMR_PERIOD;     // Periodic, countdown mode
+    TIMER4_TAILR_R = (uint32_t)millis * CLOCKS_PER_MILLI - 1;
+    TIMER4_ICR_R |= TIMER_ICR_TATOCINT;         // Clear timeout interrupt status
+    TIMER4_IMR_R |= TIMER_IMR_TATOIM;           // Allow TIMER4 timeout interrupts
+    NVIC_PRI17_R = (NVIC_PRI17_R & ~NVIC_PRI17_INTC_M) | (7 << NVIC_PRI17_INTC_S); // Priority 7, level with the clock so a long handler never preempts its tick
+    NVIC_EN2_R |= (1 << 6);                     // Enable TIMER4A interrupts (IRQ 70)
+
+    IntRegister(INT_TIMER4A, timer_fireHandler); // Bind the ISR
+    IntMasterEnable();
+    TIMER4_CTL_R |= TIMER_CTL_TAEN;             // Start TIMER4 counting
+}
+
 /**
  * @brief Initialize and start the clock at 0. If the clock is
  * already running on a call, reset the time count back to 0. Uses TIMER5.
@@ -192,6 +240,54 @@ void timer_waitMillis(uint32_t delay_time) {
     }
 }
 
+/**
+ * @brief Sets up an interrupt to call the given function once every given
+ * milliseconds. Uses TIMER4 for the countdown.
+ *
+ * @param f the function to call
+ * @param millis the interval between calls
+ */
+void timer_fireEvery(void (*f)(void), int millis) {
+    timer_fireStart(f, millis, -1);
+}
+
+/**
+ * @brief Sets up an interrupt to call the given function after the given number
+ * of milliseconds. Uses TIMER4 for the countdown.
+ *
+ * @param f the function to call
+ * @param millis milliseconds until call
+ */
+void timer_fireOnce(void (*f)(void), int millis) {
+    timer_fireStart(f, millis, 1);
+}
+
+/**
+ * @brief Sets up an interrupt to call the given function after the given number
+ * of milliseconds for the given number of times. Uses TIMER4 for the countdown.
+ *
+ * @param f the function to call
+ * @param millis milliseconds until call
+ * @param times number of times to call f
+ */
+void timer_fireFor(void (*f)(void), int millis, int times) {
+    if (times > 0) {
+        timer_fireStart(f, millis, times);
+    }
+}
+
+/**
+ * @brief Cancels any pending timer_fire*() call and turns off TIMER4.
+ *
+ */
+void timer_fireStop(void) {
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;    // Disable TIMER4
+    TIMER4_IMR_R &= ~TIMER_IMR_TATOIM;  // Mask TIMER4 timeout interrupts
+    TIMER4_ICR_R |= TIMER_ICR_TATOCINT; // Drop anything pending
+    _fire_remaining = 0;
+    _fire_func = 0;
+}
+
 /**
  * @brief ISR handler to increment the timeout variable for tracking total
  * milliseconds
@@ -201,3 +297,21 @@ static void timer_clockTickHandler() {
     TIMER5_ICR_R |= TIMER_ICR_TATOCINT; // Clear interrupt flag
     _timeout_ticks++;
 }
+
+/**
+ * @brief ISR handler for TIMER4 that dispatches to the function registered
+ * with one of the timer_fire*() calls
+ *
+ */
+static void timer_fireHandler(void) {
+    void (*f)(void) = _fire_func;
+    TIMER4_ICR_R |= TIMER_ICR_TATOCINT; // Clear interrupt flag
+
+    if (_fire_remaining > 0 && --_fire_remaining == 0) {
+        TIMER4_CTL_R &= ~TIMER_CTL_TAEN; // Last call, stop counting
+    }
+
+    if (f) {
+        f();
+    }
+}
@@ -70,19 +70,19 @@ void timer_waitMillis(unsigned int delay_time);
  */
 void timer_waitMicros(unsigned int delay_time);
 
-// TODO: Implement
 /**
  * @brief Sets up an interrupt to call the given function once every given
  * milliseconds. Uses TIMER4 for the countdown. Function f executes inside an
  * ISR, so keep the passed function as short as possible. Maximum interval time
- * is TODO: calculate
+ * is 268435ms (32 bit count at 16MHz). The interrupt runs at the lowest
+ * priority, level with the clock, so UART1 and the ping sensor still get in
+ * while f runs.
  *
  * @param f the function to call
  * @param millis the interval between calls
  */
 void timer_fireEvery(void (*f)(void), int millis);
 
-// TODO: Implement
 /**
  * @brief Sets up an interrupt to call the given function after the given number
  * of milliseconds. Uses TIMER4 for the countdown, and thus can only be used
@@ -94,13 +94,12 @@ void timer_fireEvery(void (*f)(void), int millis);
  */
 void timer_fireOnce(void (*f)(void), int millis);
 
-// TODO: Implement
 /**
  * @brief Sets up an interrupt to call the given function after the given number
  * of milliseconds for the given number of times. Uses TIMER4 for the countdown,
  * and thus can only be used when fireOnce() and fireEvery() are not being used.
  * Function f executes inside an ISR and should be kept as short as possible.
- * Maximum interval time is TODO: calculate
+ * Maximum interval time is 268435ms (32 bit count at 16MHz).
  *
  * @param f the function to call
  * @param millis milliseconds until call
@@ -108,6 +107,13 @@ void timer_fireOnce(void (*f)(void), int millis);
  */
 void timer_fireFor(void (*f)(void), int millis, int times);
 
+/**
+ * @brief Cancels any pending timer_fireEvery(), timer_fireOnce() or
+ * timer_fireFor() and turns off TIMER4.
+ *
+ */
+void timer_fireStop(void);
+
 /**
  * @brief ISR handler to increment the timeout variable for tracking total
  * milliseconds
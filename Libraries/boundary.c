@@ -0,0 +1,266 @@
+/**
+ * Boundary tape and cliff map from cliff sensor hits
+ * @file boundary.c
+ */
+
+#include <math.h>
+#include "boundary.h"
+
+/// A segment with the hits it was fitted through
+typedef struct {
+    boundary_segment_t seg;
+    float hitX[BOUNDARY_MAX_HITS];
+    float hitY[BOUNDARY_MAX_HITS];
+    int numHits;        // hits kept, the oldest is overwritten once full
+    int nextHit;
+    float cx;           // centre of the kept hits
+    float cy;
+    float dirX;         // unit vector along the segment
+    float dirY;
+    float lo;           // furthest hits either way along it from the centre
+    float hi;
+} boundary_line_t;
+
+static boundary_line_t lines[BOUNDARY_MAX_SEGMENTS];
+static int numLines = 0;
+static uint32_t version = 0;
+
+void boundary_clear(void) {
+    numLines = 0;
+    version++;
+}
+
+/**
+ * Refit a segment after its hits change
+ */
+static void boundary_fit(boundary_line_t *l) {
+    int i;
+    float sxx = 0;
+    float sxy = 0;
+    float syy = 0;
+
+    l->cx = 0;
+    l->cy = 0;
+    for (i = 0; i < l->numHits; i++) {
+        l->cx += l->hitX[i];
+        l->cy += l->hitY[i];
+    }
+    l->cx /= l->numHits;
+    l->cy /= l->numHits;
+
+    //Take the direction the hits spread out along once there is enough spread to tell, otherwise
+    //keep the one from the first hit
+    if (l->numHits >= 2) {
+        for (i = 0; i < l->numHits; i++) {
+            float dx = l->hitX[i] - l->cx;
+            float dy = l->hitY[i] - l->cy;
+            sxx += dx * dx;
+            sxy += dx * dy;
+            syy += dy * dy;
+        }
+        float axis = 0.5f * atan2f(2.0f * sxy, sxx - syy);
+        float ax = cosf(axis);
+        float ay = sinf(axis);
+        float lo = 0;
+        float hi = 0;
+        for (i = 0; i < l->numHits; i++) {
+            float along = (l->hitX[i] - l->cx) * ax + (l->hitY[i] - l->cy) * ay;
+            lo = along < lo ? along : lo;
+            hi = along > hi ? along : hi;
+        }
+        if (hi - lo >= BOUNDARY_FIT_SPREAD_MM) {
+            l->dirX = ax;
+            l->dirY = ay;
+        }
+    }
+
+    l->lo = 0;
+    l->hi = 0;
+    for (i = 0; i < l->numHits; i++) {
+        float along = (l->hitX[i] - l->cx) * l->dirX + (l->hitY[i] - l->cy) * l->dirY;
+        l->lo = along < l->lo ? along : l->lo;
+        l->hi = along > l->hi ? along : l->hi;
+    }
+    l->seg.x0 = l->cx + l->dirX * (l->lo - BOUNDARY_HIT_HALF_MM);
+    l->seg.y0 = l->cy + l->dirY * (l->lo - BOUNDARY_HIT_HALF_MM);
+    l->seg.x1 = l->cx + l->dirX * (l->hi + BOUNDARY_HIT_HALF_MM);
+    l->seg.y1 = l->cy + l->dirY * (l->hi + BOUNDARY_HIT_HALF_MM);
+}
+
+int boundary_addHit(const pose_t *pose, int leftSide, int isCliff) {
+    int i;
+    int best = -1;
+    int known = 0;
+    float bestOff = BOUNDARY_LINE_MM;
+
+    //Where the sensor was
+    float c = cosf(pose->theta);
+    float s = sinf(pose->theta);
+    float side = leftSide ? BOUNDARY_SENSOR_SIDE_MM : -BOUNDARY_SENSOR_SIDE_MM;
+    float x = pose->x + c * BOUNDARY_SENSOR_FWD_MM - s * side;
+    float y = pose->y + s * BOUNDARY_SENSOR_FWD_MM + c * side;
+
+    for (i = 0; i < numLines; i++) {
+        boundary_line_t *l = &lines[i];
+        if (l->seg.isCliff != isCliff) {
+            continue;
+        }
+        float along = (x - l->cx) * l->dirX + (y - l->cy) * l->dirY;
+        float off = fabsf(-(x - l->cx) * l->dirY + (y - l->cy) * l->dirX);
+        if (off < bestOff && along > l->lo - BOUNDARY_HIT_HALF_MM - BOUNDARY_JOIN_MM &&
+            along < l->hi + BOUNDARY_HIT_HALF_MM + BOUNDARY_JOIN_MM) {
+            bestOff = off;
+            best = i;
+            known = along >= l->lo - BOUNDARY_HIT_HALF_MM && along <= l->hi + BOUNDARY_HIT_HALF_MM;
+        }
+    }
+
+    boundary_line_t *l;
+    if (best >= 0) {
+        l = &lines[best];
+    }
+    else {
+        //A new stretch, pushing out the one run into least if there's no room
+        if (numLines < BOUNDARY_MAX_SEGMENTS) {
+            best = numLines++;
+        }
+        else {
+            best = 0;
+            for (i = 1; i < numLines; i++) {
+                if (lines[i].seg.hits < lines[best].seg.hits) {
+                    best = i;
+                }
+            }
+        }
+        l = &lines[best];
+        l->numHits = 0;
+        l->nextHit = 0;
+        l->seg.hits = 0;
+        l->seg.isCliff = isCliff;
+        //Until there's a second hit assume it runs across the way we were going
+        l->dirX = -s;
+        l->dirY = c;
+    }
+
+    l->hitX[l->nextHit] = x;
+    l->hitY[l->nextHit] = y;
+    l->nextHit = (l->nextHit + 1) % BOUNDARY_MAX_HITS;
+    if (l->numHits < BOUNDARY_MAX_HITS) {
+        l->numHits++;
+    }
+    l->seg.hits++;
+    boundary_fit(l);
+    version++;
+    return known;
+}
+
+float boundary_distance(float x, float y) {
+    int i;
+    float best = 1.0e9f;
+
+    for (i = 0; i < numLines; i++) {
+        const boundary_segment_t *seg = &lines[i].seg;
+        float sx = seg->x1 - seg->x0;
+        float sy = seg->y1 - seg->y0;
+        float len2 = sx * sx + sy * sy;
+        float t = len2 > 0 ? ((x - seg->x0) * sx + (y - seg->y0) * sy) / len2 : 0;
+        t = t < 0 ? 0 : t > 1 ? 1 : t;
+        float dx = x - (seg->x0 + t * sx);
+        float dy = y - (seg->y0 + t * sy);
+        float d = sqrtf(dx * dx + dy * dy);
+        if (d < best) {
+            best = d;
+        }
+    }
+    return best;
+}
+
+float boundary_clearance(float x, float y, float heading, float halfWidth, float maxRange) {
+    int i;
+    float best = maxRange;
+    float c = cosf(heading);
+    float s = sinf(heading);
+
+    for (i = 0; i < numLines; i++) {
+        const boundary_segment_t *seg = &lines[i].seg;
+
+        //Ends of the segment as distance along the lane and off to the side of it
+        float a0 = (seg->x0 - x) * c + (seg->y0 - y) * s;
+        float c0 = -(seg->x0 - x) * s + (seg->y0 - y) * c;
+        float a1 = (seg->x1 - x) * c + (seg->y1 - y) * s;
+        float c1 = -(seg->x1 - x) * s + (seg->y1 - y) * c;
+
+        //The part of it inside the lane
+        float t0 = 0;
+        float t1 = 1;
+        float dc = c1 - c0;
+        if (fabsf(dc) < 0.001f) {
+            if (fabsf(c0) > halfWidth) {
+                continue;
+            }
+        }
+        else {
+            float ta = (-halfWidth - c0) / dc;
+            float tb = (halfWidth - c0) / dc;
+            if (ta > tb) {
+                float tmp = ta;
+                ta = tb;
+                tb = tmp;
+            }
+            t0 = ta > 0 ? ta : 0;
+            t1 = tb < 1 ? tb : 1;
+            if (t0 > t1) {
+                continue;
+            }
+        }
+
+        float aStart = a0 + (a1 - a0) * t0;
+        float aEnd = a0 + (a1 - a0) * t1;
+        if (aStart < 0 && aEnd < 0) {
+            continue;
+        }
+        float along = aStart < aEnd ? aStart : aEnd;
+        if (along < 0) {
+            along = 0;
+        }
+        if (along < best) {
+            best = along;
+        }
+    }
+    return best;
+}
+
+void boundary_applyToSweep(int scan[181][2], const pose_t *scanPose) {
+    int a;
+    if (numLines == 0) {
+        return;
+    }
+
+    for (a = 0; a <= 180; a += 2) {
+        int r = scan[a][0];
+        if (r <= 0) {
+            continue;
+        }
+        float heading = scanPose->theta + (a - 90) * DEG_TO_RAD;
+        float d = boundary_clearance(scanPose->x, scanPose->y, heading, BOUNDARY_BEAM_HALF_MM, r * 10.0f);
+        if (d < r * 10.0f) {
+            scan[a][0] = d < 10.0f ? 1 : (int)(d / 10.0f);
+        }
+    }
+}
+
+int boundary_count(void) {
+    return numLines;
+}
+
+int boundary_get(int i, boundary_segment_t *out) {
+    if (i < 0 || i >= numLines) {
+        return 0;
+    }
+    *out = lines[i].seg;
+    return 1;
+}
+
+uint32_t boundary_version(void) {
+    return version;
+}
@@ -0,0 +1,116 @@
+/**
+ * Boundary tape and cliff map from cliff sensor hits
+ * @file boundary.h
+ *
+ * PING and IR look straight over the tape, so the only way to know where the
+ * course boundary is, is to have run into it. Every tape or cliff hit is put
+ * on the floor in the odometry frame where the cliff sensor that saw it was,
+ * and hits that line up are grouped into straight segments. A lone hit is
+ * taken as a short stretch across the way we were heading; with two or more
+ * far enough apart the segment is fitted through them.
+ *
+ * The segments are hard limits for everything that decides where to go: the
+ * planner blocks nodes near them, the speed scheduler counts them as
+ * obstacles, and boundary_applyToSweep() folds them into a sweep so the local
+ * steering and recovery turns keep off them too.
+ */
+
+#ifndef BOUNDARY_H_
+#define BOUNDARY_H_
+
+#include <stdint.h>
+#include "odometry.h"
+
+/// Segments remembered, and hits kept per segment to fit it through
+#define BOUNDARY_MAX_SEGMENTS 12
+#define BOUNDARY_MAX_HITS 6
+
+/// Cliff sensor position relative to the robot centre, mm. The side offset is positive to the left
+#define BOUNDARY_SENSOR_FWD_MM 140.0f
+#define BOUNDARY_SENSOR_SIDE_MM 110.0f
+
+/// A lone hit stands for this much tape either side of it, mm
+#define BOUNDARY_HIT_HALF_MM 150.0f
+/// A hit this close to a segment's line, mm...
+#define BOUNDARY_LINE_MM 120.0f
+/// ...and no further than this past either end of it belongs to it, mm
+#define BOUNDARY_JOIN_MM 500.0f
+/// Hits have to be spread this far along a segment before its direction is fitted through them, mm
+#define BOUNDARY_FIT_SPREAD_MM 200.0f
+
+/// Width of the beam used to fold segments into a sweep, mm
+#define BOUNDARY_BEAM_HALF_MM 25.0f
+
+/// A stretch of boundary in the odometry frame
+typedef struct {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    int isCliff;    // 1 for a drop, 0 for tape
+    int hits;       // times it has been run into
+} boundary_segment_t;
+
+/**
+ * @brief Forget every segment
+ */
+void boundary_clear(void);
+
+/**
+ * @brief Record a tape or cliff hit
+ *
+ * @param pose robot pose when the hit was seen
+ * @param leftSide 1 if the left cliff sensors saw it, 0 for the right
+ * @param isCliff 1 for a drop, 0 for tape
+ * @return 1 if the hit was on a boundary we already knew about
+ */
+int boundary_addHit(const pose_t *pose, int leftSide, int isCliff);
+
+/**
+ * @brief Distance to the nearest boundary
+ *
+ * @param x position in the odometry frame, mm
+ * @param y position in the odometry frame, mm
+ * @return distance in mm, a very large value if no boundary is known
+ */
+float boundary_distance(float x, float y);
+
+/**
+ * @brief How far a lane of the given half width can run along a heading before it meets a boundary
+ *
+ * @param x start of the lane in the odometry frame, mm
+ * @param y start of the lane in the odometry frame, mm
+ * @param heading direction of the lane, radians
+ * @param halfWidth half the lane width, mm
+ * @param maxRange returned if nothing is met nearer, mm
+ * @return free length in mm, 0 if a boundary is already in the lane beside us
+ */
+float boundary_clearance(float x, float y, float heading, float halfWidth, float maxRange);
+
+/**
+ * @brief Shorten sweep readings that reach past a known boundary, so anything steering off the sweep stays
+ * inside the course. Only sampled angles (PING above 0) are touched.
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm
+ * @param scanPose where the sweep was taken from
+ */
+void boundary_applyToSweep(int scan[181][2], const pose_t *scanPose);
+
+/**
+ * @return number of known segments
+ */
+int boundary_count(void);
+
+/**
+ * @param i segment index
+ * @param out filled with the segment
+ * @return 1 if i was a segment, 0 if not
+ */
+int boundary_get(int i, boundary_segment_t *out);
+
+/**
+ * @return a number that changes every time the segments do, so users can tell when to rebuild from them
+ */
+uint32_t boundary_version(void);
+
+#endif /* BOUNDARY_H_ */
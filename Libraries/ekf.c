@@ -0,0 +1,322 @@
+/**
+ * EKF-SLAM over compact landmarks
+ * @file ekf.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "ekf.h"
+
+//State is [x, y, theta, l0x, l0y, l1x, l1y, ...] and P its covariance
+static float mu[EKF_MAX_STATE];
+static float P[EKF_MAX_STATE][EKF_MAX_STATE];
+static int numLandmarks;
+static int isPost[EKF_MAX_LANDMARKS];
+static int sightings[EKF_MAX_LANDMARKS];
+//Odometry pose the filter was last brought up to
+static pose_t lastOdom;
+
+void ekf_init(const pose_t *odom) {
+    memset(mu, 0, sizeof(mu));
+    memset(P, 0, sizeof(P));
+    numLandmarks = 0;
+
+    mu[0] = odom->x;
+    mu[1] = odom->y;
+    mu[2] = odom->theta;
+    lastOdom = *odom;
+}
+
+void ekf_predict(const pose_t *odom) {
+    int n = 3 + 2 * numLandmarks;
+    int i, j;
+
+    //Odometry's motion since last time, in the robot's frame so it can be replayed from our own pose
+    float c0 = cosf(lastOdom.theta);
+    float s0 = sinf(lastOdom.theta);
+    float ox = odom->x - lastOdom.x;
+    float oy = odom->y - lastOdom.y;
+    float fwd = c0 * ox + s0 * oy;
+    float side = -s0 * ox + c0 * oy;
+    float dth = odom_wrapAngle(odom->theta - lastOdom.theta);
+    lastOdom = *odom;
+
+    float c = cosf(mu[2]);
+    float s = sinf(mu[2]);
+    float dx = c * fwd - s * side;
+    float dy = s * fwd + c * side;
+    mu[0] += dx;
+    mu[1] += dy;
+    mu[2] = odom_wrapAngle(mu[2] + dth);
+
+    //Only the robot rows change, F = [1 0 -dy; 0 1 dx; 0 0 1]. Row ops then column ops give F P F'
+    for (j = 0; j < n; j++) {
+        P[0][j] -= dy * P[2][j];
+        P[1][j] += dx * P[2][j];
+    }
+    for (i = 0; i < n; i++) {
+        P[i][0] -= dy * P[i][2];
+        P[i][1] += dx * P[i][2];
+    }
+
+    float dist = sqrtf(fwd * fwd + side * side);
+    P[0][0] += EKF_Q_XY_PER_MM * dist;
+    P[1][1] += EKF_Q_XY_PER_MM * dist;
+    P[2][2] += EKF_Q_THETA_PER_MM * dist + EKF_Q_THETA_PER_RAD * fabsf(dth);
+}
+
+/**
+ * Predicted range and bearing to landmark id, and the non-zero parts of the
+ * measurement jacobian: Hr against the robot pose and Hl against the landmark
+ */
+static void ekf_expected(int id, float z[2], float Hr[2][3], float Hl[2][2]) {
+    float dx = mu[3 + 2 * id] - mu[0];
+    float dy = mu[4 + 2 * id] - mu[1];
+    float q = dx * dx + dy * dy;
+    if (q < 1.0f) {
+        q = 1.0f;
+    }
+    float r = sqrtf(q);
+
+    z[0] = r;
+    z[1] = odom_wrapAngle(atan2f(dy, dx) - mu[2]);
+
+    Hr[0][0] = -dx / r;
+    Hr[0][1] = -dy / r;
+    Hr[0][2] = 0;
+    Hr[1][0] = dy / q;
+    Hr[1][1] = -dx / q;
+    Hr[1][2] = -1;
+    Hl[0][0] = dx / r;
+    Hl[0][1] = dy / r;
+    Hl[1][0] = -dy / q;
+    Hl[1][1] = dx / q;
+}
+
+/**
+ * P H' for landmark id, using only the columns of H that are non-zero
+ */
+static void ekf_PHt(int id, float Hr[2][3], float Hl[2][2], float PHt[][2]) {
+    int n = 3 + 2 * numLandmarks;
+    int l = 3 + 2 * id;
+    int i, k;
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < 2; k++) {
+            PHt[i][k] = P[i][0] * Hr[k][0] + P[i][1] * Hr[k][1] + P[i][2] * Hr[k][2]
+                      + P[i][l] * Hl[k][0] + P[i][l + 1] * Hl[k][1];
+        }
+    }
+}
+
+static void ekf_addLandmark(float range_mm, float bearing, int post) {
+    int n = 3 + 2 * numLandmarks;
+    int l = n;
+    int i, j;
+    float a = mu[2] + bearing;
+    float ca = cosf(a);
+    float sa = sinf(a);
+
+    mu[l] = mu[0] + range_mm * ca;
+    mu[l + 1] = mu[1] + range_mm * sa;
+
+    //New landmark = robot position + polar offset. Gr is its jacobian against the robot, Gz against the sighting
+    float Gr[2][3] = {{1, 0, -range_mm * sa}, {0, 1, range_mm * ca}};
+    float Gz[2][2] = {{ca, -range_mm * sa}, {sa, range_mm * ca}};
+
+    //Cross covariance with everything already in the state, Gr * P[robot rows]
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < 2; i++) {
+            P[l + i][j] = Gr[i][0] * P[0][j] + Gr[i][1] * P[1][j] + Gr[i][2] * P[2][j];
+            P[j][l + i] = P[l + i][j];
+        }
+    }
+    //Own covariance, Gr P_rr Gr' + Gz R Gz'
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 2; j++) {
+            P[l + i][l + j] = P[l + i][0] * Gr[j][0] + P[l + i][1] * Gr[j][1] + P[l + i][2] * Gr[j][2]
+                            + Gz[i][0] * Gz[j][0] * EKF_R_RANGE + Gz[i][1] * Gz[j][1] * EKF_R_BEARING;
+        }
+    }
+
+    isPost[numLandmarks] = post;
+    sightings[numLandmarks] = 1;
+    numLandmarks++;
+}
+
+/**
+ * Forget landmark id. Dropping its rows and columns from the state and P is all marginalising it out takes, the
+ * landmarks after it move down one
+ */
+static void ekf_removeLandmark(int id) {
+    int n = 3 + 2 * numLandmarks;
+    int l = 3 + 2 * id;
+    int i, j;
+
+    for (i = l; i < n - 2; i++) {
+        mu[i] = mu[i + 2];
+    }
+    for (i = 0; i < n; i++) {
+        for (j = l; j < n - 2; j++) {
+            P[i][j] = P[i][j + 2];
+        }
+    }
+    for (i = l; i < n - 2; i++) {
+        for (j = 0; j < n - 2; j++) {
+            P[i][j] = P[i + 2][j];
+        }
+    }
+    for (i = id; i < numLandmarks - 1; i++) {
+        isPost[i] = isPost[i + 1];
+        sightings[i] = sightings[i + 1];
+    }
+    numLandmarks--;
+}
+
+/**
+ * Make room for a new landmark when the state is full. A post is worth more than any other landmark, so it pushes
+ * out the least seen of those. Anything else only pushes out something that was seen once and never again
+ * @return 1 if there is room now
+ */
+static int ekf_makeRoom(int post) {
+    int id;
+    int worst = -1;
+    if (numLandmarks < EKF_MAX_LANDMARKS) {
+        return 1;
+    }
+    for (id = 0; id < numLandmarks; id++) {
+        if (!isPost[id] && (worst < 0 || sightings[id] < sightings[worst])) {
+            worst = id;
+        }
+    }
+    if (worst < 0 || (!post && sightings[worst] > 1)) {
+        return 0;
+    }
+    ekf_removeLandmark(worst);
+    return 1;
+}
+
+int ekf_observe(float range_mm, float bearing, int post) {
+    float PHt[EKF_MAX_STATE][2];
+    float z[2], Hr[2][3], Hl[2][2];
+    int id;
+    int best = -1;
+    float bestD2 = 0;
+
+    //Associate with whichever landmark the sighting is statistically closest to
+    for (id = 0; id < numLandmarks; id++) {
+        ekf_expected(id, z, Hr, Hl);
+        ekf_PHt(id, Hr, Hl, PHt);
+        int l = 3 + 2 * id;
+        float s00 = EKF_R_RANGE, s01 = 0, s11 = EKF_R_BEARING;
+        int k;
+        for (k = 0; k < 3; k++) {
+            s00 += Hr[0][k] * PHt[k][0];
+            s01 += Hr[0][k] * PHt[k][1];
+            s11 += Hr[1][k] * PHt[k][1];
+        }
+        s00 += Hl[0][0] * PHt[l][0] + Hl[0][1] * PHt[l + 1][0];
+        s01 += Hl[0][0] * PHt[l][1] + Hl[0][1] * PHt[l + 1][1];
+        s11 += Hl[1][0] * PHt[l][1] + Hl[1][1] * PHt[l + 1][1];
+
+        float v0 = range_mm - z[0];
+        float v1 = odom_wrapAngle(bearing - z[1]);
+        float det = s00 * s11 - s01 * s01;
+        if (det <= 0) {
+            continue;
+        }
+        float d2 = (v0 * v0 * s11 - 2 * v0 * v1 * s01 + v1 * v1 * s00) / det;
+        if (best < 0 || d2 < bestD2) {
+            best = id;
+            bestD2 = d2;
+        }
+    }
+
+    if (best < 0 || bestD2 > EKF_NEW_GATE) {
+        if (!ekf_makeRoom(post)) {
+            return -1;
+        }
+        ekf_addLandmark(range_mm, bearing, post);
+        return numLandmarks - 1;
+    }
+    if (bestD2 > EKF_GATE) {
+        return -1;
+    }
+
+    //Standard update against the matched landmark, K = P H' S^-1 and P -= K (P H')'
+    int n = 3 + 2 * numLandmarks;
+    int l = 3 + 2 * best;
+    int i, j, k;
+    ekf_expected(best, z, Hr, Hl);
+    ekf_PHt(best, Hr, Hl, PHt);
+
+    float S[2][2] = {{EKF_R_RANGE, 0}, {0, EKF_R_BEARING}};
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 2; j++) {
+            for (k = 0; k < 3; k++) {
+                S[i][j] += Hr[i][k] * PHt[k][j];
+            }
+            S[i][j] += Hl[i][0] * PHt[l][j] + Hl[i][1] * PHt[l + 1][j];
+        }
+    }
+    float det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+    float Si[2][2] = {{S[1][1] / det, -S[0][1] / det}, {-S[1][0] / det, S[0][0] / det}};
+    float v[2] = {range_mm - z[0], odom_wrapAngle(bearing - z[1])};
+
+    float K[EKF_MAX_STATE][2];
+    for (i = 0; i < n; i++) {
+        K[i][0] = PHt[i][0] * Si[0][0] + PHt[i][1] * Si[1][0];
+        K[i][1] = PHt[i][0] * Si[0][1] + PHt[i][1] * Si[1][1];
+        mu[i] += K[i][0] * v[0] + K[i][1] * v[1];
+    }
+    mu[2] = odom_wrapAngle(mu[2]);
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            P[i][j] -= K[i][0] * PHt[j][0] + K[i][1] * PHt[j][1];
+        }
+    }
+
+    if (post) {
+        isPost[best] = 1;
+    }
+    sightings[best]++;
+    return best;
+}
+
+void ekf_applyToOdometry(void) {
+    float xyVariance = P[0][0] > P[1][1] ? P[0][0] : P[1][1];
+    odom_correct(mu[0] - lastOdom.x, mu[1] - lastOdom.y, odom_wrapAngle(mu[2] - lastOdom.theta), xyVariance, P[2][2]);
+
+    //Odometry now agrees with us, so the next prediction starts from here
+    lastOdom.x = mu[0];
+    lastOdom.y = mu[1];
+    lastOdom.theta = mu[2];
+}
+
+int ekf_numLandmarks(void) {
+    return numLandmarks;
+}
+
+int ekf_getLandmark(int id, ekf_landmark_t *out) {
+    if (id < 0 || id >= numLandmarks) {
+        return 0;
+    }
+    out->x = mu[3 + 2 * id];
+    out->y = mu[4 + 2 * id];
+    out->isPost = isPost[id];
+    out->sightings = sightings[id];
+    return 1;
+}
+
+void ekf_getPose(pose_t *out) {
+    int i, j;
+    out->x = mu[0];
+    out->y = mu[1];
+    out->theta = mu[2];
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            out->cov[i][j] = P[i][j];
+        }
+    }
+    out->updates = lastOdom.updates;
+}
@@ -0,0 +1,101 @@
+/**
+ * EKF-SLAM over compact landmarks
+ * @file ekf.h
+ *
+ * Keeps one joint estimate of the robot pose and up to EKF_MAX_LANDMARKS
+ * landmark positions, with a full covariance between all of them. Skinny
+ * posts and other narrow objects from findObjects() are the landmarks: once
+ * one has been seen its position is remembered across sweeps, and every time
+ * it is seen again both it and the robot pose are pulled into line.
+ *
+ * The filter runs once per sweep from the main loop. Motion between sweeps is
+ * taken from odometry (ekf_predict()) and the corrected pose is pushed back
+ * into odometry afterwards (ekf_applyToOdometry()), so everything else keeps
+ * reading the pose from odom_getPose().
+ */
+
+#ifndef EKF_H_
+#define EKF_H_
+
+#include "odometry.h"
+
+/// Landmarks kept, the state is 3 + 2 * this long
+#define EKF_MAX_LANDMARKS 6
+#define EKF_MAX_STATE (3 + 2 * EKF_MAX_LANDMARKS)
+
+/// Motion noise added per mm driven, mm^2 and rad^2, and per radian turned, rad^2
+#define EKF_Q_XY_PER_MM 1.0f
+#define EKF_Q_THETA_PER_MM 0.000004f
+#define EKF_Q_THETA_PER_RAD 0.003f
+/// Measurement noise, range in mm^2 (5cm) and bearing in rad^2 (4 degrees)
+#define EKF_R_RANGE 2500.0f
+#define EKF_R_BEARING 0.005f
+
+/// Squared Mahalanobis distance under which a sighting is the same landmark (99% for 2 DOF)
+#define EKF_GATE 9.21f
+/// Squared Mahalanobis distance over which a sighting is a new landmark; in between is too ambiguous to use
+#define EKF_NEW_GATE 25.0f
+
+/// A remembered landmark
+typedef struct {
+    float x;            // mm
+    float y;            // mm
+    int isPost;         // 1 for the skinny posts around the parking zone
+    int sightings;      // times it has been seen, including the first
+} ekf_landmark_t;
+
+/**
+ * @brief Forget all landmarks and start from the odometry pose
+ *
+ * @param odom current odometry pose
+ */
+void ekf_init(const pose_t *odom);
+
+/**
+ * @brief Move the robot estimate by however far odometry says we've come
+ * since the last call, growing its uncertainty to match
+ *
+ * @param odom current odometry pose
+ */
+void ekf_predict(const pose_t *odom);
+
+/**
+ * @brief Fold in one sighting of a compact object. It is matched to the
+ * closest remembered landmark if one is close enough, otherwise it becomes a
+ * new landmark. When all EKF_MAX_LANDMARKS are taken a post forgets the least
+ * seen landmark that isn't a post, and anything else forgets one only seen
+ * once. Forgetting a landmark moves the ids after it down one.
+ *
+ * @param range_mm distance from the robot centre to the object's centre
+ * @param bearing heading from the robot to the object in radians, positive is left
+ * @param isPost 1 if the object looks like one of the parking zone's skinny posts
+ * @return id of the landmark updated or added, -1 if the sighting was not used
+ */
+int ekf_observe(float range_mm, float bearing, int isPost);
+
+/**
+ * @brief Move odometry onto the filter's pose estimate. Call after the
+ * sightings from a sweep have been folded in.
+ */
+void ekf_applyToOdometry(void);
+
+/**
+ * @return number of landmarks remembered
+ */
+int ekf_numLandmarks(void);
+
+/**
+ * @brief Read back a remembered landmark
+ *
+ * @param id landmark index, 0 to ekf_numLandmarks() - 1
+ * @param out filled with the landmark
+ * @return 1 if id exists, 0 if not
+ */
+int ekf_getLandmark(int id, ekf_landmark_t *out);
+
+/**
+ * @param out filled with the filter's robot pose and its covariance
+ */
+void ekf_getPose(pose_t *out);
+
+#endif /* EKF_H_ */
@@ -0,0 +1,124 @@
+/**
+ * Frontier exploration over the occupancy grid
+ * @file explore.c
+ */
+
+#include "explore.h"
+#include "grid.h"
+#include "plan.h"
+
+#define BIT_GET(a, i) ((a)[(i) >> 3] & (1 << ((i) & 7)))
+#define BIT_SET(a, i) ((a)[(i) >> 3] |= (uint8_t)(1 << ((i) & 7)))
+
+static int goal = -1;
+/// Goals given up on or already swept from. Unknown space a sweep from there didn't fill in, like the inside of a box, won't fill in next time either
+static uint8_t skipped[PLAN_NODES / 8];
+
+/**
+ * A map cell nothing has touched yet. Off the map doesn't count, there's nothing to find there
+ */
+static int explore_isUnknown(int cx, int cy) {
+    if (cx < 0 || cx >= GRID_SIZE_X || cy < 0 || cy >= GRID_SIZE_Y) {
+        return 0;
+    }
+    return grid_get(cx, cy) == 0;
+}
+
+/**
+ * A map cell a ping has passed through. One sweep is a single miss, well short of grid_isFree(), so
+ * waiting for that would leave no frontier anywhere but the few cells around the robot
+ */
+static int explore_isSeen(int cx, int cy) {
+    return grid_get(cx, cy) < 0;
+}
+
+static int explore_isFrontier(int node) {
+    int cx, cy;
+    if (plan_isBlocked(node)) {
+        return 0;
+    }
+
+    int x0 = (node % PLAN_SIZE_X) * PLAN_SCALE;
+    int y0 = (node / PLAN_SIZE_X) * PLAN_SCALE;
+    for (cy = y0; cy < y0 + PLAN_SCALE; cy++) {
+        for (cx = x0; cx < x0 + PLAN_SCALE; cx++) {
+            if (explore_isSeen(cx, cy) && (explore_isUnknown(cx + 1, cy) || explore_isUnknown(cx - 1, cy) ||
+                                        explore_isUnknown(cx, cy + 1) || explore_isUnknown(cx, cy - 1))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Unknown map cells a sweep from this node could fill in
+ */
+static int explore_gain(int node) {
+    int cx, cy;
+    int gain = 0;
+    int reach = EXPLORE_GAIN_RADIUS * PLAN_SCALE;
+    int mx = (node % PLAN_SIZE_X) * PLAN_SCALE + PLAN_SCALE / 2;
+    int my = (node / PLAN_SIZE_X) * PLAN_SCALE + PLAN_SCALE / 2;
+
+    for (cy = my - reach; cy < my + reach; cy++) {
+        for (cx = mx - reach; cx < mx + reach; cx++) {
+            gain += explore_isUnknown(cx, cy);
+        }
+    }
+    return gain;
+}
+
+int explore_update(const pose_t *now, float *gx, float *gy) {
+    int n;
+
+    //Stick with the goal we have until we get there or the map fills it in
+    if (goal >= 0) {
+        plan_nodeToWorld(goal, gx, gy);
+        float dx = *gx - now->x;
+        float dy = *gy - now->y;
+        if (!explore_isFrontier(goal)) {
+            goal = -1;
+        } else if (dx * dx + dy * dy > (float)EXPLORE_REACHED_MM * EXPLORE_REACHED_MM) {
+            return EXPLORE_SAME;
+        } else {
+            BIT_SET(skipped, goal);
+            goal = -1;
+        }
+    }
+
+    if (plan_costFrom(now->x, now->y) == PLAN_OFF_MAP) {
+        return EXPLORE_NONE;
+    }
+
+    //Best unknown space per unit of travel
+    int32_t bestScore = 0;
+    for (n = 0; n < PLAN_NODES; n++) {
+        uint16_t cost = plan_costTo(n);
+        if (cost == 0xFFFF || cost < EXPLORE_MIN_COST || BIT_GET(skipped, n) || !explore_isFrontier(n)) {
+            continue;
+        }
+        int gain = explore_gain(n);
+        if (gain < EXPLORE_MIN_GAIN) {
+            continue;
+        }
+        int32_t score = (int32_t)gain * 1000 / (cost + EXPLORE_COST_OFFSET);
+        if (score > bestScore) {
+            bestScore = score;
+            goal = n;
+        }
+    }
+
+    if (goal < 0) {
+        return EXPLORE_NONE;
+    }
+    plan_nodeToWorld(goal, gx, gy);
+    return EXPLORE_NEW;
+}
+
+void explore_giveUp(void) {
+    if (goal >= 0) {
+        BIT_SET(skipped, goal);
+    }
+    goal = -1;
+}
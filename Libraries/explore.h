@@ -0,0 +1,55 @@
+/**
+ * Frontier exploration over the occupancy grid
+ * @file explore.h
+ *
+ * A frontier is the edge of what we've mapped: a planner node the robot fits
+ * on that holds a map cell a ping has passed through next to one we know
+ * nothing about.
+ * Each sweep the frontier nodes are scored by how much unknown space lies
+ * around them divided by what it costs to drive there, and the best one is the
+ * next place to scan from. A goal is kept until it is reached or stops being
+ * a frontier, so D* Lite gets to reuse its search between sweeps. A goal
+ * that is reached but still a frontier is never picked again.
+ */
+
+#ifndef EXPLORE_H_
+#define EXPLORE_H_
+
+#include "odometry.h"
+
+/// Unknown cells are counted this many planner nodes either side of a frontier, about the useful PING range
+#define EXPLORE_GAIN_RADIUS 6
+/// Added to every travel cost so a frontier right next to us doesn't win on a near zero cost
+#define EXPLORE_COST_OFFSET 60
+/// Frontiers cheaper to reach than this are where we are already scanning from
+#define EXPLORE_MIN_COST 30
+/// A goal this close counts as reached, mm
+#define EXPLORE_REACHED_MM 300
+/// Fewest unknown cells that make a frontier worth the trip
+#define EXPLORE_MIN_GAIN 10
+
+/// explore_update() outcomes
+#define EXPLORE_NONE 0
+#define EXPLORE_SAME 1
+#define EXPLORE_NEW 2
+
+/**
+ * @brief Check the current goal against the map after a sweep and pick a new
+ * one if it has been reached or is no longer a frontier. The planner's costs
+ * must be fresh (plan_refreshCosts()).
+ *
+ * @param now current pose
+ * @param gx set to the goal x in mm
+ * @param gy set to the goal y in mm
+ * @return EXPLORE_NEW for a new goal, EXPLORE_SAME if the old one still
+ * stands, EXPLORE_NONE if there is nothing left worth exploring
+ */
+int explore_update(const pose_t *now, float *gx, float *gy);
+
+/**
+ * @brief Drop the current goal, e.g. when the planner can't find a way to
+ * it. It won't be picked again.
+ */
+void explore_giveUp(void);
+
+#endif /* EXPLORE_H_ */
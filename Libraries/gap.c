@@ -0,0 +1,122 @@
+/**
+ * Gap solver working from object edges
+ * @file gap.c
+ */
+
+#include <math.h>
+#include "gap.h"
+
+void gap_toPoint(int angle, int dist_cm, float *x, float *y) {
+    float phi = (angle - 90) * (M_PI / 180.0f);
+    *x = dist_cm * cosf(phi);
+    *y = dist_cm * sinf(phi);
+}
+
+int gap_objectWidth(const gap_object_t *obj) {
+    float ax, ay, bx, by;
+    gap_toPoint(obj->startDeg, obj->dist_cm, &ax, &ay);
+    gap_toPoint(obj->endDeg, obj->dist_cm, &bx, &by);
+    return (int)(sqrtf((bx - ax) * (bx - ax) + (by - ay) * (by - ay)) + 0.5f);
+}
+
+/**
+ * How far a point is to the side of the lane from the robot to the middle of a gap, -1 if it is
+ * behind us or beyond the gap. (ux, uy) is the unit vector along the lane.
+ */
+static float gap_laneOffset(float px, float py, float ux, float uy, float length) {
+    float along = px * ux + py * uy;
+    if (along <= 0 || along >= length) {
+        return -1;
+    }
+    return fabsf(px * uy - py * ux);
+}
+
+void gap_measure(const gap_object_t *right, const gap_object_t *left, int robotWidth, gap_t *out) {
+    float ax, ay, bx, by;
+    gap_toPoint(right->endDeg, right->dist_cm, &ax, &ay);
+    gap_toPoint(left->startDeg, left->dist_cm, &bx, &by);
+
+    float mx = (ax + bx) / 2;
+    float my = (ay + by) / 2;
+    float dist = sqrtf(mx * mx + my * my);
+
+    out->right = 0;
+    out->left = 1;
+    out->bearing = (int)floorf(atan2f(my, mx) * (180.0f / M_PI) + 0.5f);
+    out->distance_cm = (int)(dist + 0.5f);
+    out->width_cm = (int)(sqrtf((bx - ax) * (bx - ax) + (by - ay) * (by - ay)) + 0.5f);
+
+    //Only the part of the gap square on to the way we come at it is any use. If the left object's
+    //edge is right of the right one's there is no way through at all
+    float corridor = 0;
+    if (dist > 0 && left->startDeg > right->endDeg) {
+        corridor = ((by - ay) * mx - (bx - ax) * my) / dist;
+    }
+    if (corridor < 0) {
+        corridor = 0;
+    }
+    out->corridor_cm = (int)corridor;
+    out->margin_cm = out->corridor_cm - robotWidth;
+}
+
+int gap_solve(const gap_object_t *objs, int numObjs, int robotWidth, gap_t *out) {
+    int i, j, k;
+    int numGaps = 0;
+
+    for (i = 0; i + 1 < numObjs; i++) {
+        gap_t gap;
+        if (objs[i].dist_cm <= 0 || objs[i + 1].dist_cm <= 0) {
+            continue;
+        }
+        gap_measure(&objs[i], &objs[i + 1], robotWidth, &gap);
+        gap.right = i;
+        gap.left = i + 1;
+        if (gap.margin_cm < GAP_MIN_MARGIN_CM || gap.distance_cm == 0) {
+            continue;
+        }
+
+        //Anything else standing in the lane on the way to the gap narrows it
+        float mx, my;
+        gap_toPoint(gap.bearing + 90, gap.distance_cm, &mx, &my);
+        float ux = mx / gap.distance_cm;
+        float uy = my / gap.distance_cm;
+        float halfLane = gap.corridor_cm / 2.0f;
+        for (j = 0; j < numObjs; j++) {
+            if (j == i || j == i + 1 || objs[j].dist_cm <= 0) {
+                continue;
+            }
+            int angles[3] = {objs[j].startDeg, (objs[j].startDeg + objs[j].endDeg) / 2, objs[j].endDeg};
+            for (k = 0; k < 3; k++) {
+                float px, py;
+                gap_toPoint(angles[k], objs[j].dist_cm, &px, &py);
+                float offset = gap_laneOffset(px, py, ux, uy, gap.distance_cm);
+                if (offset >= 0 && offset < halfLane) {
+                    halfLane = offset;
+                }
+            }
+        }
+        gap.margin_cm = (int)(2 * halfLane) - robotWidth;
+        if (gap.margin_cm < GAP_MIN_MARGIN_CM) {
+            continue;
+        }
+
+        //Keep the list in order, most room first and the nearer of two equally roomy gaps first
+        if (numGaps == GAP_MAX) {
+            if (gap.margin_cm <= out[GAP_MAX - 1].margin_cm) {
+                continue;
+            }
+            numGaps--;
+        }
+        for (j = numGaps; j > 0; j--) {
+            const gap_t *prev = &out[j - 1];
+            if (prev->margin_cm > gap.margin_cm ||
+                (prev->margin_cm == gap.margin_cm && prev->distance_cm <= gap.distance_cm)) {
+                break;
+            }
+            out[j] = out[j - 1];
+        }
+        out[j] = gap;
+        numGaps++;
+    }
+    return numGaps;
+}
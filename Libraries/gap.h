@@ -0,0 +1,78 @@
+/**
+ * Gap solver working from object edges
+ * @file gap.h
+ *
+ * Each object's edges from a sweep are turned into points on the floor in the
+ * robot's frame (x straight ahead, y to the left, cm from the servo). A gap
+ * runs from one object's left edge to the next one's right edge. What matters
+ * for driving through it is how wide it is across the line we approach it
+ * along, not how far apart the object centres are, so that is what is
+ * measured, less anything else that sits in the lane on the way there. Gaps
+ * the robot doesn't fit through are dropped before anyone drives at them.
+ */
+
+#ifndef GAP_H_
+#define GAP_H_
+
+/// Room needed beyond the robot's width before a gap counts as passable, cm
+#define GAP_MIN_MARGIN_CM 6
+/// Most gaps gap_solve() hands back
+#define GAP_MAX 14
+
+/// One object from a sweep
+typedef struct {
+    int startDeg;   // servo angle of its right edge, 90 is straight ahead
+    int endDeg;     // servo angle of its left edge
+    int dist_cm;    // PING range to its near face
+} gap_object_t;
+
+/// A gap between two neighbouring objects
+typedef struct {
+    int right;          // index of the object on the right
+    int left;           // index of the object on the left
+    int bearing;        // degrees from straight ahead to the middle of the gap, positive is left
+    int distance_cm;    // to the middle of the gap
+    int width_cm;       // straight line edge to edge
+    int corridor_cm;    // width across the line of approach
+    int margin_cm;      // room to spare either side put together, once the robot and anything in the lane are allowed for
+} gap_t;
+
+/**
+ * @brief Floor position of a sweep reading
+ *
+ * @param angle servo angle, 90 is straight ahead
+ * @param dist_cm range
+ * @param x set to cm ahead
+ * @param y set to cm to the left
+ */
+void gap_toPoint(int angle, int dist_cm, float *x, float *y);
+
+/**
+ * @param obj object from a sweep
+ * @return distance between its edge points, cm
+ */
+int gap_objectWidth(const gap_object_t *obj);
+
+/**
+ * @brief Measure the gap between two objects, ignoring anything else
+ *
+ * @param right object on the right
+ * @param left object on the left
+ * @param robotWidth width of the robot in cm
+ * @param out filled with the gap, right and left set to 0 and 1
+ */
+void gap_measure(const gap_object_t *right, const gap_object_t *left, int robotWidth, gap_t *out);
+
+/**
+ * @brief Find the gaps between neighbouring objects the robot fits through,
+ * most room to spare first
+ *
+ * @param objs objects from a sweep, right to left as findObjects() lists them
+ * @param numObjs number of objects
+ * @param robotWidth width of the robot in cm
+ * @param out filled with up to GAP_MAX gaps
+ * @return number of passable gaps
+ */
+int gap_solve(const gap_object_t *objs, int numObjs, int robotWidth, gap_t *out);
+
+#endif /* GAP_H_ */
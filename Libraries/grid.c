@@ -0,0 +1,99 @@
+/**
+ * Log-odds occupancy grid built up from PING sweeps
+ * @file grid.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "grid.h"
+
+static int8_t cells[GRID_SIZE_Y][GRID_SIZE_X];
+
+static void grid_adjust(int cx, int cy, int delta) {
+    if (cx < 0 || cx >= GRID_SIZE_X || cy < 0 || cy >= GRID_SIZE_Y) {
+        return;
+    }
+    int l = cells[cy][cx] + delta;
+    if (l > GRID_L_MAX) {
+        l = GRID_L_MAX;
+    } else if (l < GRID_L_MIN) {
+        l = GRID_L_MIN;
+    }
+    cells[cy][cx] = (int8_t)l;
+}
+
+void grid_clear(void) {
+    memset(cells, 0, sizeof(cells));
+}
+
+int grid_worldToCell(float x, float y, int *cx, int *cy) {
+    *cx = (int)floorf(x / GRID_CELL_MM) + GRID_ORIGIN_X;
+    *cy = (int)floorf(y / GRID_CELL_MM) + GRID_ORIGIN_Y;
+    return *cx >= 0 && *cx < GRID_SIZE_X && *cy >= 0 && *cy < GRID_SIZE_Y;
+}
+
+void grid_cellToWorld(int cx, int cy, float *x, float *y) {
+    *x = (cx - GRID_ORIGIN_X + 0.5f) * GRID_CELL_MM;
+    *y = (cy - GRID_ORIGIN_Y + 0.5f) * GRID_CELL_MM;
+}
+
+void grid_rayCast(int x0, int y0, int x1, int y1, int hit) {
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y1 - y0 : y0 - y1;
+    int sx = x1 > x0 ? 1 : -1;
+    int sy = y1 > y0 ? 1 : -1;
+    int err = dx - dy;
+
+    //Everything short of the end cell is something the ping went through
+    while (x0 != x1 || y0 != y1) {
+        grid_adjust(x0, y0, GRID_L_MISS);
+        int e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x0 += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+    grid_adjust(x1, y1, hit ? GRID_L_HIT : GRID_L_MISS);
+}
+
+void grid_addSweep(int scan[181][2], const pose_t *scanPose) {
+    int a;
+    int sx, sy;
+    grid_worldToCell(scanPose->x, scanPose->y, &sx, &sy);
+
+    for (a = 0; a <= 180; a += 2) {
+        int r = scan[a][0];
+        if (r <= 0) {
+            continue;
+        }
+        int hit = r < GRID_MAX_RANGE_CM;
+        if (!hit) {
+            r = GRID_MAX_RANGE_CM;
+        }
+
+        //Servo angle 90 was straight ahead when the sweep was taken
+        float ray = scanPose->theta + (a - 90) * DEG_TO_RAD;
+        int ex, ey;
+        grid_worldToCell(scanPose->x + r * 10.0f * cosf(ray), scanPose->y + r * 10.0f * sinf(ray), &ex, &ey);
+        grid_rayCast(sx, sy, ex, ey, hit);
+    }
+}
+
+int8_t grid_get(int cx, int cy) {
+    if (cx < 0 || cx >= GRID_SIZE_X || cy < 0 || cy >= GRID_SIZE_Y) {
+        return 0;
+    }
+    return cells[cy][cx];
+}
+
+int grid_isOccupied(int cx, int cy) {
+    return grid_get(cx, cy) > GRID_L_THRESHOLD;
+}
+
+int grid_isFree(int cx, int cy) {
+    return grid_get(cx, cy) < -GRID_L_THRESHOLD;
+}
@@ -0,0 +1,105 @@
+/**
+ * Log-odds occupancy grid built up from PING sweeps
+ * @file grid.h
+ *
+ * Each cell holds an int8 log-odds value: positive means we have seen
+ * something there, negative means a ping has passed through it, 0 means we
+ * know nothing. Every sweep is ray-cast in with integer Bresenham from the
+ * pose it was taken at, so obstacles seen on earlier loops are remembered
+ * instead of rediscovered. The grid is GRID_SIZE_X * GRID_SIZE_Y bytes (6KB)
+ * of the TM4C123's 32KB SRAM. The robot is put down near one end of the course
+ * facing along it, so the grid reaches a little behind where odom_reset() put
+ * the origin and covers the whole 4.27m course ahead.
+ */
+
+#ifndef GRID_H_
+#define GRID_H_
+
+#include <stdint.h>
+#include "odometry.h"
+
+/// Cells along x and y and cell edge length, 96 x 64 of 5cm covers 4.8m ahead by 3.2m across
+#define GRID_SIZE_X 96
+#define GRID_SIZE_Y 64
+#define GRID_CELL_MM 50
+/// Cell index of the world origin, 0.5m from the back edge and centred across. Both are even so planner nodes line up with the origin
+#define GRID_ORIGIN_X 10
+#define GRID_ORIGIN_Y (GRID_SIZE_Y / 2)
+
+/// Log-odds added for a ping ending in a cell, and for one passing through
+#define GRID_L_HIT 24
+#define GRID_L_MISS (-6)
+/// Saturation limits, low enough that a moved object is forgotten in a few sweeps
+#define GRID_L_MAX 100
+#define GRID_L_MIN (-100)
+/// A cell is called occupied above this and free below its negative
+#define GRID_L_THRESHOLD 40
+
+/// PING readings past this are unreliable, they only clear cells up to here and mark nothing, cm
+#define GRID_MAX_RANGE_CM 250
+
+/**
+ * @brief Forget everything, every cell back to unknown
+ */
+void grid_clear(void);
+
+/**
+ * @brief Cell containing a world position
+ *
+ * @param x world x in mm
+ * @param y world y in mm
+ * @param cx cell column out
+ * @param cy cell row out
+ * @return 1 if the cell is on the grid, 0 if not (cx and cy are still set)
+ */
+int grid_worldToCell(float x, float y, int *cx, int *cy);
+
+/**
+ * @brief World position of the centre of a cell
+ *
+ * @param cx cell column
+ * @param cy cell row
+ * @param x world x in mm out
+ * @param y world y in mm out
+ */
+void grid_cellToWorld(int cx, int cy, float *x, float *y);
+
+/**
+ * @brief Trace one ping from the sensor cell to the end cell, lowering every
+ * cell on the way and raising the end cell if something was hit there. Cells
+ * off the grid are skipped.
+ *
+ * @param x0 sensor cell column
+ * @param y0 sensor cell row
+ * @param x1 end cell column
+ * @param y1 end cell row
+ * @param hit 1 if the ping came back from something at the end cell
+ */
+void grid_rayCast(int x0, int y0, int x1, int y1, int hit);
+
+/**
+ * @brief Ray-cast a whole sweep into the grid
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param scanPose pose when the sweep was taken
+ */
+void grid_addSweep(int scan[181][2], const pose_t *scanPose);
+
+/**
+ * @param cx cell column
+ * @param cy cell row
+ * @return log-odds of the cell, 0 (unknown) off the grid
+ */
+int8_t grid_get(int cx, int cy);
+
+/**
+ * @return 1 if the cell is confidently occupied
+ */
+int grid_isOccupied(int cx, int cy);
+
+/**
+ * @return 1 if the cell is confidently free
+ */
+int grid_isFree(int cx, int cy);
+
+#endif /* GRID_H_ */
@@ -0,0 +1,89 @@
+/**
+ * Hazard monitor fusing light bumper proximity with bump and cliff state
+ * @file hazard.c
+ */
+
+#include "hazard.h"
+#include "motion.h"
+
+/// The outer sensors look sideways, so things they see matter less for driving forward
+static const float sectorWeight[HAZARD_NUM_SECTORS] = {0.3f, 0.8f, 1.0f, 1.0f, 0.8f, 0.3f};
+
+static hazard_t latest = {{0}, 1.0f, -1, 0, MOTION_OK};
+
+/**
+ * Same priority order move_forward() has always used
+ */
+static int hazard_checkContact(const oi_t *s) {
+    if (s->bumpLeft) {
+        return MOTION_BUMP_LEFT;
+    }
+    if (s->bumpRight) {
+        return MOTION_BUMP_RIGHT;
+    }
+    if (s->cliffFrontLeftSignal > HAZARD_TAPE_HIGH || s->cliffLeftSignal > HAZARD_TAPE_HIGH) {
+        return MOTION_BOUND_LEFT;
+    }
+    if (s->cliffFrontLeftSignal < HAZARD_CLIFF_LOW || s->cliffLeftSignal < HAZARD_CLIFF_LOW) {
+        return MOTION_CLIFF_LEFT;
+    }
+    if (s->cliffFrontRightSignal > HAZARD_TAPE_HIGH || s->cliffRightSignal > HAZARD_TAPE_HIGH) {
+        return MOTION_BOUND_RIGHT;
+    }
+    if (s->cliffFrontRightSignal < HAZARD_CLIFF_LOW || s->cliffRightSignal < HAZARD_CLIFF_LOW) {
+        return MOTION_CLIFF_RIGHT;
+    }
+    return MOTION_OK;
+}
+
+void hazard_update(const oi_t *s) {
+    int i;
+    float worst = 0;
+
+    latest.signal[HAZARD_SECTOR_LEFT] = s->lightBumpLeftSignal;
+    latest.signal[HAZARD_SECTOR_FRONT_LEFT] = s->lightBumpFrontLeftSignal;
+    latest.signal[HAZARD_SECTOR_CENTER_LEFT] = s->lightBumpCenterLeftSignal;
+    latest.signal[HAZARD_SECTOR_CENTER_RIGHT] = s->lightBumpCenterRightSignal;
+    latest.signal[HAZARD_SECTOR_FRONT_RIGHT] = s->lightBumpFrontRightSignal;
+    latest.signal[HAZARD_SECTOR_RIGHT] = s->lightBumpRightSignal;
+
+    latest.blockedSector = -1;
+    latest.stopMask = 0;
+    for (i = 0; i < HAZARD_NUM_SECTORS; i++) {
+        float weighted = latest.signal[i] * sectorWeight[i];
+        if (weighted >= HAZARD_STOP_SIGNAL) {
+            latest.stopMask |= 1 << i;
+        }
+        if (weighted > worst) {
+            worst = weighted;
+            if (weighted > HAZARD_SLOW_SIGNAL) {
+                latest.blockedSector = i;
+            }
+        }
+    }
+
+    //Linear ramp from full speed at the slow threshold down to a stop at the stop threshold
+    if (worst <= HAZARD_SLOW_SIGNAL) {
+        latest.speedScale = 1.0f;
+    }
+    else if (worst >= HAZARD_STOP_SIGNAL) {
+        latest.speedScale = 0;
+    }
+    else {
+        latest.speedScale = 1.0f - (worst - HAZARD_SLOW_SIGNAL) / (float)(HAZARD_STOP_SIGNAL - HAZARD_SLOW_SIGNAL);
+    }
+
+    latest.contact = hazard_checkContact(s);
+}
+
+void hazard_get(hazard_t *out) {
+    bool wasDisabled = IntMasterDisable();
+    *out = latest;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+int hazard_isLeftSector(int sector) {
+    return sector <= HAZARD_SECTOR_CENTER_LEFT;
+}
@@ -0,0 +1,61 @@
+/**
+ * Hazard monitor fusing light bumper proximity with bump and cliff state
+ * @file hazard.h
+ *
+ * The Create's six light bumpers give a rough proximity reading in front of
+ * the robot well before the bump switches close. hazard_update() runs every
+ * control tick and turns them into a forward speed scale that drops to zero
+ * before contact, plus which sector is blocked.
+ */
+
+#ifndef HAZARD_H_
+#define HAZARD_H_
+
+#include "open_interface.h"
+
+/// Light bumper sectors, left to right
+#define HAZARD_SECTOR_LEFT 0
+#define HAZARD_SECTOR_FRONT_LEFT 1
+#define HAZARD_SECTOR_CENTER_LEFT 2
+#define HAZARD_SECTOR_CENTER_RIGHT 3
+#define HAZARD_SECTOR_FRONT_RIGHT 4
+#define HAZARD_SECTOR_RIGHT 5
+#define HAZARD_NUM_SECTORS 6
+
+/// Weighted light bump signal where we start slowing down, and where we stop
+#define HAZARD_SLOW_SIGNAL 150
+#define HAZARD_STOP_SIGNAL 1200
+
+/// Cliff signal above this is boundary tape, below HAZARD_CLIFF_LOW is a drop off
+#define HAZARD_TAPE_HIGH 2500
+#define HAZARD_CLIFF_LOW 500
+
+typedef struct {
+    uint16_t signal[HAZARD_NUM_SECTORS];    // raw light bump signal per sector, bigger is closer
+    float speedScale;       // 0 to 1, fraction of cruise speed that is safe going forward
+    int blockedSector;      // sector with the strongest weighted signal past HAZARD_SLOW_SIGNAL, -1 if clear
+    uint8_t stopMask;       // bit per sector past HAZARD_STOP_SIGNAL
+    int contact;            // MOTION_* code for a bump, tape or cliff, MOTION_OK if none
+} hazard_t;
+
+/**
+ * @brief Fuse the latest sensor packet. Called from the motion controller's
+ * interrupt after every sensor update.
+ *
+ * @param s freshly updated sensor data
+ */
+void hazard_update(const oi_t *s);
+
+/**
+ * @brief Copy out the latest hazard state, safe to call from the main loop
+ *
+ * @param out destination for the snapshot
+ */
+void hazard_get(hazard_t *out);
+
+/**
+ * @return 1 if the sector is on the left half of the bumper, 0 for the right half
+ */
+int hazard_isLeftSector(int sector);
+
+#endif /* HAZARD_H_ */
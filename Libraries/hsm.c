@@ -0,0 +1,173 @@
+/**
+ * Small hierarchical state machine
+ * @file hsm.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driverlib/interrupt.h"
+#include "hsm.h"
+
+static const hsm_state_t *current = 0;
+static const hsm_state_t *pending = 0;
+
+static volatile uint8_t queue[HSM_QUEUE_SIZE];
+static volatile int queueHead = 0;
+static volatile int queueCount = 0;
+
+/**
+ * 1 if inner is outer or sits somewhere inside it
+ */
+static int hsm_within(const hsm_state_t *inner, const hsm_state_t *outer) {
+    for (; inner; inner = inner->parent) {
+        if (inner == outer) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Carry out transitions until the handlers stop asking for them
+ */
+static void hsm_apply(void) {
+    const hsm_state_t *path[HSM_MAX_DEPTH];
+    const hsm_state_t *s;
+
+    while (pending) {
+        const hsm_state_t *target = pending;
+        const hsm_state_t *shared = 0;
+        int n = 0;
+        pending = 0;
+
+        //Deepest state both ends sit in. Going to ourselves leaves and comes back in
+        if (target == current) {
+            shared = current->parent;
+        }
+        else {
+            for (s = target; s; s = s->parent) {
+                if (hsm_within(current, s)) {
+                    shared = s;
+                    break;
+                }
+            }
+        }
+
+        while (current != shared) {
+            if (current->onExit) {
+                current->onExit();
+            }
+            current = current->parent;
+        }
+
+        for (s = target; s != shared && n < HSM_MAX_DEPTH; s = s->parent) {
+            path[n++] = s;
+        }
+        while (n > 0) {
+            current = path[--n];
+            if (current->onEntry) {
+                current->onEntry();
+            }
+        }
+
+        //An entry action that picks somewhere else to go overrides the initial children
+        while (current->initial && !pending) {
+            current = current->initial;
+            if (current->onEntry) {
+                current->onEntry();
+            }
+        }
+    }
+}
+
+/**
+ * Next queued event, 0 if there are none
+ */
+static int hsm_take(void) {
+    int event = 0;
+    bool wasDisabled = IntMasterDisable();
+    if (queueCount > 0) {
+        event = queue[queueHead];
+        queueHead = (queueHead + 1) % HSM_QUEUE_SIZE;
+        queueCount--;
+    }
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+    return event;
+}
+
+void hsm_start(const hsm_state_t *initial) {
+    bool wasDisabled = IntMasterDisable();
+    queueHead = 0;
+    queueCount = 0;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+
+    current = 0;
+    pending = initial;
+    hsm_apply();
+}
+
+void hsm_transition(const hsm_state_t *target) {
+    pending = target;
+}
+
+int hsm_post(int event) {
+    int queued = 0;
+    bool wasDisabled = IntMasterDisable();
+    if (queueCount < HSM_QUEUE_SIZE) {
+        queue[(queueHead + queueCount) % HSM_QUEUE_SIZE] = event;
+        queueCount++;
+        queued = 1;
+    }
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+    return queued;
+}
+
+int hsm_dispatch(int event) {
+    const hsm_state_t *s;
+    int handled = 0;
+
+    for (s = current; s && !handled; s = s->parent) {
+        if (s->onEvent) {
+            handled = s->onEvent(event);
+        }
+    }
+    hsm_apply();
+    return handled;
+}
+
+void hsm_run(void) {
+    const hsm_state_t *path[HSM_MAX_DEPTH];
+    const hsm_state_t *s;
+    int event;
+    int n = 0;
+
+    while ((event = hsm_take()) != 0) {
+        hsm_dispatch(event);
+    }
+
+    //Outer states tick first, and once one asks to leave the states inside it don't get a tick
+    for (s = current; s && n < HSM_MAX_DEPTH; s = s->parent) {
+        path[n++] = s;
+    }
+    while (n > 0 && !pending) {
+        s = path[--n];
+        if (s->onTick) {
+            s->onTick();
+        }
+    }
+    hsm_apply();
+}
+
+int hsm_isIn(const hsm_state_t *state) {
+    return hsm_within(current, state);
+}
+
+const hsm_state_t *hsm_current(void) {
+    return current;
+}
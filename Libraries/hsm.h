@@ -0,0 +1,94 @@
+/**
+ * Small hierarchical state machine
+ * @file hsm.h
+ *
+ * States are const structs linked to their parent, so a state that doesn't
+ * handle an event passes it up to the state it sits in, and common handling
+ * (stop, mode switches) lives once in an outer state. Each state can have
+ * entry and exit actions, a tick handler run every pass of the main loop,
+ * and an event handler. None of them may block; anything slow is spread over
+ * several ticks.
+ *
+ * Events are small positive integers the application picks. hsm_post() queues
+ * them and is safe to call from interrupts. hsm_run() dispatches the queued
+ * events in order and then ticks the active states.
+ *
+ * Handlers ask for a transition with hsm_transition() and it is carried out
+ * as soon as the handler returns: states are exited up to the one the source
+ * and target share, then entered down to the target and on through each
+ * state's initial child. A transition to a state we are already inside just
+ * exits the states below it, one to the current state itself exits and
+ * re-enters it.
+ */
+
+#ifndef HSM_H_
+#define HSM_H_
+
+/// Events that can be waiting at once. Posts beyond this are dropped
+#define HSM_QUEUE_SIZE 16
+/// Deepest nesting of states
+#define HSM_MAX_DEPTH 6
+
+typedef struct hsm_state hsm_state_t;
+
+/// A state. Any of the handlers may be 0
+struct hsm_state {
+    const char *name;
+    const hsm_state_t *parent;      // state this one sits in, 0 at the top
+    const hsm_state_t *initial;     // child entered along with this state, 0 to stop here
+    void (*onEntry)(void);
+    void (*onExit)(void);
+    void (*onTick)(void);
+    int (*onEvent)(int event);      // returns 1 if the event was dealt with, 0 to pass it up
+};
+
+/**
+ * @brief Enter the first state (and its initial children), with an empty event queue
+ *
+ * @param initial state to start in
+ */
+void hsm_start(const hsm_state_t *initial);
+
+/**
+ * @brief Ask to move to another state. Called from a handler, it happens as
+ * soon as that handler returns; the last request wins.
+ *
+ * @param target state to move to
+ */
+void hsm_transition(const hsm_state_t *target);
+
+/**
+ * @brief Queue an event. Safe from interrupts.
+ *
+ * @param event application event, above 0
+ * @return 1 if queued, 0 if the queue was full
+ */
+int hsm_post(int event);
+
+/**
+ * @brief Hand an event to the current state straight away, passing it up
+ * through the parents until one deals with it
+ *
+ * @param event application event
+ * @return 1 if some state dealt with it
+ */
+int hsm_dispatch(int event);
+
+/**
+ * @brief One pass of the machine: dispatch every queued event, then tick the
+ * active states from the outermost in. Call from the main loop.
+ */
+void hsm_run(void);
+
+/**
+ * @param state state to check
+ * @return 1 if state is the current state or one of the states it sits in
+ */
+int hsm_isIn(const hsm_state_t *state);
+
+/**
+ * @return the innermost active state
+ */
+const hsm_state_t *hsm_current(void);
+
+#endif /* HSM_H_ */
@@ -0,0 +1,64 @@
+/**
+ * Light bumpers as a near-field range sensor
+ * @file lightbump.c
+ */
+
+#include <math.h>
+#include "lightbump.h"
+
+/// Roughly where each sensor looks, left to right like the HAZARD_SECTOR_* numbers
+static const int sensorBearing[HAZARD_NUM_SECTORS] = {72, 43, 13, -13, -43, -72};
+
+static float gain[HAZARD_NUM_SECTORS] = {LBUMP_DEFAULT_GAIN, LBUMP_DEFAULT_GAIN, LBUMP_DEFAULT_GAIN,
+                                         LBUMP_DEFAULT_GAIN, LBUMP_DEFAULT_GAIN, LBUMP_DEFAULT_GAIN};
+
+int lbump_bearing(int sector) {
+    return sensorBearing[sector];
+}
+
+float lbump_range(const hazard_t *haz, int sector) {
+    if (haz->signal[sector] < LBUMP_DETECT_SIGNAL) {
+        return -1;
+    }
+    float d = sqrtf(gain[sector] / haz->signal[sector]);
+    return d <= LBUMP_MAX_MM ? d : -1;
+}
+
+int lbump_toSample(const hazard_t *haz, int sector, const pose_t *pose, unsigned int millis, scanInstance *out) {
+    float d = lbump_range(haz, sector);
+    if (d < 0) {
+        return 0;
+    }
+
+    //The sensors face straight out from the centre, so range from there is just the bumper radius further
+    out->angle = 90 + sensorBearing[sector];
+    out->fromAngle = out->angle - LBUMP_HALF_BEAM_DEG;
+    out->toAngle = out->angle + LBUMP_HALF_BEAM_DEG;
+    out->pingDist = (LBUMP_RADIUS_MM + d) / 10.0f;
+    out->irRaw = 0;
+    out->irDist = 0;
+    out->millis = millis;
+    out->pose = *pose;
+    return 1;
+}
+
+void lbump_calibrate(const scanInstance *s, const hazard_t *haz) {
+    int i;
+    for (i = 0; i < HAZARD_NUM_SECTORS; i++) {
+        int off = s->angle - 90 - sensorBearing[i];
+        if (off < -LBUMP_HALF_BEAM_DEG / 2 || off > LBUMP_HALF_BEAM_DEG / 2 || haz->signal[i] < LBUMP_DETECT_SIGNAL) {
+            continue;
+        }
+        float d = s->pingDist * 10.0f - LBUMP_RADIUS_MM;
+        if (d <= 0 || d > LBUMP_MAX_MM) {
+            return;
+        }
+        //One odd echo shouldn't throw the model far off
+        float measured = haz->signal[i] * d * d;
+        if (measured > gain[i] * 4 || measured < gain[i] / 4) {
+            return;
+        }
+        gain[i] += LBUMP_CAL_RATE * (measured - gain[i]);
+        return;
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * Light bumpers as a near-field range sensor
+ * @file lightbump.h
+ *
+ * The six light bumpers look out of the front of the bumper in fixed
+ * directions and come in with every sensor update, so they say what is close
+ * in front without moving the servo. The reflected signal falls off with the
+ * square of the distance, so each sensor's range is sqrt(gain / signal). The
+ * gain depends on the sensor and on what it is looking at, so it starts at
+ * LBUMP_DEFAULT_GAIN and is pulled towards whatever PING measures whenever a
+ * sweep sample lines up with a sensor that sees something.
+ */
+
+#ifndef LIGHTBUMP_H_
+#define LIGHTBUMP_H_
+
+#include "hazard.h"
+#include "scan.h"
+
+/// Distance from the robot centre out to the sensors on the bumper, mm
+#define LBUMP_RADIUS_MM 165.0f
+/// Signal below this is nothing at all
+#define LBUMP_DETECT_SIGNAL 100
+/// Furthest from the bumper a reading is trusted, mm
+#define LBUMP_MAX_MM 150.0f
+/// Half the width each sensor sees, degrees
+#define LBUMP_HALF_BEAM_DEG 8
+
+/// Signal times distance squared (mm) for a typical obstacle, and how fast calibration pulls it towards PING
+#define LBUMP_DEFAULT_GAIN 2160000.0f
+#define LBUMP_CAL_RATE 0.2f
+
+/**
+ * @param sector HAZARD_SECTOR_*
+ * @return direction the sensor looks, degrees from straight ahead, positive is left
+ */
+int lbump_bearing(int sector);
+
+/**
+ * @brief Range the sensor reads
+ *
+ * @param haz hazard snapshot with the raw signals
+ * @param sector HAZARD_SECTOR_*
+ * @return distance out from the bumper in mm, -1 if nothing is within LBUMP_MAX_MM
+ */
+float lbump_range(const hazard_t *haz, int sector);
+
+/**
+ * @brief Turn a sensor's reading into a sweep sample, as if PING had seen it from the robot centre, for
+ * frame_addNear(). IR is left at 0, the servo's IR sensor didn't see it
+ *
+ * @param haz hazard snapshot with the raw signals
+ * @param sector HAZARD_SECTOR_*
+ * @param pose robot pose when haz was taken
+ * @param millis timer_getMillis() when haz was taken
+ * @param out filled with the sample
+ * @return 1 if the sensor sees something, 0 if out was left alone
+ */
+int lbump_toSample(const hazard_t *haz, int sector, const pose_t *pose, unsigned int millis, scanInstance *out);
+
+/**
+ * @brief Pull the gain of the sensor looking the way a sweep sample was taken towards what PING measured. Does
+ * nothing if no sensor looks that way, or it or PING sees nothing close
+ *
+ * @param s sweep sample, taken with the robot standing still
+ * @param haz hazard snapshot from when it was taken
+ */
+void lbump_calibrate(const scanInstance *s, const hazard_t *haz);
+
+#endif /* LIGHTBUMP_H_ */
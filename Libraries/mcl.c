@@ -0,0 +1,339 @@
+/**
+ * Monte Carlo localization against a known course layout
+ * @file mcl.c
+ */
+
+#include <math.h>
+#include "mcl.h"
+
+#define MCL_PI 3.14159265f
+//Penalty units per squared standard deviation, log2(e) / 2 bits of likelihood each
+#define MCL_PENALTY_PER_SIGMA2 (MCL_PENALTY_PER_BIT * 0.7213f)
+
+typedef struct {
+    int16_t x;          // mm in the course frame
+    int16_t y;
+    int16_t theta;      // milliradians
+    uint16_t score;     // penalty while observations come in, Q15 weight during resampling
+} particle_t;
+
+static particle_t particles[2][MCL_MAX_PARTICLES];
+static int active;
+static int count;
+static int lastBins;
+static int observed;
+static int obsCount;
+static const mcl_field_t *course;
+static pose_t lastOdom;
+static uint32_t seed = 0x2545F491;
+static uint8_t binUsed[(MCL_BINS_X * MCL_BINS_Y * MCL_BIN_HEADINGS + 7) / 8];
+
+//2^(-i/8) in Q15, the fractional part of a penalty
+static const uint16_t fracWeight[MCL_PENALTY_PER_BIT] = {32768, 30048, 27554, 25268, 23170, 21247, 19484, 17867};
+
+static uint32_t mcl_rand(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/**
+ * Uniform in [-1, 1)
+ */
+static float mcl_uniform(void) {
+    return ((int32_t)(mcl_rand() >> 8) - (1 << 23)) / (float)(1 << 23);
+}
+
+/**
+ * Roughly unit normal, sum of four uniforms scaled to unit variance
+ */
+static float mcl_normal(void) {
+    return (mcl_uniform() + mcl_uniform() + mcl_uniform() + mcl_uniform()) * 0.866f;
+}
+
+static int16_t mcl_wrapMilli(float rad) {
+    return (int16_t)(odom_wrapAngle(rad) * 1000.0f);
+}
+
+static uint16_t mcl_weight(uint32_t penalty) {
+    uint32_t shift = penalty / MCL_PENALTY_PER_BIT;
+    if (shift >= 16) {
+        return 0;
+    }
+    return fracWeight[penalty % MCL_PENALTY_PER_BIT] >> shift;
+}
+
+static void mcl_addPenalty(particle_t *p, float sigma2) {
+    float pen = sigma2 * MCL_PENALTY_PER_SIGMA2;
+    if (pen > MCL_MAX_OBS_PENALTY) {
+        pen = MCL_MAX_OBS_PENALTY;
+    }
+    uint32_t total = p->score + (uint32_t)pen;
+    p->score = total > 0xFFFF ? 0xFFFF : (uint16_t)total;
+}
+
+/**
+ * Mark a particle's pose bin, returning 1 if nobody was in it yet
+ */
+static int mcl_markBin(const particle_t *p) {
+    int bx = (p->x - course->minX) / MCL_BIN_MM;
+    int by = (p->y - course->minY) / MCL_BIN_MM;
+    int bt = (int)((p->theta + 3142) * MCL_BIN_HEADINGS / 6284);
+    bx = bx < 0 ? 0 : (bx >= MCL_BINS_X ? MCL_BINS_X - 1 : bx);
+    by = by < 0 ? 0 : (by >= MCL_BINS_Y ? MCL_BINS_Y - 1 : by);
+    bt = bt < 0 ? 0 : (bt >= MCL_BIN_HEADINGS ? MCL_BIN_HEADINGS - 1 : bt);
+
+    int bin = (by * MCL_BINS_X + bx) * MCL_BIN_HEADINGS + bt;
+    if (binUsed[bin >> 3] & (1 << (bin & 7))) {
+        return 0;
+    }
+    binUsed[bin >> 3] |= (uint8_t)(1 << (bin & 7));
+    return 1;
+}
+
+/**
+ * Put a particle anywhere on the course with any heading
+ */
+static void mcl_scatter(particle_t *p) {
+    float halfW = (course->maxX - course->minX) * 0.5f;
+    float halfH = (course->maxY - course->minY) * 0.5f;
+    p->x = (int16_t)(course->minX + halfW + halfW * mcl_uniform());
+    p->y = (int16_t)(course->minY + halfH + halfH * mcl_uniform());
+    p->theta = (int16_t)(MCL_PI * 1000.0f * mcl_uniform());
+    p->score = 0;
+}
+
+void mcl_init(const mcl_field_t *field, const pose_t *odom) {
+    int i;
+    course = field;
+    active = 0;
+    count = MCL_MAX_PARTICLES;
+    lastBins = 0;
+    observed = 0;
+    obsCount = 0;
+    lastOdom = *odom;
+
+    for (i = 0; i < count; i++) {
+        mcl_scatter(&particles[active][i]);
+    }
+}
+
+void mcl_initAround(const mcl_field_t *field, const pose_t *odom, const pose_t *start, float spread_mm, float spread_rad) {
+    int i;
+    mcl_init(field, odom);
+
+    for (i = 0; i < count; i++) {
+        particle_t *p = &particles[active][i];
+        p->x = (int16_t)(start->x + spread_mm * mcl_normal());
+        p->y = (int16_t)(start->y + spread_mm * mcl_normal());
+        p->theta = mcl_wrapMilli(start->theta + spread_rad * mcl_normal());
+    }
+}
+
+void mcl_predict(const pose_t *odom) {
+    int i;
+
+    //Odometry's motion in the robot frame, so it can be replayed from each particle
+    float c0 = cosf(lastOdom.theta);
+    float s0 = sinf(lastOdom.theta);
+    float ox = odom->x - lastOdom.x;
+    float oy = odom->y - lastOdom.y;
+    float fwd = c0 * ox + s0 * oy;
+    float side = -s0 * ox + c0 * oy;
+    float dth = odom_wrapAngle(odom->theta - lastOdom.theta);
+    lastOdom = *odom;
+
+    float dist = sqrtf(fwd * fwd + side * side);
+    if (dist < 1.0f && fabsf(dth) < 0.001f) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        particle_t *p = &particles[active][i];
+        float f = fwd * (1.0f + MCL_NOISE_DIST * mcl_normal());
+        float t = dth + (fabsf(dth) * MCL_NOISE_TURN + dist * 0.001f * MCL_NOISE_DRIFT_PER_M) * mcl_normal();
+        float th = p->theta * 0.001f + t * 0.5f;
+        float c = cosf(th);
+        float s = sinf(th);
+        p->x = (int16_t)(p->x + c * f - s * side);
+        p->y = (int16_t)(p->y + s * f + c * side);
+        p->theta = mcl_wrapMilli(p->theta * 0.001f + t);
+    }
+}
+
+void mcl_observePost(float range_mm, float bearing) {
+    int i, j;
+    if (course->numPosts == 0) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        particle_t *p = &particles[active][i];
+        float a = p->theta * 0.001f + bearing;
+        float ex = p->x + range_mm * cosf(a);
+        float ey = p->y + range_mm * sinf(a);
+
+        //Whichever post this particle would have been looking at
+        float best = 0;
+        for (j = 0; j < course->numPosts; j++) {
+            float dx = ex - course->postX[j];
+            float dy = ey - course->postY[j];
+            float d2 = dx * dx + dy * dy;
+            if (j == 0 || d2 < best) {
+                best = d2;
+            }
+        }
+        mcl_addPenalty(p, best / (MCL_POST_SIGMA_MM * MCL_POST_SIGMA_MM));
+    }
+    observed = 1;
+    obsCount++;
+}
+
+void mcl_observeTape(int leftSide, float behind_mm) {
+    int i;
+    float fwd = MCL_CLIFF_FWD_MM + behind_mm;
+    float side = leftSide ? MCL_CLIFF_SIDE_MM : -MCL_CLIFF_SIDE_MM;
+
+    for (i = 0; i < count; i++) {
+        particle_t *p = &particles[active][i];
+        float th = p->theta * 0.001f;
+        float c = cosf(th);
+        float s = sinf(th);
+        float sx = p->x + c * fwd - s * side;
+        float sy = p->y + s * fwd + c * side;
+
+        //Distance from the sensor to the nearest edge of the tape rectangle
+        float outX = sx < course->minX ? course->minX - sx : (sx > course->maxX ? sx - course->maxX : 0);
+        float outY = sy < course->minY ? course->minY - sy : (sy > course->maxY ? sy - course->maxY : 0);
+        float d2;
+        if (outX > 0 || outY > 0) {
+            d2 = outX * outX + outY * outY;
+        } else {
+            float d = sx - course->minX;
+            d = course->maxX - sx < d ? course->maxX - sx : d;
+            d = sy - course->minY < d ? sy - course->minY : d;
+            d = course->maxY - sy < d ? course->maxY - sy : d;
+            d2 = d * d;
+        }
+        mcl_addPenalty(p, d2 / (MCL_TAPE_SIGMA_MM * MCL_TAPE_SIGMA_MM));
+    }
+    observed = 1;
+    obsCount++;
+}
+
+void mcl_update(void) {
+    int i, m;
+    if (!observed) {
+        return;
+    }
+    observed = 0;
+
+    particle_t *from = particles[active];
+    particle_t *to = particles[active ^ 1];
+
+    //Weights are relative to the best particle, so it always gets full weight
+    uint16_t minPenalty = 0xFFFF;
+    for (i = 0; i < count; i++) {
+        if (from[i].score < minPenalty) {
+            minPenalty = from[i].score;
+        }
+    }
+
+    //Count the bins the particles worth keeping (within 3 bits of the best) sit in to size the new set
+    uint32_t total = 0;
+    int bins = 0;
+    for (i = 0; i < (int)sizeof(binUsed); i++) {
+        binUsed[i] = 0;
+    }
+    for (i = 0; i < count; i++) {
+        uint32_t rel = from[i].score - minPenalty;
+        if (rel <= 3 * MCL_PENALTY_PER_BIT) {
+            bins += mcl_markBin(&from[i]);
+        }
+        from[i].score = mcl_weight(rel);
+        total += from[i].score;
+    }
+    lastBins = bins;
+
+    //Shrink at most by half each time, one lucky sighting shouldn't be enough to throw away the alternatives
+    int newCount = bins * MCL_PARTICLES_PER_BIN;
+    if (newCount < count / 2) {
+        newCount = count / 2;
+    }
+    if (newCount < MCL_MIN_PARTICLES) {
+        newCount = MCL_MIN_PARTICLES;
+    } else if (newCount > MCL_MAX_PARTICLES) {
+        newCount = MCL_MAX_PARTICLES;
+    }
+
+    //Low-variance resampling, one random offset then evenly spaced picks through the cumulative weight
+    uint32_t step = total / newCount;
+    if (step == 0) {
+        step = 1;
+    }
+    uint32_t u = mcl_rand() % step;
+    uint32_t cumulative = from[0].score;
+    i = 0;
+    for (m = 0; m < newCount; m++) {
+        while (u >= cumulative && i < count - 1) {
+            i++;
+            cumulative += from[i].score;
+        }
+        to[m] = from[i];
+        to[m].score = 0;
+        u += step;
+    }
+
+    //Nothing fits well, so hedge against having converged on the wrong spot
+    if (minPenalty > obsCount * MCL_LOST_BITS_PER_OBS * MCL_PENALTY_PER_BIT) {
+        for (m = newCount - newCount * MCL_INJECT_PERCENT / 100; m < newCount; m++) {
+            mcl_scatter(&to[m]);
+        }
+    }
+    obsCount = 0;
+
+    count = newCount;
+    active ^= 1;
+}
+
+void mcl_getEstimate(mcl_estimate_t *out) {
+    int i;
+    float sx = 0, sy = 0, sc = 0, ss = 0;
+    particle_t *set = particles[active];
+
+    for (i = 0; i < count; i++) {
+        sx += set[i].x;
+        sy += set[i].y;
+        sc += cosf(set[i].theta * 0.001f);
+        ss += sinf(set[i].theta * 0.001f);
+    }
+    float mx = sx / count;
+    float my = sy / count;
+    float mt = atan2f(ss, sc);
+
+    float cxx = 0, cxy = 0, cyy = 0, ctt = 0;
+    for (i = 0; i < count; i++) {
+        float dx = set[i].x - mx;
+        float dy = set[i].y - my;
+        float dt = odom_wrapAngle(set[i].theta * 0.001f - mt);
+        cxx += dx * dx;
+        cxy += dx * dy;
+        cyy += dy * dy;
+        ctt += dt * dt;
+    }
+
+    out->pose.x = mx;
+    out->pose.y = my;
+    out->pose.theta = mt;
+    for (i = 0; i < 9; i++) {
+        out->pose.cov[i / 3][i % 3] = 0;
+    }
+    out->pose.cov[0][0] = cxx / count;
+    out->pose.cov[0][1] = out->pose.cov[1][0] = cxy / count;
+    out->pose.cov[1][1] = cyy / count;
+    out->pose.cov[2][2] = ctt / count;
+    out->pose.updates = lastOdom.updates;
+    out->particles = count;
+    out->bins = lastBins;
+}
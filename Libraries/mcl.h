@@ -0,0 +1,134 @@
+/**
+ * Monte Carlo localization against a known course layout
+ * @file mcl.h
+ *
+ * Odometry, the grid and the landmark filter all work in the frame
+ * odom_reset() set up wherever the robot was put down. This module works
+ * out where that is on the course itself. A bounded set of particles, each a
+ * guess at the robot's pose in the course frame, is moved by odometry with
+ * noise, scored against what the robot sees of the course (the skinny posts
+ * from a sweep and the boundary tape under the cliff sensors), and resampled.
+ *
+ * Scores are kept as integer penalties in 1/MCL_PENALTY_PER_BIT bit steps and
+ * turned into Q15 weights with a shift and a small table, so no floating point
+ * is spent on weights. Resampling is low-variance (one random number per
+ * update) and the particle count adapts to how spread out the particles are,
+ * KLD style: MCL_PARTICLES_PER_BIN particles for every occupied pose bin.
+ */
+
+#ifndef MCL_H_
+#define MCL_H_
+
+#include <stdint.h>
+#include "odometry.h"
+
+/// Particle set bounds. Two sets of MCL_MAX_PARTICLES are kept for resampling, 8 bytes each
+#define MCL_MAX_PARTICLES 240
+#define MCL_MIN_PARTICLES 40
+/// Particles wanted per occupied pose bin, and the bin size
+#define MCL_PARTICLES_PER_BIN 8
+#define MCL_BIN_MM 250
+#define MCL_BIN_HEADINGS 8
+#define MCL_BINS_X 20
+#define MCL_BINS_Y 20
+
+/// Most posts a course description can hold
+#define MCL_MAX_POSTS 8
+
+/// Odometry noise, fraction of distance driven and of angle turned, plus heading noise per metre
+#define MCL_NOISE_DIST 0.05f
+#define MCL_NOISE_TURN 0.05f
+#define MCL_NOISE_DRIFT_PER_M 0.05f
+
+/// Position error of a post sighting and of a tape crossing, one standard deviation in mm
+#define MCL_POST_SIGMA_MM 150.0f
+#define MCL_TAPE_SIGMA_MM 60.0f
+/// Cliff sensor position relative to the robot centre, mm. The side offset is positive to the left
+#define MCL_CLIFF_FWD_MM 140.0f
+#define MCL_CLIFF_SIDE_MM 110.0f
+
+/// Penalty units per halving of a particle's weight
+#define MCL_PENALTY_PER_BIT 8
+/// No single sighting can cost more than about 3 sigma, so one false detection can't wipe out the right particles
+#define MCL_MAX_OBS_PENALTY (MCL_PENALTY_PER_BIT * 4)
+/// If even the best particle averages this many bits of penalty per sighting we are probably lost,
+/// so MCL_INJECT_PERCENT of the new set is scattered over the course again
+#define MCL_LOST_BITS_PER_OBS 2
+#define MCL_INJECT_PERCENT 10
+
+/// What is known about the course ahead of time, in its own frame
+typedef struct {
+    int16_t minX;               // boundary tape rectangle, mm
+    int16_t minY;
+    int16_t maxX;
+    int16_t maxY;
+    int numPosts;
+    int16_t postX[MCL_MAX_POSTS];   // skinny post centres, mm
+    int16_t postY[MCL_MAX_POSTS];
+} mcl_field_t;
+
+/// Estimate read back from the particles
+typedef struct {
+    pose_t pose;        // mean pose in the course frame with its covariance
+    int particles;      // particles in use
+    int bins;           // occupied pose bins at the last resample
+} mcl_estimate_t;
+
+/**
+ * @brief Spread particles evenly over the whole course, for when we don't
+ * know where we were put down
+ *
+ * @param field course description, must outlive the filter
+ * @param odom current uncorrected odometry pose, from odom_getRawPose()
+ */
+void mcl_init(const mcl_field_t *field, const pose_t *odom);
+
+/**
+ * @brief Spread particles around a rough idea of where we were put down on
+ * the course. Far more reliable than mcl_init() when the start area is known.
+ *
+ * @param field course description, must outlive the filter
+ * @param odom current uncorrected odometry pose, from odom_getRawPose()
+ * @param start rough pose on the course
+ * @param spread_mm standard deviation of the start position
+ * @param spread_rad standard deviation of the start heading
+ */
+void mcl_initAround(const mcl_field_t *field, const pose_t *odom, const pose_t *start, float spread_mm, float spread_rad);
+
+/**
+ * @brief Move every particle by the odometry motion since the last call, with noise.
+ * Scan match and landmark corrections to odometry are not motion, so this
+ * takes the uncorrected pose.
+ *
+ * @param odom current uncorrected odometry pose, from odom_getRawPose()
+ */
+void mcl_predict(const pose_t *odom);
+
+/**
+ * @brief Score the particles against a skinny post seen in a sweep
+ *
+ * @param range_mm distance from the robot centre to the post
+ * @param bearing heading to the post in radians, positive is left
+ */
+void mcl_observePost(float range_mm, float bearing);
+
+/**
+ * @brief Score the particles against boundary tape under a cliff sensor
+ *
+ * @param leftSide 1 for the left cliff sensors, 0 for the right
+ * @param behind_mm how far the robot has reversed since the tape was seen
+ */
+void mcl_observeTape(int leftSide, float behind_mm);
+
+/**
+ * @brief Turn the scores since the last call into weights and resample,
+ * adapting the particle count. Does nothing if nothing was observed.
+ */
+void mcl_update(void);
+
+/**
+ * @param out filled with the mean pose, its spread and the particle count
+ */
+void mcl_getEstimate(mcl_estimate_t *out);
+
+#endif /* MCL_H_ */
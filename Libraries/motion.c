@@ -0,0 +1,530 @@
+/**
+ * Closed-loop motion controller for the iRobot Create
+ * @file motion.c
+ */
+
+#include "motion.h"
+#include "profile.h"
+#include "hazard.h"
+#include "Timer.h"
+
+#define MOTION_DT (MOTION_PERIOD_MS / 1000.0f)
+#define MOTION_HALF_BASE (ODOM_WHEEL_BASE_MM / 2.0f)
+
+/// Turn rate low pass weight per tick
+#define TURN_RATE_FILTER 0.5f
+/// Below this rate in rad/s (about one encoder tick per period) the robot counts as stopped
+#define TURN_STILL_RATE 0.07f
+#define TURN_STILL_TICKS 2
+/// Only learn from stops made at a meaningful rate, rad/s
+#define TURN_LEARN_RATE 0.2f
+/// Latency samples are clamped to this many seconds and blended in at this weight
+#define TURN_LATENCY_MAX 0.4f
+#define TURN_LATENCY_GAIN 0.3f
+#define TURN_MAX_RETRIES 2
+
+typedef struct {
+    float kp;
+    float ki;
+    float kd;
+    float iLimit;
+    float integral;
+    float prevErr;
+} motion_pid_t;
+
+/// Heading hold while driving, output is the wheel speed difference in mm/s
+static motion_pid_t headingPid = {400.0f, 50.0f, 20.0f, 1.0f, 0, 0};
+/// Turn position loop, output is angular velocity in rad/s
+static motion_pid_t turnPid = {3.0f, 0.5f, 0.1f, 0.5f, 0, 0};
+
+static oi_t *sensors;
+
+typedef struct {
+    float distance;     // mm, signed
+    float angle;        // radians turned so far for turns, signed goal
+    float heading;      // radians, heading to hold while driving or at the start of an arc
+    float curvature;    // radians of heading change per mm of arc
+    float x0, y0;       // start position of a drive, last position on an arc
+    float cosH, sinH;   // unit vector along the drive
+    float turned;       // radians accumulated by a turn
+    float lastTheta;    // heading at the previous tick
+    float travelled;    // mm along the drive heading
+    float omega;        // filtered turn rate, rad/s
+    float stopTurned;   // rotation when the stop was issued
+    float stopOmega;    // turn rate when the stop was issued
+    int coasting;       // wheels stopped, waiting for the robot to settle
+    int stillTicks;     // consecutive ticks without rotation while coasting
+    int retries;        // corrective nudges made after coasting
+    profile_t profile;  // speed ramp, mm/s for drives and rad/s for turns
+    uint32_t ticks;     // ticks since the goal started
+} motion_goal_t;
+
+/// Learned stop latency in seconds for left (0) and right (1) turns
+static float turnLatency[2] = {MOTION_TURN_LATENCY_DEFAULT, MOTION_TURN_LATENCY_DEFAULT};
+
+static volatile motion_mode_t mode = MOTION_IDLE;
+static volatile int result = MOTION_OK;
+static motion_goal_t goal;
+
+/// Kind of the current or last goal, mode drops back to idle when it ends
+static motion_mode_t goalType = MOTION_IDLE;
+/// Set when a goal starts, cleared once motion_poll() has reported it finishing
+static volatile int unreported = 0;
+static motion_callback_t onComplete = 0;
+/// Cruise ceiling for drives and arcs started from now on, mm/s
+static int maxSpeed = MOTION_DRIVE_SPEED;
+/// Light bumper sector that stopped the last goal, -1 if none did
+static int blockedSector = -1;
+
+static float motion_pidStep(motion_pid_t *pid, float err) {
+    pid->integral += err * MOTION_DT;
+    if (pid->integral > pid->iLimit) {
+        pid->integral = pid->iLimit;
+    }
+    else if (pid->integral < -pid->iLimit) {
+        pid->integral = -pid->iLimit;
+    }
+    float deriv = (err - pid->prevErr) / MOTION_DT;
+    pid->prevErr = err;
+    return pid->kp * err + pid->ki * pid->integral + pid->kd * deriv;
+}
+
+static void motion_pidReset(motion_pid_t *pid, float err) {
+    pid->integral = 0;
+    pid->prevErr = err;
+}
+
+static float motion_clamp(float v, float lo, float hi) {
+    if (v < lo) {
+        return lo;
+    }
+    if (v > hi) {
+        return hi;
+    }
+    return v;
+}
+
+static void motion_finish(int outcome) {
+    oi_setWheels(0, 0);
+    result = outcome;
+    mode = MOTION_IDLE;
+}
+
+/**
+ * Forward goals stop on contact, or just short of it when the light bumpers say we're about to touch.
+ * Otherwise the speed is capped by how close things are and the capped speed is returned
+ */
+static int motion_forwardHazards(float *speed) {
+    hazard_t haz;
+    hazard_get(&haz);
+
+    if (haz.contact != MOTION_OK) {
+        motion_finish(haz.contact);
+        return 1;
+    }
+    if (haz.speedScale <= 0) {
+        blockedSector = haz.blockedSector;
+        motion_finish(hazard_isLeftSector(haz.blockedSector) ? MOTION_BLOCKED_LEFT : MOTION_BLOCKED_RIGHT);
+        return 1;
+    }
+
+    //Pull the profile down with us so speeding back up after the obstacle is still acceleration limited
+    float cap = goal.profile.cruise * haz.speedScale;
+    if (*speed > cap) {
+        *speed = cap;
+        goal.profile.vel = cap;
+    }
+    return 0;
+}
+
+/**
+ * Reversing can still carry us over an edge, so a cliff ends a reverse goal too. Tape is fine to back over
+ */
+static int motion_reverseHazards(void) {
+    hazard_t haz;
+    hazard_get(&haz);
+
+    if (haz.contact == MOTION_CLIFF_LEFT || haz.contact == MOTION_CLIFF_RIGHT) {
+        motion_finish(haz.contact);
+        return 1;
+    }
+    return 0;
+}
+
+static void motion_driveTick(const pose_t *pose) {
+    float dir = goal.distance >= 0 ? 1.0f : -1.0f;
+    goal.travelled = (pose->x - goal.x0) * goal.cosH + (pose->y - goal.y0) * goal.sinH;
+    float remaining = (goal.distance - goal.travelled) * dir;
+
+    if (remaining <= MOTION_DIST_TOLERANCE_MM) {
+        motion_finish(MOTION_OK);
+        return;
+    }
+
+    //Ramp up, cruise and brake onto the goal
+    float speed = profile_step(&goal.profile, remaining, MOTION_DT);
+    if (dir > 0 ? motion_forwardHazards(&speed) : motion_reverseHazards()) {
+        return;
+    }
+    if (speed < MOTION_MIN_SPEED) {
+        speed = MOTION_MIN_SPEED;
+    }
+
+    //Positive heading error means we've drifted clockwise, so speed up the right wheel.
+    //Leave the correction enough room that neither wheel exceeds the OI limit
+    float err = odom_wrapAngle(goal.heading - pose->theta);
+    float room = MOTION_WHEEL_LIMIT - speed;
+    if (room > speed) {
+        room = speed;
+    }
+    float corr = motion_clamp(motion_pidStep(&headingPid, err), -room, room);
+
+    oi_setWheels((int16_t)(dir * speed + corr), (int16_t)(dir * speed - corr));
+}
+
+static void motion_arcTick(const pose_t *pose) {
+    float dir = goal.distance >= 0 ? 1.0f : -1.0f;
+    float dx = pose->x - goal.x0;
+    float dy = pose->y - goal.y0;
+    goal.x0 = pose->x;
+    goal.y0 = pose->y;
+    goal.travelled += sqrtf(dx * dx + dy * dy);
+    float remaining = fabsf(goal.distance) - goal.travelled;
+
+    if (remaining <= MOTION_DIST_TOLERANCE_MM) {
+        motion_finish(MOTION_OK);
+        return;
+    }
+
+    float speed = profile_step(&goal.profile, remaining, MOTION_DT);
+    if (dir > 0 ? motion_forwardHazards(&speed) : motion_reverseHazards()) {
+        return;
+    }
+    if (speed < MOTION_MIN_SPEED) {
+        speed = MOTION_MIN_SPEED;
+    }
+
+    //Feed forward the turn rate the arc needs, and hold the heading it should have by now
+    float spin = goal.curvature * speed * MOTION_HALF_BASE;
+    float err = odom_wrapAngle(goal.heading + goal.curvature * goal.travelled - pose->theta);
+    float corr = motion_clamp(motion_pidStep(&headingPid, err), -speed, speed);
+    float right = dir * speed + spin + corr;
+    float left = dir * speed - spin - corr;
+
+    //Tight arcs can push the outer wheel past the OI limit, scale both to keep the curvature
+    float peak = fabsf(right) > fabsf(left) ? fabsf(right) : fabsf(left);
+    if (peak > MOTION_WHEEL_LIMIT) {
+        right *= MOTION_WHEEL_LIMIT / peak;
+        left *= MOTION_WHEEL_LIMIT / peak;
+    }
+
+    oi_setWheels((int16_t)right, (int16_t)left);
+}
+
+static void motion_stopTurn(void) {
+    oi_setWheels(0, 0);
+    goal.coasting = 1;
+    goal.stillTicks = 0;
+    goal.stopTurned = goal.turned;
+    goal.stopOmega = goal.omega;
+}
+
+static void motion_turnTick(const pose_t *pose) {
+    //Accumulate unwrapped rotation so turns of 180 degrees or more keep their direction
+    float step = odom_wrapAngle(pose->theta - goal.lastTheta);
+    goal.turned += step;
+    goal.lastTheta = pose->theta;
+    goal.omega += TURN_RATE_FILTER * (step / MOTION_DT - goal.omega);
+    float err = goal.angle - goal.turned;
+
+    //Wheels are already stopped, wait for the robot to actually stop and see how far it carried on
+    if (goal.coasting) {
+        if (step / MOTION_DT > TURN_STILL_RATE || step / MOTION_DT < -TURN_STILL_RATE) {
+            goal.stillTicks = 0;
+            return;
+        }
+        if (++goal.stillTicks < TURN_STILL_TICKS) {
+            return;
+        }
+
+        //Latency is how long the robot kept rotating at the rate it had when we decided to stop
+        //Filed under the way we were spinning then, since a corrective nudge can run against the goal
+        if (goal.stopOmega > TURN_LEARN_RATE || goal.stopOmega < -TURN_LEARN_RATE) {
+            int side = goal.stopOmega > 0 ? 0 : 1;
+            float sample = motion_clamp((goal.turned - goal.stopTurned) / goal.stopOmega, 0, TURN_LATENCY_MAX);
+            turnLatency[side] += TURN_LATENCY_GAIN * (sample - turnLatency[side]);
+        }
+
+        if ((err < MOTION_ANGLE_TOLERANCE && err > -MOTION_ANGLE_TOLERANCE) || goal.retries >= TURN_MAX_RETRIES) {
+            motion_finish(MOTION_OK);
+            return;
+        }
+
+        //Still off by more than the tolerance, nudge the rest of the way
+        goal.retries++;
+        goal.coasting = 0;
+        profile_init(&goal.profile, err, MOTION_TURN_RATE, MOTION_TURN_ACCEL, MOTION_TURN_DECEL, 0);
+        motion_pidReset(&turnPid, err);
+        return;
+    }
+
+    if (err < MOTION_ANGLE_TOLERANCE && err > -MOTION_ANGLE_TOLERANCE) {
+        motion_stopTurn();
+        return;
+    }
+
+    //Stop early when the rotation still in flight after the stop command will carry us onto the goal
+    int side = goal.omega >= 0 ? 0 : 1;
+    if (err * goal.omega > 0 && fabsf(err) <= fabsf(goal.omega) * turnLatency[side]) {
+        motion_stopTurn();
+        return;
+    }
+
+    //The profile bounds how fast the PID may spin us, which gives the ramp up and braking curve
+    float limit = profile_step(&goal.profile, err, MOTION_DT);
+    float omega = motion_clamp(motion_pidStep(&turnPid, err), -limit, limit);
+    float wheel = omega * MOTION_HALF_BASE;
+
+    //The braking curve reaches zero right at the goal, so keep creeping toward it
+    if (err > 0 && wheel < MOTION_MIN_SPEED) {
+        wheel = MOTION_MIN_SPEED;
+    }
+    else if (err < 0 && wheel > -MOTION_MIN_SPEED) {
+        wheel = -MOTION_MIN_SPEED;
+    }
+
+    oi_setWheels((int16_t)wheel, (int16_t)-wheel);
+}
+
+/**
+ * Runs from the TIMER4 interrupt every MOTION_PERIOD_MS
+ */
+static void motion_tick(void) {
+    pose_t pose;
+
+    //Odometry is integrated inside the packet parser
+    oi_updateFast(sensors);
+    odom_getPose(&pose);
+    hazard_update(sensors);
+
+    if (mode == MOTION_IDLE) {
+        return;
+    }
+
+    if (++goal.ticks > MOTION_TIMEOUT_MS / MOTION_PERIOD_MS) {
+        motion_finish(MOTION_TIMEOUT);
+        return;
+    }
+
+    if (mode == MOTION_DRIVE) {
+        motion_driveTick(&pose);
+    }
+    else if (mode == MOTION_TURN) {
+        motion_turnTick(&pose);
+    }
+    else if (mode == MOTION_ARC) {
+        motion_arcTick(&pose);
+    }
+}
+
+void motion_init(oi_t *sensor_data) {
+    sensors = sensor_data;
+    mode = MOTION_IDLE;
+    timer_fireEvery(motion_tick, MOTION_PERIOD_MS);
+}
+
+void motion_close(void) {
+    timer_fireStop();
+    mode = MOTION_IDLE;
+    oi_setWheels(0, 0);
+}
+
+/**
+ * A new goal replaces whatever was running. The old one finishes as cancelled and its callback
+ * still fires, so nobody waiting on it is left hanging
+ */
+static void motion_preempt(motion_mode_t type) {
+    if (mode != MOTION_IDLE) {
+        motion_cancel();
+    }
+    if (unreported) {
+        motion_poll(0);
+    }
+    onComplete = 0;
+    goalType = type;
+}
+
+void motion_drive(int distance_mm) {
+    pose_t pose;
+    motion_preempt(MOTION_DRIVE);
+    odom_getPose(&pose);
+
+    bool wasDisabled = IntMasterDisable();
+    goal.distance = distance_mm;
+    goal.heading = pose.theta;
+    goal.x0 = pose.x;
+    goal.y0 = pose.y;
+    goal.cosH = cosf(pose.theta);
+    goal.sinH = sinf(pose.theta);
+    goal.travelled = 0;
+    goal.ticks = 0;
+    profile_init(&goal.profile, distance_mm, maxSpeed, MOTION_DRIVE_ACCEL, MOTION_DRIVE_DECEL, 0);
+    motion_pidReset(&headingPid, 0);
+    result = MOTION_OK;
+    unreported = 1;
+    blockedSector = -1;
+    mode = MOTION_DRIVE;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void motion_turn(float degrees) {
+    pose_t pose;
+    motion_preempt(MOTION_TURN);
+    odom_getPose(&pose);
+
+    bool wasDisabled = IntMasterDisable();
+    goal.angle = degrees * (M_PI / 180.0f);
+    goal.turned = 0;
+    goal.lastTheta = pose.theta;
+    goal.travelled = 0;
+    goal.ticks = 0;
+    goal.omega = 0;
+    goal.coasting = 0;
+    goal.retries = 0;
+    profile_init(&goal.profile, goal.angle, MOTION_TURN_RATE, MOTION_TURN_ACCEL, MOTION_TURN_DECEL, 0);
+    motion_pidReset(&turnPid, goal.angle);
+    result = MOTION_OK;
+    unreported = 1;
+    blockedSector = -1;
+    mode = MOTION_TURN;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void motion_arc(float degrees, int distance_mm) {
+    pose_t pose;
+
+    if (distance_mm == 0) {
+        motion_turn(degrees);
+        return;
+    }
+
+    motion_preempt(MOTION_ARC);
+    odom_getPose(&pose);
+
+    float angle = degrees * (M_PI / 180.0f);
+    float length = fabsf((float)distance_mm);
+    float curvature = angle / length;
+
+    //The outer wheel runs faster than the centre of the robot, so cap the centre speed to match
+    float cruise = maxSpeed / (1.0f + fabsf(curvature) * MOTION_HALF_BASE);
+
+    bool wasDisabled = IntMasterDisable();
+    goal.distance = distance_mm;
+    goal.curvature = curvature;
+    goal.heading = pose.theta;
+    goal.x0 = pose.x;
+    goal.y0 = pose.y;
+    goal.travelled = 0;
+    goal.ticks = 0;
+    profile_init(&goal.profile, length, cruise, MOTION_DRIVE_ACCEL, MOTION_DRIVE_DECEL, 0);
+    motion_pidReset(&headingPid, 0);
+    result = MOTION_OK;
+    unreported = 1;
+    blockedSector = -1;
+    mode = MOTION_ARC;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void motion_start(const motion_cmd_t *cmd) {
+    if (cmd->type == MOTION_DRIVE) {
+        motion_drive(cmd->distance_mm);
+    }
+    else if (cmd->type == MOTION_TURN) {
+        motion_turn(cmd->degrees);
+    }
+    else if (cmd->type == MOTION_ARC) {
+        motion_arc(cmd->degrees, cmd->distance_mm);
+    }
+    else {
+        return;
+    }
+    onComplete = cmd->onComplete;
+}
+
+int motion_poll(motion_result_t *out) {
+    motion_result_t res;
+    pose_t pose;
+    odom_getPose(&pose);
+
+    bool wasDisabled = IntMasterDisable();
+    int busy = mode != MOTION_IDLE;
+    int report = !busy && unreported;
+    res.status = busy ? MOTION_OK : result;
+    res.travelled = goal.travelled;
+    if (goalType == MOTION_TURN) {
+        res.turned = goal.turned * (180.0f / M_PI);
+    }
+    else {
+        res.turned = odom_wrapAngle(pose.theta - goal.heading) * (180.0f / M_PI);
+    }
+    res.elapsedMs = goal.ticks * MOTION_PERIOD_MS;
+    res.blockedSector = blockedSector;
+    if (report) {
+        unreported = 0;
+    }
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+
+    if (out) {
+        *out = res;
+    }
+
+    //Callbacks run here in the main loop, never in the interrupt, so they're free to print or start another move
+    if (report && onComplete) {
+        motion_callback_t cb = onComplete;
+        onComplete = 0;
+        cb(&res);
+    }
+    return !busy;
+}
+
+void motion_cancel(void) {
+    bool wasDisabled = IntMasterDisable();
+    if (mode != MOTION_IDLE) {
+        motion_finish(MOTION_CANCELLED);
+    }
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+int motion_isBusy(void) {
+    return mode != MOTION_IDLE;
+}
+
+void motion_setMaxSpeed(int speed) {
+    //Keeping below the wheel limit leaves the heading hold room to steer
+    if (speed > MOTION_DRIVE_SPEED) {
+        speed = MOTION_DRIVE_SPEED;
+    }
+    else if (speed < MOTION_MIN_SPEED) {
+        speed = MOTION_MIN_SPEED;
+    }
+    maxSpeed = speed;
+}
+
+float motion_getTurnLatency(int right) {
+    return turnLatency[right ? 1 : 0];
+}
+
+void motion_setTurnLatency(float left, float right) {
+    turnLatency[0] = left;
+    turnLatency[1] = right;
+}
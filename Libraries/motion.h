@@ -0,0 +1,193 @@
+/**
+ * Closed-loop motion controller for the iRobot Create
+ * @file motion.h
+ *
+ * A TIMER4 interrupt runs every MOTION_PERIOD_MS. Each tick it refreshes the
+ * sensor struct passed to motion_init(), updates odometry and runs the active
+ * goal: a heading-hold PID for straight drives or a heading position PID for
+ * in-place turns, both speed limited by a trapezoidal profile (profile.h).
+ * Goals are handed in from the main loop with motion_start() and the main
+ * loop is free to do other work, calling motion_poll() to find out when the
+ * goal is done. A new goal or motion_cancel() preempts the running one
+ * immediately.
+ *
+ * Once motion_init() has been called the interrupt owns the OI serial link, so
+ * nothing else may call oi_update() or oi_setWheels().
+ *
+ * Timing budget: the sensor exchange is 2 bytes out and 80 back at 115200
+ * baud, about 7ms of each 30ms tick spent polling the UART, and the control
+ * step after it is well under 1ms. TIMER4 therefore runs at the lowest
+ * priority: UART1 and the ping capture (priority 1) preempt it, and the clock
+ * tick (TIMER5, also 7, every 65ms) just waits its turn, which it can afford
+ * since a tick is only late by the 7ms, never lost. The main loop keeps the
+ * remaining ~75% of the CPU.
+ */
+
+#ifndef MOTION_H_
+#define MOTION_H_
+
+#include "open_interface.h"
+#include "odometry.h"
+
+/// Control period. The OI needs at least 15ms between sensor queries
+#define MOTION_PERIOD_MS 30
+
+/// The OI rejects wheel speeds beyond +-500 mm/s
+#define MOTION_WHEEL_LIMIT 500
+/// Default cruise ceiling for straight drives in mm/s, leaves headroom for heading correction
+#define MOTION_DRIVE_SPEED 450
+/// Straight drive ramp rates in mm/s^2, kept low enough that the wheels don't slip
+#define MOTION_DRIVE_ACCEL 400.0f
+#define MOTION_DRIVE_DECEL 400.0f
+/// Slowest useful wheel speed; below this the Create stalls
+#define MOTION_MIN_SPEED 20
+/// Turn rate ceiling in rad/s (about 290 mm/s at each wheel) and its ramp rates in rad/s^2
+#define MOTION_TURN_RATE 2.5f
+#define MOTION_TURN_ACCEL 6.0f
+#define MOTION_TURN_DECEL 6.0f
+
+/// A drive is complete once it is within this many mm of the goal
+#define MOTION_DIST_TOLERANCE_MM 5.0f
+/// A turn is complete once it is within this many radians of the goal (1 degree)
+#define MOTION_ANGLE_TOLERANCE 0.0175f
+/// Starting guess for the turn stop latency in seconds, refined after every turn
+#define MOTION_TURN_LATENCY_DEFAULT 0.06f
+/// Give up on a goal that has not converged after this long
+#define MOTION_TIMEOUT_MS 20000
+
+/// Goal outcomes. The first five match the codes move_forward() has always returned
+#define MOTION_OK 0
+#define MOTION_BUMP_LEFT 1
+#define MOTION_BUMP_RIGHT 2
+#define MOTION_BOUND_LEFT 4
+#define MOTION_BOUND_RIGHT 5
+#define MOTION_CLIFF_LEFT 6
+#define MOTION_CLIFF_RIGHT 7
+#define MOTION_TIMEOUT 8
+#define MOTION_CANCELLED 9
+/// Stopped short of an obstacle the light bumpers saw on the left or right half
+#define MOTION_BLOCKED_LEFT 10
+#define MOTION_BLOCKED_RIGHT 11
+
+typedef enum {
+    MOTION_IDLE,
+    MOTION_DRIVE,
+    MOTION_TURN,
+    MOTION_ARC
+} motion_mode_t;
+
+/// Outcome and progress of a goal
+typedef struct {
+    int status;         // MOTION_* outcome, MOTION_OK while still running
+    float travelled;    // mm along the heading for drives, path length for arcs
+    float turned;       // degrees of heading change, positive is counter-clockwise
+    uint32_t elapsedMs; // time since the goal started
+    int blockedSector;  // HAZARD_SECTOR_* that stopped the goal, -1 if none
+} motion_result_t;
+
+/// Completion callback, called once from motion_poll() in the main loop
+typedef void (*motion_callback_t)(const motion_result_t *result);
+
+/// A goal for motion_start()
+typedef struct {
+    motion_mode_t type;             // MOTION_DRIVE, MOTION_TURN or MOTION_ARC
+    int distance_mm;                // drives and arcs, negative to reverse
+    float degrees;                  // turns and arcs, positive is counter-clockwise
+    motion_callback_t onComplete;   // may be 0
+} motion_cmd_t;
+
+/**
+ * @brief Start the control interrupt. Call once after oi_init().
+ *
+ * @param sensor_data sensor struct the interrupt keeps up to date
+ */
+void motion_init(oi_t *sensor_data);
+
+/**
+ * @brief Stop the robot and the control interrupt, handing the OI back to the
+ * main loop. Call before oi_free().
+ */
+void motion_close(void);
+
+/**
+ * @brief Drive straight, holding the heading the robot had when called.
+ * Forward drives slow down as the light bumpers see something coming, stop
+ * just short of it, and stop early on a bump, boundary tape or cliff.
+ * Reverse drives stop on a cliff.
+ *
+ * @param distance_mm distance to travel, negative to reverse
+ */
+void motion_drive(int distance_mm);
+
+/**
+ * @brief Turn in place relative to the current heading
+ *
+ * @param degrees angle to turn, positive is counter-clockwise (left)
+ */
+void motion_turn(float degrees);
+
+/**
+ * @brief Drive a constant curvature arc that changes the heading by the given
+ * angle over the given path length, in one continuous motion. Forward arcs
+ * stop early on a bump, boundary tape or cliff like motion_drive().
+ *
+ * @param degrees heading change over the arc, positive is counter-clockwise (left)
+ * @param distance_mm path length along the arc, negative to reverse
+ */
+void motion_arc(float degrees, int distance_mm);
+
+/**
+ * @brief Start a goal without waiting for it. Anything already running is
+ * cancelled first and its callback sees MOTION_CANCELLED.
+ *
+ * @param cmd goal to run
+ */
+void motion_start(const motion_cmd_t *cmd);
+
+/**
+ * @brief Check on the current or last goal. The first call after the goal
+ * finishes also runs its onComplete callback.
+ *
+ * @param out filled with the outcome so far, may be 0
+ * @return 1 once the goal has finished, 0 while it is still running
+ */
+int motion_poll(motion_result_t *out);
+
+/**
+ * @brief Stop the wheels and end the current goal as MOTION_CANCELLED
+ */
+void motion_cancel(void);
+
+/**
+ * @return 1 while a goal is being executed, 0 once it has finished
+ */
+int motion_isBusy(void);
+
+/**
+ * @brief Set the cruise ceiling for drives and arcs started after this call,
+ * e.g. from the clearance the last sweep showed (speedsched.h)
+ *
+ * @param speed mm/s, clamped to MOTION_MIN_SPEED..MOTION_DRIVE_SPEED
+ */
+void motion_setMaxSpeed(int speed);
+
+/**
+ * @brief Learned turn stop latency. Turns are stopped early by the filtered
+ * turn rate times this latency, and it is re-estimated from how far the robot
+ * coasts after every stop.
+ *
+ * @param right 0 for left (counter-clockwise) turns, 1 for right turns
+ * @return latency in seconds
+ */
+float motion_getTurnLatency(int right);
+
+/**
+ * @brief Seed the turn stop latency for a particular robot, e.g. with values
+ * read back from motion_getTurnLatency() on a previous run
+ *
+ * @param left latency for left turns in seconds
+ * @param right latency for right turns in seconds
+ */
+void motion_setTurnLatency(float left, float right);
+
+#endif /* MOTION_H_ */
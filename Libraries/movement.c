@@ -3,133 +3,136 @@
 //
 
 #include "movement.h"
+#include "motion.h"
 #include "uart-interrupt.h"
 
-#define LEFT_TURN_OFFSET 0
-#define RIGHT_TURN_OFFSET 0
-
-int move_forward(oi_t *sensor_data, int distance_mm) {
-    char str[50] = {'\0'};
-    sprintf(str, "!GOING FORWARD %d cm\r\n", distance_mm / 10);
-    uart_sendStr(str);
-    oi_setWheels(150, 150);
-    int sum = 0;
-
-    while (sum < distance_mm) {
-        oi_update(sensor_data);
-        sum += sensor_data->distance;
+/*
+ * The motion controller does the actual work from its timer interrupt, these just hand it a goal and wait.
+ * The stop key cancels the move right away instead of after it ends
+ */
+static void waitForMotion(motion_result_t *result) {
+    while (!motion_poll(result)) {
+        if (!goCmd) {
+            motion_cancel();
+        }
+    }
+}
 
-        if (sensor_data->bumpLeft) {
+int move_reportHazard(int status) {
+    switch (status) {
+        case MOTION_BUMP_LEFT:
             uart_sendStr("!LEFT BUMP DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 1;
-        }
-        else if (sensor_data->bumpRight) {
+            return MOTION_BUMP_LEFT;
+        case MOTION_BUMP_RIGHT:
             uart_sendStr("!RIGHT BUMP DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 2;
-        }
-        //If we have a left sensor detection
-        else if (sensor_data->cliffFrontLeftSignal > 2500 ||
-                 sensor_data->cliffLeftSignal > 2500) {
+            return MOTION_BUMP_RIGHT;
+        case MOTION_BOUND_LEFT:
             uart_sendStr("!LEFT BOUND DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 4;
-        }
-        else if (sensor_data->cliffFrontLeftSignal < 500 || sensor_data->cliffLeftSignal < 500) {
+            return MOTION_BOUND_LEFT;
+        case MOTION_CLIFF_LEFT:
             uart_sendStr("!LEFT CLIFF DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 4;
-        }
-        //If we have a right sensor detection
-        else if(sensor_data->cliffFrontRightSignal > 2500 ||
-                sensor_data->cliffRightSignal > 2500) {
+            return MOTION_BOUND_LEFT;
+        case MOTION_BOUND_RIGHT:
             uart_sendStr("!RIGHT BOUND DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 5;
-        }
-        else if (sensor_data->cliffFrontRightSignal < 500 || sensor_data->cliffRightSignal < 500) {
+            return MOTION_BOUND_RIGHT;
+        case MOTION_CLIFF_RIGHT:
             uart_sendStr("!RIGHT CLIFF DETECTED\r\n");
-            oi_setWheels(0,0);
-            move_backward(sensor_data, sum);
-            return 5;
-        }
+            return MOTION_BOUND_RIGHT;
+        case MOTION_BLOCKED_LEFT:
+            uart_sendStr("!LEFT OBSTACLE AHEAD\r\n");
+            return MOTION_BUMP_LEFT;
+        case MOTION_BLOCKED_RIGHT:
+            uart_sendStr("!RIGHT OBSTACLE AHEAD\r\n");
+            return MOTION_BUMP_RIGHT;
+        case MOTION_CANCELLED:
+            uart_sendStr("!MOVE CANCELLED\r\n");
+            return 0;
+        default:
+            return 0;
     }
-    oi_setWheels(0,0);
-    return 0;
+}
+
+int move_forward(oi_t *sensor_data, int distance_mm) {
+    (void)sensor_data;
+    char str[50] = {'\0'};
+    sprintf(str, "!GOING FORWARD %d cm\r\n", distance_mm / 10);
+    uart_sendStr(str);
+
+    motion_result_t result;
+    motion_drive(distance_mm);
+    waitForMotion(&result);
+    return move_reportHazard(result.status);
 }
 
 void move_backward(oi_t *sensor_data, int distance_mm) {
+    //Kept for the old callers, the motion controller owns the OI now
+    (void)sensor_data;
     char str[50] = {'\0'};
     sprintf(str, "!GOING BACKWARD %d cm\r\n", distance_mm / 10);
     uart_sendStr(str);
 
-    oi_setWheels(-175,-175);
-    int sum = distance_mm;
-
-    while (sum > 0) {
-        oi_update(sensor_data);
-        sum += sensor_data->distance;
+    if (distance_mm <= 0) {
+        return;
     }
 
-    oi_setWheels(0, 0);
+    motion_drive(-distance_mm);
+    waitForMotion(0);
 }
 
 int turnLeftAngle(oi_t *sensor_data, int angleToTurnTo) {
+    (void)sensor_data;
     char str[50] = {'\0'};
     sprintf(str, "!TURNING LEFT %d degrees\r\n", angleToTurnTo);
     uart_sendStr(str);
 
-    double sum = 0;
-    oi_setWheels(100, -100);
-
-    //If we have an object that's closer than whatever our left turn angular offset is, just turn left to half of the offset degrees
-    if (angleToTurnTo - LEFT_TURN_OFFSET <= 0) {
-        while (sum < LEFT_TURN_OFFSET / 2) {
-            oi_update(sensor_data);
-            sum += sensor_data->angle;
-        }
-        oi_setWheels(0, 0);
+    //Left turns are positive, anything else is a no-op
+    if (angleToTurnTo <= 0) {
         return -1;
     }
 
-    while (sum < angleToTurnTo - LEFT_TURN_OFFSET) {
-        oi_update(sensor_data);
-        sum += sensor_data->angle;
-    }
-    oi_setWheels(0, 0);
+    //Overshoot is cancelled by the controller's learned stop latency, no hand tuned offset needed
+    motion_turn(angleToTurnTo);
+    waitForMotion(0);
     return 0;
 }
 
 int turnRightAngle(oi_t *sensor_data, int angleToTurnTo) {
+    (void)sensor_data;
     char str[50] = {'\0'};
     sprintf(str, "!TURNING RIGHT %d degrees\r\n", angleToTurnTo);
     uart_sendStr(str);
 
-    double sum = 0;
-    int corrAngle = angleToTurnTo + RIGHT_TURN_OFFSET;
-
-    //If our angle to turn right is less than the offset, then just turn right amount of offset divided by 2
-    if (corrAngle >= 0) {
-        oi_setWheels(-100, 100);
-        while(sum > RIGHT_TURN_OFFSET / 2) {
-            oi_update(sensor_data);
-            sum += sensor_data->angle;
-        }
-        oi_setWheels(0, 0);
+    //Right turns are negative, anything else is a no-op
+    if (angleToTurnTo >= 0) {
         return -1;
     }
 
-    oi_setWheels(-100, 100);
-    while(sum > corrAngle) {
-        oi_update(sensor_data);
-        sum += sensor_data->angle;
-    }
-    oi_setWheels(0,0);
+    motion_turn(angleToTurnTo);
+    waitForMotion(0);
     return 0;
 }
+
+int move_arcToLegs(int bearing, int distance_mm, motion_callback_t onComplete, motion_cmd_t legs[2]) {
+    int n = 0;
+
+    //Wide bearings make wide, slow arcs, so swing most of the way in place first
+    if (bearing > ARC_MAX_BEARING || bearing < -ARC_MAX_BEARING) {
+        int arcPart = bearing > 0 ? ARC_MAX_BEARING : -ARC_MAX_BEARING;
+        motion_cmd_t turn = {MOTION_TURN, 0, bearing - arcPart, onComplete};
+        legs[n++] = turn;
+        bearing = arcPart;
+    }
+
+    if (bearing == 0) {
+        motion_cmd_t drive = {MOTION_DRIVE, distance_mm, 0, onComplete};
+        legs[n++] = drive;
+        return n;
+    }
+
+    //A circle tangent to our heading through the target point turns by twice the bearing, and its arc
+    //is longer than the straight line chord by phi / sin(phi)
+    float phi = bearing * (M_PI / 180.0);
+    motion_cmd_t arc = {MOTION_ARC, (int)(distance_mm * phi / sinf(phi)), 2 * bearing, onComplete};
+    legs[n++] = arc;
+    return n;
+}
@@ -6,7 +6,16 @@
 #define CPRE288_PROJECT_MOVEMENT_H
 
 #include "open_interface.h"
+#include "motion.h"
 
+//Widest bearing move_arcToLegs() will cover purely with an arc
+#define ARC_MAX_BEARING 45
+
+/**
+ * The blocking moves below hand their goal to the motion controller and wait for it. They give up as soon as
+ * goCmd drops. Nothing is backed off after a hazard, that's left to the caller. For moves that don't block the main
+ * loop use motion_start() and motion_poll() directly.
+ */
 int move_forward(oi_t *sensor_data, int distance_mm);
 
 void move_backward(oi_t *sensor_data, int distance_mm);
@@ -15,5 +24,20 @@ int turnLeftAngle(oi_t *sensor_data, int angleToTurnTo);
 
 int turnRightAngle(oi_t *sensor_data, int angleToTurnTo);
 
+/**
+ * The goals that curve onto a point at the given bearing (degrees, positive is left, 0 is straight ahead) and
+ * distance without stopping to turn first, for callers that start them one at a time with motion_start(): an
+ * optional turn in place for bearings wider than ARC_MAX_BEARING, then an arc or straight drive. Nothing is backed
+ * off after a hazard. Returns how many of legs[] were filled in, 1 or 2.
+ */
+int move_arcToLegs(int bearing, int distance_mm, motion_callback_t onComplete, motion_cmd_t legs[2]);
+
+
+/**
+ * Report a finished goal's hazard over UART and map it to the codes callers have always checked:
+ * 1 left bump, 2 right bump, 4 left tape/cliff, 5 right tape/cliff, 0 nothing hit or cancelled.
+ * Stopping short of an obstacle seen by the light bumpers reports like a bump on that side.
+ */
+int move_reportHazard(int status);
 
 #endif //CPRE288_PROJECT_MOVEMENT_H
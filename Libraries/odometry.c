@@ -0,0 +1,171 @@
+/**
+ * Dead-reckoning pose estimator for the iRobot Create
+ * @file odometry.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "odometry.h"
+
+#define ODOM_PI 3.14159265f
+
+static pose_t pose;
+//The same integration without any odom_correct() shifts, for filters that must only see real motion
+static pose_t raw;
+static int16_t prevLeft;
+static int16_t prevRight;
+static int seeded = 0;
+
+void odom_reset(float x, float y, float theta) {
+    bool wasDisabled = IntMasterDisable();
+
+    pose.x = x;
+    pose.y = y;
+    pose.theta = odom_wrapAngle(theta);
+    memset(pose.cov, 0, sizeof(pose.cov));
+    pose.updates = 0;
+    raw = pose;
+
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void odom_correct(float dx, float dy, float dtheta, float xyVariance, float thetaVariance) {
+    float limit[3] = {xyVariance, xyVariance, thetaVariance};
+    float scale[3];
+    int i, j;
+    bool wasDisabled = IntMasterDisable();
+
+    pose.x += dx;
+    pose.y += dy;
+    pose.theta = odom_wrapAngle(pose.theta + dtheta);
+
+    //Scaling row and column i by the same factor keeps the covariance positive definite
+    for (i = 0; i < 3; i++) {
+        scale[i] = pose.cov[i][i] > limit[i] ? sqrtf(limit[i] / pose.cov[i][i]) : 1.0f;
+    }
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            pose.cov[i][j] *= scale[i] * scale[j];
+        }
+    }
+
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void odom_update(int16_t leftCount, int16_t rightCount) {
+    if (!seeded) {
+        prevLeft = leftCount;
+        prevRight = rightCount;
+        seeded = 1;
+        return;
+    }
+
+    //Subtracting as unsigned then narrowing handles the 65535 -> 0 rollover in either direction
+    int16_t leftTicks = (int16_t)((uint16_t)leftCount - (uint16_t)prevLeft);
+    int16_t rightTicks = (int16_t)((uint16_t)rightCount - (uint16_t)prevRight);
+    prevLeft = leftCount;
+    prevRight = rightCount;
+
+    if (leftTicks > ODOM_MAX_TICKS_PER_UPDATE || leftTicks < -ODOM_MAX_TICKS_PER_UPDATE ||
+        rightTicks > ODOM_MAX_TICKS_PER_UPDATE || rightTicks < -ODOM_MAX_TICKS_PER_UPDATE) {
+        return;
+    }
+
+    float dl = leftTicks * ODOM_MM_PER_TICK;
+    float dr = rightTicks * ODOM_MM_PER_TICK;
+    float ds = (dr + dl) * 0.5f;
+    float dth = (dr - dl) / ODOM_WHEEL_BASE_MM;
+
+    //Midpoint heading gives second order accuracy on arcs for the same cost
+    float thMid = pose.theta + dth * 0.5f;
+    float c = cosf(thMid);
+    float s = sinf(thMid);
+
+    /*
+     * Covariance propagation, P = F P F' + G Q G'
+     * F = [1 0 -ds*s; 0 1 ds*c; 0 0 1] is the jacobian w.r.t. the pose,
+     * G is the jacobian w.r.t. (dr, dl) and Q = diag(k|dr|, k|dl|)
+     */
+    float a = -ds * s;
+    float b = ds * c;
+    float (*P)[3] = pose.cov;
+
+    //FP = F * P
+    float fp00 = P[0][0] + a * P[2][0];
+    float fp01 = P[0][1] + a * P[2][1];
+    float fp02 = P[0][2] + a * P[2][2];
+    float fp11 = P[1][1] + b * P[2][1];
+    float fp12 = P[1][2] + b * P[2][2];
+
+    //(F * P) * F'
+    float p00 = fp00 + fp02 * a;
+    float p01 = fp01 + fp02 * b;
+    float p02 = fp02;
+    float p11 = fp11 + fp12 * b;
+    float p12 = fp12;
+    float p22 = P[2][2];
+
+    float k = ds * 0.5f / ODOM_WHEEL_BASE_MM;
+    float gxr = 0.5f * c - k * s;
+    float gxl = 0.5f * c + k * s;
+    float gyr = 0.5f * s + k * c;
+    float gyl = 0.5f * s - k * c;
+    float gt = 1.0f / ODOM_WHEEL_BASE_MM;
+    float qr = ODOM_WHEEL_VARIANCE * fabsf(dr);
+    float ql = ODOM_WHEEL_VARIANCE * fabsf(dl);
+
+    p00 += gxr * gxr * qr + gxl * gxl * ql;
+    p01 += gxr * gyr * qr + gxl * gyl * ql;
+    p02 += gxr * gt * qr - gxl * gt * ql;
+    p11 += gyr * gyr * qr + gyl * gyl * ql;
+    p12 += gyr * gt * qr - gyl * gt * ql;
+    p22 += gt * gt * (qr + ql);
+
+    P[0][0] = p00;
+    P[0][1] = P[1][0] = p01;
+    P[0][2] = P[2][0] = p02;
+    P[1][1] = p11;
+    P[1][2] = P[2][1] = p12;
+    P[2][2] = p22;
+
+    pose.x += ds * c;
+    pose.y += ds * s;
+    pose.theta = odom_wrapAngle(pose.theta + dth);
+    pose.updates++;
+
+    float rawMid = raw.theta + dth * 0.5f;
+    raw.x += ds * cosf(rawMid);
+    raw.y += ds * sinf(rawMid);
+    raw.theta = odom_wrapAngle(raw.theta + dth);
+    raw.updates++;
+}
+
+void odom_getPose(pose_t *out) {
+    bool wasDisabled = IntMasterDisable();
+    *out = pose;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+void odom_getRawPose(pose_t *out) {
+    bool wasDisabled = IntMasterDisable();
+    *out = raw;
+    if (!wasDisabled) {
+        IntMasterEnable();
+    }
+}
+
+float odom_wrapAngle(float rad) {
+    while (rad > ODOM_PI) {
+        rad -= 2.0f * ODOM_PI;
+    }
+    while (rad <= -ODOM_PI) {
+        rad += 2.0f * ODOM_PI;
+    }
+    return rad;
+}
@@ -0,0 +1,100 @@
+/**
+ * Dead-reckoning pose estimator for the iRobot Create
+ * @file odometry.h
+ *
+ * Integrates the raw wheel encoder counts reported by every oi_update() into a
+ * 2D pose (x, y, theta) and grows the pose covariance with distance travelled.
+ * The world frame is fixed by odom_reset(): +x is straight ahead of the robot,
+ * +y is to its left and theta is counter-clockwise positive (same sign as
+ * oi_t.angle).
+ */
+
+#ifndef ODOMETRY_H_
+#define ODOMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driverlib/interrupt.h"
+
+/// Encoder geometry, matches the constants used in open_interface.c
+#define ODOM_MM_PER_TICK (72.0f * 3.14159265f / 508.8f)
+#define ODOM_WHEEL_BASE_MM 235.0f
+
+/// Wheel slip variance growth in mm^2 per mm travelled by each wheel
+#define ODOM_WHEEL_VARIANCE 0.5f
+
+/// Any encoder jump larger than this in a single update is treated as a corrupt packet
+#define ODOM_MAX_TICKS_PER_UPDATE 2000
+
+/// Servo angles and bearings are kept in degrees, poses in radians
+#define DEG_TO_RAD (3.14159265f / 180.0f)
+
+/// Snapshot of the robot pose
+typedef struct {
+    float x;            // mm
+    float y;            // mm
+    float theta;        // radians, wrapped to (-pi, pi]
+    float cov[3][3];    // covariance of (x, y, theta)
+    uint32_t updates;   // number of encoder updates integrated since odom_reset()
+} pose_t;
+
+/**
+ * @brief Set the current pose and clear the covariance. The encoder reference
+ * is kept, so this may be called at any time without losing a partial update.
+ *
+ * @param x position in mm
+ * @param y position in mm
+ * @param theta heading in radians
+ */
+void odom_reset(float x, float y, float theta);
+
+/**
+ * @brief Shift the pose by a correction from an outside reference such as a
+ * scan match, and shrink the covariance to no more than that reference's
+ * uncertainty
+ *
+ * @param dx x correction in mm
+ * @param dy y correction in mm
+ * @param dtheta heading correction in radians
+ * @param xyVariance variance of the corrected x and y in mm^2
+ * @param thetaVariance variance of the corrected heading in rad^2
+ */
+void odom_correct(float dx, float dy, float dtheta, float xyVariance, float thetaVariance);
+
+/**
+ * @brief Integrate one encoder reading. Called from oi_parsePacket() on every
+ * sensor update, so it costs a fixed handful of single precision operations.
+ * The first call only seeds the encoder reference.
+ *
+ * @param leftCount raw left encoder count (16 bit, wraps)
+ * @param rightCount raw right encoder count (16 bit, wraps)
+ */
+void odom_update(int16_t leftCount, int16_t rightCount);
+
+/**
+ * @brief Copy the current pose out atomically. Safe to call from the main
+ * loop while odom_update() runs from an interrupt.
+ *
+ * @param out destination for the snapshot
+ */
+void odom_getPose(pose_t *out);
+
+/**
+ * @brief Copy out the pose integrated from the encoders alone, which
+ * odom_correct() never touches. Differences between two of these are only
+ * ever real motion, so filters that keep their own estimate (mcl.h) predict
+ * from this rather than odom_getPose(). The covariance is left at zero.
+ *
+ * @param out destination for the snapshot
+ */
+void odom_getRawPose(pose_t *out);
+
+/**
+ * @brief Wrap an angle to (-pi, pi]
+ *
+ * @param rad angle in radians
+ * @return equivalent angle in (-pi, pi]
+ */
+float odom_wrapAngle(float rad);
+
+#endif /* ODOMETRY_H_ */
@@ -16,6 +16,7 @@
  */
 
 #include "open_interface.h"
+#include "odometry.h"
 
 #define OI_OPCODE_START 128
 #define OI_OPCODE_BAUD 129
@@ -173,6 +174,16 @@ void oi_close()
 
 /// Update all sensor and store in oi_t struct
 void oi_update(oi_t *self)
+{
+    oi_updateFast(self);
+
+    timer_waitMillis(25); // reduces USART errors that occur when continuously
+                          // transmitting/receiving min wait time=15ms
+}
+
+/// Update all sensors without the trailing delay. The caller must space calls
+/// at least 15ms apart (e.g. from a periodic timer interrupt)
+void oi_updateFast(oi_t *self)
 {
     uint8_t sensorBuffer[SENSOR_PACKET_SIZE];
 
@@ -189,9 +200,6 @@ void oi_update(oi_t *self)
 
     // Parse the sensor data into the struct
     oi_parsePacket(self, sensorBuffer);
-
-    timer_waitMillis(25); // reduces USART errors that occur when continuously
-                          // transmitting/receiving min wait time=15ms
 }
 
 void oi_parsePacket(oi_t *self, uint8_t packet[])
@@ -287,6 +295,9 @@ void oi_parsePacket(oi_t *self, uint8_t packet[])
 
     self->distance = oi_getDistance(self);
     self->angle = oi_getDegrees(self);
+
+    // Integrate the raw encoder counts into the global pose estimate
+    odom_update(self->leftEncoderCount, self->rightEncoderCount);
 }
 
 inline int16_t oi_parseInt(uint8_t *theInt)
@@ -145,6 +145,10 @@ void oi_close();
 ///Update sensor data
 void oi_update(oi_t *self);
 
+///Update sensor data without the 25ms settle delay, for callers that already
+///space their calls out (e.g. a periodic timer interrupt)
+void oi_updateFast(oi_t *self);
+
 /// \brief Set the LEDS on the Create
 /// \param play_led 0=off, 1=on
 /// \param advance_led 0=off, 1=on
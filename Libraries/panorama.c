@@ -0,0 +1,58 @@
+/**
+ * All round view from two sweeps
+ * @file panorama.c
+ */
+
+#include <math.h>
+#include "panorama.h"
+
+static int16_t ranges[PANO_BINS];
+static pose_t refPose;
+
+/**
+ * Bin a bearing in degrees falls in, wrapped all the way round
+ */
+static int pano_bin(float bearing) {
+    int bin = (int)floorf(bearing / PANO_BIN_DEG + 0.5f) % PANO_BINS;
+    return bin < 0 ? bin + PANO_BINS : bin;
+}
+
+void pano_clear(const pose_t *ref) {
+    int i;
+    refPose = *ref;
+    for (i = 0; i < PANO_BINS; i++) {
+        ranges[i] = 0;
+    }
+}
+
+void pano_addSweep(int scan[181][2], const pose_t *scanPose) {
+    int a;
+
+    for (a = 0; a <= 180; a += 2) {
+        int r = scan[a][0];
+        if (r <= 0) {
+            continue;
+        }
+
+        //Through the floor, so a sweep taken a little off the reference spot still lines up
+        float ray = scanPose->theta + (a - 90) * DEG_TO_RAD;
+        float dx = scanPose->x + r * 10.0f * cosf(ray) - refPose.x;
+        float dy = scanPose->y + r * 10.0f * sinf(ray) - refPose.y;
+        int bin = pano_bin(odom_wrapAngle(atan2f(dy, dx) - refPose.theta) / DEG_TO_RAD);
+        int dist = (int)(sqrtf(dx * dx + dy * dy) / 10.0f + 0.5f);
+        if (dist < 1) {
+            dist = 1;
+        }
+        if (ranges[bin] == 0 || dist < ranges[bin]) {
+            ranges[bin] = dist;
+        }
+    }
+}
+
+int pano_range(int bearing) {
+    return ranges[pano_bin(bearing)];
+}
+
+void pano_getReference(pose_t *out) {
+    *out = refPose;
+}
@@ -0,0 +1,48 @@
+/**
+ * All round view from two sweeps
+ * @file panorama.h
+ *
+ * The servo only sees the half of the field in front of the robot. A
+ * panorama is a sweep, a turn on the spot of about 180 degrees and a second
+ * sweep, stitched into one polar array around the pose the first was taken
+ * from. Each sweep is put in with the pose odometry had for it, so whatever
+ * the turn really came to is allowed for, and the robot drifting off the spot
+ * while turning is too.
+ */
+
+#ifndef PANORAMA_H_
+#define PANORAMA_H_
+
+#include "odometry.h"
+
+/// Bearings kept, PANO_BIN_DEG apart all the way round
+#define PANO_BIN_DEG 2
+#define PANO_BINS (360 / PANO_BIN_DEG)
+
+/**
+ * @brief Start a new panorama around a pose, dropping the last one
+ *
+ * @param ref pose bearings are measured from, usually where the first sweep is taken
+ */
+void pano_clear(const pose_t *ref);
+
+/**
+ * @brief Add a sweep. Where two readings land on the same bearing the nearer one is kept
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param scanPose pose the sweep was taken from
+ */
+void pano_addSweep(int scan[181][2], const pose_t *scanPose);
+
+/**
+ * @param bearing degrees from the reference heading, positive is left, any value
+ * @return PING distance in cm on that bearing, 0 if neither sweep saw it
+ */
+int pano_range(int bearing);
+
+/**
+ * @param out filled with the pose bearings are measured from
+ */
+void pano_getReference(pose_t *out);
+
+#endif /* PANORAMA_H_ */
@@ -89,25 +89,28 @@ void TIMER3B_Handler(void) {
 
 }
 
-float ping_getDistance (void) {
+float ping_lastDistance (void) {
     unsigned long clockPulses = 0;
     unsigned long offset = 0xFF<<16;
     float speedSound = 343.0;
     float timePerClock = .0000000625;
     float reflectionTime = 0;
 
-    ping_trigger();
-    timer_waitMillis(50);
+    //The counter runs down, so an end time above the start means it wrapped during the echo
     if (START_TIME < END_TIME) {
         clockPulses = (START_TIME - END_TIME) + offset;
-        reflectionTime = (clockPulses * timePerClock) / 2.0;
-        lcd_printf("%f meters + overflow", reflectionTime * speedSound);
-        return reflectionTime * speedSound;
     }
     else {
         clockPulses = START_TIME - END_TIME;
-        reflectionTime = (clockPulses * timePerClock) / 2.0;
-        lcd_printf("%f meters", reflectionTime * speedSound);
-        return reflectionTime * speedSound;
     }
+    reflectionTime = (clockPulses * timePerClock) / 2.0;
+    return reflectionTime * speedSound;
+}
+
+float ping_getDistance (void) {
+    ping_trigger();
+    timer_waitMillis(50);
+    float distance = ping_lastDistance();
+    lcd_printf("%f meters", distance);
+    return distance;
 }
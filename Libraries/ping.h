@@ -29,6 +29,14 @@ void ping_trigger (void);
  */
 void TIMER3B_Handler(void);
 
+/**
+ * @brief Distance from the echo of the last ping_trigger(), without waiting
+ * for it. Give the echo at least 50ms to come back first.
+ *
+ * @return Distance in m
+ */
+float ping_lastDistance (void);
+
 /**
  * @brief Calculate the distance in cm
  *
@@ -0,0 +1,702 @@
+/**
+ * Grid path planner over the occupancy map
+ * @file plan.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "plan.h"
+#include "boundary.h"
+
+#define PLAN_INF 0xFFFF
+#define PLAN_NOT_OPEN 0xFFFF
+
+//Neighbour offsets, the four straight steps first then the diagonals
+static const int8_t stepX[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+static const int8_t stepY[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+
+typedef struct {
+    uint32_t k1;
+    uint16_t k2;
+    uint16_t node;
+} open_t;
+
+static uint8_t cost[PLAN_NODES];
+//Nodes whose cost changed since the last D* Lite replan, and those of them that only got cheaper
+static uint8_t dirty[PLAN_NODES / 8];
+static uint8_t cheaper[PLAN_NODES / 8];
+static uint8_t closed[PLAN_NODES / 8];
+static uint8_t blocked[PLAN_NODES / 8];
+//Nodes too close to known boundary tape or cliffs, rebuilt only when the boundaries change
+static uint8_t offCourse[PLAN_NODES / 8];
+static uint32_t offCourseVersion = 0;
+//Cost from each node to the goal, and D* Lite's one step lookahead of it
+static uint16_t g[PLAN_NODES];
+static uint16_t rhs[PLAN_NODES];
+
+static open_t open[PLAN_OPEN_MAX];
+//Where each node sits in open[], so a node is only ever queued once and can be re-keyed in place
+static uint16_t openAt[PLAN_NODES];
+static int openCount;
+static int openFull;
+static plan_stats_t stats;
+
+//D* Lite state. needsInit is set whenever the search has to start over
+static int goalNode = -1;
+static int lastStart;
+static int needsInit = 1;
+static uint32_t km;
+
+#define BIT_GET(a, i) ((a)[(i) >> 3] & (1 << ((i) & 7)))
+#define BIT_SET(a, i) ((a)[(i) >> 3] |= (uint8_t)(1 << ((i) & 7)))
+#define BIT_CLEAR(a, i) ((a)[(i) >> 3] &= (uint8_t)~(1 << ((i) & 7)))
+
+static int plan_worldToNode(float x, float y, int *node) {
+    int cx, cy;
+    int onMap = grid_worldToCell(x, y, &cx, &cy);
+    *node = (cy / PLAN_SCALE) * PLAN_SIZE_X + cx / PLAN_SCALE;
+    return onMap;
+}
+
+/**
+ * Octile distance at free space cost, never more than the real cost
+ */
+static uint32_t plan_heuristic(int a, int b) {
+    int dx = a % PLAN_SIZE_X - b % PLAN_SIZE_X;
+    int dy = a / PLAN_SIZE_X - b / PLAN_SIZE_X;
+    if (dx < 0) {
+        dx = -dx;
+    }
+    if (dy < 0) {
+        dy = -dy;
+    }
+    int diag = dx < dy ? dx : dy;
+    int straight = dx + dy - 2 * diag;
+    return PLAN_COST_FREE * straight + (PLAN_COST_FREE * 14 / 10) * diag;
+}
+
+/**
+ * Neighbour of a node in direction dir, -1 off the edge of the map
+ */
+static int plan_neighbour(int node, int dir) {
+    int x = node % PLAN_SIZE_X + stepX[dir];
+    int y = node / PLAN_SIZE_X + stepY[dir];
+    if (x < 0 || x >= PLAN_SIZE_X || y < 0 || y >= PLAN_SIZE_Y) {
+        return -1;
+    }
+    return y * PLAN_SIZE_X + x;
+}
+
+/**
+ * All eight neighbours of a node at once, -1 for those off the edge of the map.
+ * D* Lite looks at the neighbours of neighbours, this saves working out x and y for every one
+ */
+static void plan_neighbours(int node, int next[8]) {
+    int dir;
+    int x = node % PLAN_SIZE_X;
+    int y = node / PLAN_SIZE_X;
+    for (dir = 0; dir < 8; dir++) {
+        int nx = x + stepX[dir];
+        int ny = y + stepY[dir];
+        next[dir] = nx < 0 || nx >= PLAN_SIZE_X || ny < 0 || ny >= PLAN_SIZE_Y ? -1 : ny * PLAN_SIZE_X + nx;
+    }
+}
+
+/**
+ * Cost of stepping in direction dir into node, PLAN_INF if it is blocked
+ */
+static uint32_t plan_stepCost(int node, int dir) {
+    uint32_t c = cost[node];
+    if (c == PLAN_COST_BLOCKED) {
+        return PLAN_INF;
+    }
+    return dir < 4 ? c : c * 14 / 10;
+}
+
+static int plan_keyLess(uint32_t a1, uint16_t a2, uint32_t b1, uint16_t b2) {
+    return a1 < b1 || (a1 == b1 && a2 < b2);
+}
+
+static void plan_openClear(void) {
+    openCount = 0;
+    memset(openAt, 0xFF, sizeof(openAt));
+}
+
+/**
+ * Put e at slot i and move it up past any parents with a bigger key
+ */
+static void plan_siftUp(int i, open_t e) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!plan_keyLess(e.k1, e.k2, open[parent].k1, open[parent].k2)) {
+            break;
+        }
+        open[i] = open[parent];
+        openAt[open[i].node] = (uint16_t)i;
+        i = parent;
+    }
+    open[i] = e;
+    openAt[e.node] = (uint16_t)i;
+}
+
+/**
+ * Put e at slot i and move it down past any children with a smaller key
+ */
+static void plan_siftDown(int i, open_t e) {
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= openCount) {
+            break;
+        }
+        if (child + 1 < openCount && plan_keyLess(open[child + 1].k1, open[child + 1].k2, open[child].k1, open[child].k2)) {
+            child++;
+        }
+        if (!plan_keyLess(open[child].k1, open[child].k2, e.k1, e.k2)) {
+            break;
+        }
+        open[i] = open[child];
+        openAt[open[i].node] = (uint16_t)i;
+        i = child;
+    }
+    open[i] = e;
+    openAt[e.node] = (uint16_t)i;
+}
+
+/**
+ * Queue a node, or move it to its new key if it is already queued
+ * @return 0 if the open list is full
+ */
+static int plan_push(uint32_t k1, uint16_t k2, int node) {
+    open_t e = {k1, k2, (uint16_t)node};
+    int i = openAt[node];
+
+    if (i != PLAN_NOT_OPEN) {
+        if (open[i].k1 == k1 && open[i].k2 == k2) {
+            return 1;
+        }
+        if (plan_keyLess(k1, k2, open[i].k1, open[i].k2)) {
+            plan_siftUp(i, e);
+        }
+        else {
+            plan_siftDown(i, e);
+        }
+        return 1;
+    }
+
+    if (openCount >= PLAN_OPEN_MAX) {
+        openFull = 1;
+        return 0;
+    }
+    plan_siftUp(openCount++, e);
+    if (openCount > stats.openPeak) {
+        stats.openPeak = (uint16_t)openCount;
+    }
+    return 1;
+}
+
+/**
+ * Take a node off the open list wherever it is in the heap, if it is there at all
+ */
+static void plan_remove(int node) {
+    int i = openAt[node];
+    if (i == PLAN_NOT_OPEN) {
+        return;
+    }
+    openAt[node] = PLAN_NOT_OPEN;
+    open_t last = open[--openCount];
+    if (i == openCount) {
+        return;
+    }
+
+    //The last entry fills the hole, and may belong either above or below it
+    if (i > 0 && plan_keyLess(last.k1, last.k2, open[(i - 1) / 2].k1, open[(i - 1) / 2].k2)) {
+        plan_siftUp(i, last);
+    }
+    else {
+        plan_siftDown(i, last);
+    }
+}
+
+static open_t plan_pop(void) {
+    open_t top = open[0];
+    plan_remove(top.node);
+    return top;
+}
+
+/**
+ * Walk downhill through g from start to the goal
+ */
+static void plan_extract(int start, int goal, plan_path_t *path) {
+    int node = start;
+    path->length = 0;
+    path->cost = g[start];
+
+    while (path->length < PLAN_PATH_MAX) {
+        path->node[path->length++] = (uint16_t)node;
+        if (node == goal) {
+            break;
+        }
+
+        int dir;
+        int best = -1;
+        uint32_t bestCost = PLAN_INF;
+        for (dir = 0; dir < 8; dir++) {
+            int next = plan_neighbour(node, dir);
+            if (next < 0 || g[next] == PLAN_INF) {
+                continue;
+            }
+            uint32_t c = plan_stepCost(next, dir) + g[next];
+            if (c < bestCost) {
+                bestCost = c;
+                best = next;
+            }
+        }
+        //g only ever decreases towards the goal, so this can't loop
+        if (best < 0 || g[best] >= g[node]) {
+            break;
+        }
+        node = best;
+    }
+}
+
+int plan_refreshCosts(void) {
+    int cx, cy, n;
+    int changed = 0;
+    int reach = PLAN_INFLATE_MM / PLAN_CELL_MM + 1;
+    int32_t reach2 = (int32_t)PLAN_INFLATE_MM * PLAN_INFLATE_MM;
+
+    //Grow every occupied map cell into the nodes the robot's centre can't be in
+    memset(blocked, 0, sizeof(blocked));
+    for (cy = 0; cy < GRID_SIZE_Y; cy++) {
+        for (cx = 0; cx < GRID_SIZE_X; cx++) {
+            if (!grid_isOccupied(cx, cy)) {
+                continue;
+            }
+            int ox = cx * GRID_CELL_MM + GRID_CELL_MM / 2;
+            int oy = cy * GRID_CELL_MM + GRID_CELL_MM / 2;
+            int nx0 = cx / PLAN_SCALE;
+            int ny0 = cy / PLAN_SCALE;
+            int nx, ny;
+            for (ny = ny0 - reach; ny <= ny0 + reach; ny++) {
+                for (nx = nx0 - reach; nx <= nx0 + reach; nx++) {
+                    if (nx < 0 || nx >= PLAN_SIZE_X || ny < 0 || ny >= PLAN_SIZE_Y) {
+                        continue;
+                    }
+                    int32_t dx = nx * PLAN_CELL_MM + PLAN_CELL_MM / 2 - ox;
+                    int32_t dy = ny * PLAN_CELL_MM + PLAN_CELL_MM / 2 - oy;
+                    if (dx * dx + dy * dy <= reach2) {
+                        BIT_SET(blocked, ny * PLAN_SIZE_X + nx);
+                    }
+                }
+            }
+        }
+    }
+
+    //Boundaries are hard limits, PING sees straight over them so the map alone never would be
+    if (offCourseVersion != boundary_version()) {
+        offCourseVersion = boundary_version();
+        memset(offCourse, 0, sizeof(offCourse));
+        for (n = 0; boundary_count() > 0 && n < PLAN_NODES; n++) {
+            float wx, wy;
+            plan_nodeToWorld(n, &wx, &wy);
+            if (boundary_distance(wx, wy) < PLAN_INFLATE_MM) {
+                BIT_SET(offCourse, n);
+            }
+        }
+    }
+    for (n = 0; n < PLAN_NODES / 8; n++) {
+        blocked[n] |= offCourse[n];
+    }
+
+    for (n = 0; n < PLAN_NODES; n++) {
+        uint8_t c = PLAN_COST_BLOCKED;
+        if (!BIT_GET(blocked, n)) {
+            //Seen free if any map cell in the node has been seen through
+            int x0 = (n % PLAN_SIZE_X) * PLAN_SCALE;
+            int y0 = (n / PLAN_SIZE_X) * PLAN_SCALE;
+            c = PLAN_COST_UNKNOWN;
+            for (cy = y0; cy < y0 + PLAN_SCALE; cy++) {
+                for (cx = x0; cx < x0 + PLAN_SCALE; cx++) {
+                    if (grid_isFree(cx, cy)) {
+                        c = PLAN_COST_FREE;
+                    }
+                }
+            }
+        }
+        if (c != cost[n]) {
+            if (c < cost[n] && (!BIT_GET(dirty, n) || BIT_GET(cheaper, n))) {
+                BIT_SET(cheaper, n);
+            }
+            else {
+                BIT_CLEAR(cheaper, n);
+            }
+            cost[n] = c;
+            BIT_SET(dirty, n);
+            changed++;
+        }
+    }
+    return changed;
+}
+
+int plan_astar(float sx, float sy, float gx, float gy, plan_path_t *path) {
+    int start, goal;
+    path->length = 0;
+    if (!plan_worldToNode(sx, sy, &start) || !plan_worldToNode(gx, gy, &goal)) {
+        return PLAN_OFF_MAP;
+    }
+
+    //g is shared with D* Lite, which will have to start over
+    needsInit = 1;
+    memset(g, 0xFF, sizeof(g));
+    memset(closed, 0, sizeof(closed));
+    memset(&stats, 0, sizeof(stats));
+    plan_openClear();
+    openFull = 0;
+
+    //Search back from the goal so the path reads off forwards from the start
+    g[goal] = 0;
+    plan_push(plan_heuristic(goal, start), 0, goal);
+
+    while (openCount > 0) {
+        open_t top = plan_pop();
+        int node = top.node;
+        if (BIT_GET(closed, node)) {
+            continue;
+        }
+        BIT_SET(closed, node);
+        stats.expanded++;
+
+        if (node == start) {
+            plan_extract(start, goal, path);
+            return PLAN_OK;
+        }
+
+        int dir;
+        for (dir = 0; dir < 8; dir++) {
+            int prev = plan_neighbour(node, dir);
+            if (prev < 0 || BIT_GET(closed, prev)) {
+                continue;
+            }
+            //Stepping from prev into node goes the opposite way to dir, same cost
+            uint32_t c = plan_stepCost(node, dir);
+            if (c == PLAN_INF) {
+                break;
+            }
+            uint32_t ng = g[node] + c;
+            if (ng < g[prev]) {
+                g[prev] = (uint16_t)ng;
+                if (!plan_push(ng + plan_heuristic(prev, start), (uint16_t)ng, prev)) {
+                    return PLAN_OPEN_FULL;
+                }
+            }
+        }
+    }
+    return PLAN_NO_PATH;
+}
+
+/**
+ * D* Lite priority of a node, [min(g, rhs) + h + km; min(g, rhs)]
+ */
+static void plan_dstarKey(int node, int start, uint32_t *k1, uint16_t *k2) {
+    uint16_t m = g[node] < rhs[node] ? g[node] : rhs[node];
+    *k2 = m;
+    *k1 = m + plan_heuristic(start, node) + km;
+}
+
+/**
+ * Queue a node if its g and lookahead disagree, or take it off the open list if they now agree
+ */
+static void plan_dstarQueue(int node, int start) {
+    if (g[node] != rhs[node]) {
+        uint32_t k1;
+        uint16_t k2;
+        plan_dstarKey(node, start, &k1, &k2);
+        plan_push(k1, k2, node);
+    }
+    else {
+        plan_remove(node);
+    }
+}
+
+/**
+ * Recompute a node's one step lookahead from all its neighbours and queue it if it no longer agrees with g
+ */
+static void plan_dstarUpdate(int node, int start) {
+    if (node != goalNode) {
+        int dir;
+        int next[8];
+        uint32_t best = PLAN_INF;
+        plan_neighbours(node, next);
+        for (dir = 0; dir < 8; dir++) {
+            if (next[dir] < 0 || g[next[dir]] == PLAN_INF) {
+                continue;
+            }
+            uint32_t c = plan_stepCost(next[dir], dir) + g[next[dir]];
+            if (c < best) {
+                best = c;
+            }
+        }
+        rhs[node] = (uint16_t)best;
+    }
+    plan_dstarQueue(node, start);
+}
+
+int plan_dstarSetGoal(float gx, float gy) {
+    int goal;
+    if (!plan_worldToNode(gx, gy, &goal)) {
+        return PLAN_OFF_MAP;
+    }
+    goalNode = goal;
+    needsInit = 1;
+    return PLAN_OK;
+}
+
+int plan_dstarReplan(float sx, float sy, plan_path_t *path) {
+    int start, n;
+    path->length = 0;
+    if (goalNode < 0 || !plan_worldToNode(sx, sy, &start)) {
+        return PLAN_OFF_MAP;
+    }
+    memset(&stats, 0, sizeof(stats));
+    openFull = 0;
+
+    if (needsInit) {
+        memset(g, 0xFF, sizeof(g));
+        memset(rhs, 0xFF, sizeof(rhs));
+        memset(dirty, 0, sizeof(dirty));
+        memset(cheaper, 0, sizeof(cheaper));
+        plan_openClear();
+        km = 0;
+        rhs[goalNode] = 0;
+        plan_push(plan_heuristic(start, goalNode), 0, goalNode);
+        lastStart = start;
+        needsInit = 0;
+    }
+    else {
+        //Keys already queued were worked out from the old start, km keeps them comparable
+        km += plan_heuristic(lastStart, start);
+        lastStart = start;
+        //A node's cost only affects steps into it, so only its neighbours need another look. One that
+        //only got cheaper can just offer them the cheaper step. The rest come in clumps, so mark their
+        //neighbours first to recompute each only once. closed isn't used by D* Lite
+        memset(closed, 0, sizeof(closed));
+        for (n = 0; n < PLAN_NODES; n++) {
+            if (dirty[n >> 3] == 0) {
+                n |= 7;
+                continue;
+            }
+            if (!BIT_GET(dirty, n)) {
+                continue;
+            }
+            int dir;
+            int prev[8];
+            plan_neighbours(n, prev);
+            for (dir = 0; dir < 8; dir++) {
+                if (prev[dir] < 0) {
+                    continue;
+                }
+                if (!BIT_GET(cheaper, n)) {
+                    BIT_SET(closed, prev[dir]);
+                }
+                else if (g[n] != PLAN_INF && prev[dir] != goalNode && g[n] + plan_stepCost(n, dir) < rhs[prev[dir]]) {
+                    rhs[prev[dir]] = (uint16_t)(g[n] + plan_stepCost(n, dir));
+                    plan_dstarQueue(prev[dir], start);
+                }
+            }
+        }
+        for (n = 0; n < PLAN_NODES; n++) {
+            if (closed[n >> 3] == 0) {
+                n |= 7;
+                continue;
+            }
+            if (BIT_GET(closed, n)) {
+                plan_dstarUpdate(n, start);
+            }
+        }
+        memset(dirty, 0, sizeof(dirty));
+        memset(cheaper, 0, sizeof(cheaper));
+    }
+
+    while (openCount > 0) {
+        uint32_t s1;
+        uint16_t s2;
+        plan_dstarKey(start, start, &s1, &s2);
+        if (!plan_keyLess(open[0].k1, open[0].k2, s1, s2) && rhs[start] == g[start]) {
+            break;
+        }
+
+        open_t top = open[0];
+        int node = top.node;
+        uint32_t k1;
+        uint16_t k2;
+        plan_dstarKey(node, start, &k1, &k2);
+        if (plan_keyLess(top.k1, top.k2, k1, k2)) {
+            //Keyed from an older start, move it back to where it belongs now
+            plan_push(k1, k2, node);
+            continue;
+        }
+
+        stats.expanded++;
+        int dir;
+        int prev[8];
+        plan_neighbours(node, prev);
+        if (g[node] > rhs[node]) {
+            //g came down, which can only make stepping into this node a better choice for its neighbours
+            g[node] = rhs[node];
+            plan_remove(node);
+            for (dir = 0; dir < 8; dir++) {
+                uint32_t c = plan_stepCost(node, dir);
+                if (c == PLAN_INF) {
+                    break;
+                }
+                if (prev[dir] >= 0 && prev[dir] != goalNode && g[node] + c < rhs[prev[dir]]) {
+                    rhs[prev[dir]] = (uint16_t)(g[node] + c);
+                    plan_dstarQueue(prev[dir], start);
+                }
+            }
+        }
+        else {
+            //g went up, only neighbours whose lookahead went through this node have to look again
+            uint32_t old = g[node];
+            g[node] = PLAN_INF;
+            for (dir = 0; dir < 8; dir++) {
+                uint32_t c = plan_stepCost(node, dir);
+                if (c == PLAN_INF) {
+                    break;
+                }
+                if (prev[dir] >= 0 && rhs[prev[dir]] == old + c) {
+                    plan_dstarUpdate(prev[dir], start);
+                }
+            }
+            //Its own lookahead doesn't depend on its g, it only needs re-keying in place
+            plan_dstarQueue(node, start);
+        }
+
+        if (openFull) {
+            break;
+        }
+    }
+
+    //Also catches a node dropped while taking in cost changes, before anything was expanded
+    if (openFull) {
+        needsInit = 1;
+        return PLAN_OPEN_FULL;
+    }
+    if (rhs[start] == PLAN_INF) {
+        return PLAN_NO_PATH;
+    }
+    plan_extract(start, goalNode, path);
+    return PLAN_OK;
+}
+
+int plan_costFrom(float sx, float sy) {
+    int start;
+    if (!plan_worldToNode(sx, sy, &start)) {
+        return PLAN_OFF_MAP;
+    }
+
+    needsInit = 1;
+    memset(g, 0xFF, sizeof(g));
+    memset(closed, 0, sizeof(closed));
+    memset(&stats, 0, sizeof(stats));
+    plan_openClear();
+    openFull = 0;
+
+    //Outwards from the robot this time, so g is the cost of getting to each node
+    g[start] = 0;
+    plan_push(0, 0, start);
+    while (openCount > 0) {
+        open_t top = plan_pop();
+        int node = top.node;
+        if (BIT_GET(closed, node)) {
+            continue;
+        }
+        BIT_SET(closed, node);
+        stats.expanded++;
+
+        int dir;
+        for (dir = 0; dir < 8; dir++) {
+            int next = plan_neighbour(node, dir);
+            if (next < 0 || BIT_GET(closed, next)) {
+                continue;
+            }
+            uint32_t c = plan_stepCost(next, dir);
+            if (c == PLAN_INF) {
+                continue;
+            }
+            uint32_t ng = g[node] + c;
+            if (ng < g[next]) {
+                g[next] = (uint16_t)ng;
+                if (!plan_push(ng, (uint16_t)ng, next)) {
+                    return PLAN_OPEN_FULL;
+                }
+            }
+        }
+    }
+    return PLAN_OK;
+}
+
+uint16_t plan_costTo(int node) {
+    return g[node];
+}
+
+int plan_nodeAt(float x, float y) {
+    int node;
+    return plan_worldToNode(x, y, &node) ? node : -1;
+}
+
+int plan_isBlocked(int node) {
+    return cost[node] == PLAN_COST_BLOCKED;
+}
+
+int plan_farthestVisible(const plan_path_t *path, int maxIndex) {
+    int i;
+    int best = 0;
+    if (maxIndex > path->length - 1) {
+        maxIndex = path->length - 1;
+    }
+
+    for (i = 1; i <= maxIndex; i++) {
+        //Bresenham across the nodes between the robot and this one
+        int x0 = path->node[0] % PLAN_SIZE_X;
+        int y0 = path->node[0] / PLAN_SIZE_X;
+        int x1 = path->node[i] % PLAN_SIZE_X;
+        int y1 = path->node[i] / PLAN_SIZE_X;
+        int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+        int dy = y1 > y0 ? y1 - y0 : y0 - y1;
+        int sx = x1 > x0 ? 1 : -1;
+        int sy = y1 > y0 ? 1 : -1;
+        int err = dx - dy;
+        int clear = 1;
+
+        while (x0 != x1 || y0 != y1) {
+            int e2 = 2 * err;
+            if (e2 > -dy) {
+                err -= dy;
+                x0 += sx;
+            }
+            if (e2 < dx) {
+                err += dx;
+                y0 += sy;
+            }
+            if (cost[y0 * PLAN_SIZE_X + x0] == PLAN_COST_BLOCKED) {
+                clear = 0;
+                break;
+            }
+        }
+        if (!clear) {
+            break;
+        }
+        best = i;
+    }
+    return best;
+}
+
+void plan_nodeToWorld(int node, float *x, float *y) {
+    *x = ((node % PLAN_SIZE_X) * PLAN_SCALE - GRID_ORIGIN_X) * GRID_CELL_MM + PLAN_CELL_MM / 2.0f;
+    *y = ((node / PLAN_SIZE_X) * PLAN_SCALE - GRID_ORIGIN_Y) * GRID_CELL_MM + PLAN_CELL_MM / 2.0f;
+}
+
+void plan_getStats(plan_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,169 @@
+/**
+ * Grid path planner over the occupancy map
+ * @file plan.h
+ *
+ * Plans on a coarse copy of the occupancy grid (grid.h), PLAN_SCALE x
+ * PLAN_SCALE map cells per node, with obstacles grown by the robot's radius so
+ * the robot can be treated as a point. Unknown space is allowed but costs more
+ * than space we have seen to be free. Costs are integers, 10 per straight step
+ * and 14 per diagonal step through free space.
+ *
+ * Two searches share the same storage, both run from the goal back towards
+ * the robot so a path can always be read off by walking downhill from the
+ * robot's node:
+ *  - plan_astar() is a one-off A* between two points.
+ *  - plan_dstarSetGoal() / plan_dstarReplan() is D* Lite. After the first plan
+ *    only the part of the search affected by map changes and the robot moving
+ *    is redone, which is far cheaper than planning from scratch every sweep.
+ *
+ * plan_costFrom() also shares the storage, running outwards from the robot to
+ * cost every reachable node at once for choosing between goals.
+ *
+ * The open list is a fixed size heap holding each node at most once, a node
+ * already on it is moved to its new key in place. A search that outgrows it
+ * stops with PLAN_OPEN_FULL rather than running out of memory.
+ */
+
+#ifndef PLAN_H_
+#define PLAN_H_
+
+#include <stdint.h>
+#include "grid.h"
+
+/// Map cells per planner node along each side, 2 gives 10cm nodes
+#define PLAN_SCALE 2
+#define PLAN_SIZE_X (GRID_SIZE_X / PLAN_SCALE)
+#define PLAN_SIZE_Y (GRID_SIZE_Y / PLAN_SCALE)
+#define PLAN_NODES (PLAN_SIZE_X * PLAN_SIZE_Y)
+#define PLAN_CELL_MM (GRID_CELL_MM * PLAN_SCALE)
+
+/// Obstacles are grown by this much, half the robot's width plus a little, mm
+#define PLAN_INFLATE_MM 200
+
+/// Cost of a straight step into a node; diagonal steps cost 1.4 times as much
+#define PLAN_COST_FREE 10
+#define PLAN_COST_UNKNOWN 16
+#define PLAN_COST_BLOCKED 255
+
+/// Open list capacity in entries, 8 bytes each. Enough for D* Lite across the whole course with the map still unknown
+#define PLAN_OPEN_MAX 480
+/// Longest path handed back, nodes
+#define PLAN_PATH_MAX 64
+
+/// Planner outcomes
+#define PLAN_OK 0
+#define PLAN_NO_PATH 1
+#define PLAN_OPEN_FULL 2
+#define PLAN_OFF_MAP 3
+
+/// A planned route from the robot's node to the goal's node
+typedef struct {
+    int length;                     // nodes in node[], 0 if there is no route
+    uint16_t node[PLAN_PATH_MAX];   // node indices, node[0] is where the robot is
+    uint32_t cost;                  // total cost to the goal, even if node[] was cut short
+} plan_path_t;
+
+/// Work done by the last search, for profiling on the robot
+typedef struct {
+    uint32_t expanded;  // nodes taken off the open list and expanded
+    uint16_t openPeak;  // most open list entries in use at once
+} plan_stats_t;
+
+/**
+ * @brief Rebuild the planner's costs from the occupancy grid. Call after
+ * every sweep. Changed nodes are remembered and applied by the next
+ * plan_dstarReplan().
+ *
+ * @return number of nodes whose cost changed
+ */
+int plan_refreshCosts(void);
+
+/**
+ * @brief Plan from scratch with A*. This reuses the D* Lite storage, so the
+ * next plan_dstarReplan() starts over.
+ *
+ * @param sx start x in mm
+ * @param sy start y in mm
+ * @param gx goal x in mm
+ * @param gy goal y in mm
+ * @param path filled with the route
+ * @return PLAN_* outcome
+ */
+int plan_astar(float sx, float sy, float gx, float gy, plan_path_t *path);
+
+/**
+ * @brief Set the goal for D* Lite. The search itself runs on the next
+ * plan_dstarReplan().
+ *
+ * @param gx goal x in mm
+ * @param gy goal y in mm
+ * @return PLAN_OK, or PLAN_OFF_MAP if the goal is not on the map
+ */
+int plan_dstarSetGoal(float gx, float gy);
+
+/**
+ * @brief Bring the D* Lite search up to date with the robot's position and
+ * any cost changes since the last call, then read off the route
+ *
+ * @param sx robot x in mm
+ * @param sy robot y in mm
+ * @param path filled with the route
+ * @return PLAN_* outcome
+ */
+int plan_dstarReplan(float sx, float sy, plan_path_t *path);
+
+/**
+ * @brief Fill in the travel cost from the robot to every node it can reach
+ * (Dijkstra), for weighing up several possible goals at once. This reuses the
+ * D* Lite storage, so the next plan_dstarReplan() starts over.
+ *
+ * @param sx robot x in mm
+ * @param sy robot y in mm
+ * @return PLAN_OK, PLAN_OFF_MAP, or PLAN_OPEN_FULL if only the nearer nodes got a cost
+ */
+int plan_costFrom(float sx, float sy);
+
+/**
+ * @param node node index
+ * @return travel cost to the node from the last plan_costFrom(), 0xFFFF if unreached
+ */
+uint16_t plan_costTo(int node);
+
+/**
+ * @param x world x in mm
+ * @param y world y in mm
+ * @return node containing the position, -1 if it is off the map
+ */
+int plan_nodeAt(float x, float y);
+
+/**
+ * @param node node index
+ * @return 1 if the robot can't be centred on the node
+ */
+int plan_isBlocked(int node);
+
+/**
+ * @brief Furthest node along a path that can be driven to in a straight line
+ * from node[0] without crossing a blocked node
+ *
+ * @param path route from one of the planners
+ * @param maxIndex don't look past this index
+ * @return index into path->node
+ */
+int plan_farthestVisible(const plan_path_t *path, int maxIndex);
+
+/**
+ * @brief World position of the centre of a node
+ *
+ * @param node node index
+ * @param x world x in mm out
+ * @param y world y in mm out
+ */
+void plan_nodeToWorld(int node, float *x, float *y);
+
+/**
+ * @param out filled with the work done by the last search
+ */
+void plan_getStats(plan_stats_t *out);
+
+#endif /* PLAN_H_ */
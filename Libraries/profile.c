@@ -0,0 +1,47 @@
+/**
+ * Trapezoidal velocity profile generator
+ * @file profile.c
+ */
+
+#include <math.h>
+#include "profile.h"
+
+void profile_init(profile_t *p, float distance, float maxVel, float accel, float decel, float startVel) {
+    distance = fabsf(distance);
+
+    //Peak of the triangle where a full ramp up meets a full ramp down
+    float peak = sqrtf(2.0f * distance * accel * decel / (accel + decel) + startVel * startVel * decel / (accel + decel));
+
+    p->cruise = peak < maxVel ? peak : maxVel;
+    p->accel = accel;
+    p->decel = decel;
+    p->vel = fabsf(startVel);
+}
+
+float profile_step(profile_t *p, float remaining, float dt) {
+    remaining = fabsf(remaining);
+
+    //The command takes effect a tick late, so brake for where we'll be by then
+    float lead = remaining - p->vel * dt;
+    if (lead < 0) {
+        lead = 0;
+    }
+
+    //Fastest speed we can still stop from inside the remaining distance
+    float target = sqrtf(2.0f * p->decel * lead);
+    if (target > p->cruise) {
+        target = p->cruise;
+    }
+
+    if (target > p->vel) {
+        p->vel += p->accel * dt;
+        if (p->vel > target) {
+            p->vel = target;
+        }
+    }
+    else {
+        p->vel = target;
+    }
+
+    return p->vel;
+}
@@ -0,0 +1,47 @@
+/**
+ * Trapezoidal velocity profile generator
+ * @file profile.h
+ *
+ * Produces an acceleration-limited speed for each control tick given the
+ * distance (or angle) left to go. The speed ramps up at the acceleration limit,
+ * cruises at the fastest speed the remaining distance allows and ramps down
+ * along the braking curve so it reaches zero at the goal. Short moves never
+ * reach the cruise ceiling and come out as a triangle.
+ * Units are whatever the caller uses consistently (mm or radians).
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+typedef struct {
+    float cruise;   // speed ceiling for this move
+    float accel;    // ramp up rate, units/s^2
+    float decel;    // braking rate, units/s^2
+    float vel;      // speed commanded on the last step, never negative
+} profile_t;
+
+/**
+ * @brief Set up a profile for a move of the given length. The cruise speed is
+ * picked from the distance so a short move peaks where the acceleration and
+ * braking ramps meet.
+ *
+ * @param p profile to initialize
+ * @param distance total length of the move, sign ignored
+ * @param maxVel hardware or tuning speed limit
+ * @param accel ramp up rate
+ * @param decel braking rate
+ * @param startVel speed the robot is already moving at, 0 from a standstill
+ */
+void profile_init(profile_t *p, float distance, float maxVel, float accel, float decel, float startVel);
+
+/**
+ * @brief Advance the profile one control tick
+ *
+ * @param p profile
+ * @param remaining distance left to the goal, sign ignored
+ * @param dt control period in seconds
+ * @return speed to command for this tick, never negative
+ */
+float profile_step(profile_t *p, float remaining, float dt);
+
+#endif /* PROFILE_H_ */
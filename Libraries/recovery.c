@@ -0,0 +1,130 @@
+/**
+ * Hazard recovery planning
+ * @file recovery.c
+ */
+
+#include "recovery.h"
+#include "motion.h"
+#include "panorama.h"
+
+/// Turn magnitudes tried in order, smallest first
+static const int candidateTurns[] = {30, 45, 60, 75, 90};
+#define NUM_CANDIDATES ((int)(sizeof(candidateTurns) / sizeof(candidateTurns[0])))
+
+/// The same for a panorama, which sees far enough round to go back the way we came
+static const int panoramaTurns[] = {30, 45, 60, 75, 90, 120, 150, 180};
+#define NUM_PANORAMA_TURNS ((int)(sizeof(panoramaTurns) / sizeof(panoramaTurns[0])))
+
+int recovery_backoff(int status) {
+    switch (status) {
+        case MOTION_BUMP_LEFT:
+        case MOTION_BUMP_RIGHT:
+            return RECOVERY_BUMP_BACKOFF_MM;
+        case MOTION_BOUND_LEFT:
+        case MOTION_BOUND_RIGHT:
+            return RECOVERY_TAPE_BACKOFF_MM;
+        case MOTION_CLIFF_LEFT:
+        case MOTION_CLIFF_RIGHT:
+            return RECOVERY_CLIFF_BACKOFF_MM;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Narrowest PING reading in the window around a servo angle, -1 if the window is outside the sweep or unsampled
+ */
+static int recovery_clearance(int scan[181][2], int scanAngle) {
+    int a;
+    int nearest = -1;
+
+    if (scanAngle - RECOVERY_HALF_WIDTH_DEG < 0 || scanAngle + RECOVERY_HALF_WIDTH_DEG > 180) {
+        return -1;
+    }
+
+    for (a = scanAngle - RECOVERY_HALF_WIDTH_DEG; a <= scanAngle + RECOVERY_HALF_WIDTH_DEG; a++) {
+        //Sweeps only fill every other degree
+        if (scan[a][0] <= 0) {
+            continue;
+        }
+        if (nearest < 0 || scan[a][0] < nearest) {
+            nearest = scan[a][0];
+        }
+    }
+    return nearest;
+}
+
+int recovery_chooseTurn(int leftSide, int scan[181][2], float headingSinceScan) {
+    int i, side;
+    int away = leftSide ? -1 : 1;
+
+    //Away from the hazard first, then back toward it if that side is all boxed in
+    for (side = 0; side < 2; side++) {
+        int sign = side == 0 ? away : -away;
+        for (i = 0; i < NUM_CANDIDATES; i++) {
+            int turn = sign * candidateTurns[i];
+            //Servo angle 90 was straight ahead when the sweep was taken
+            int clearance = recovery_clearance(scan, 90 + turn + (int)headingSinceScan);
+            if (clearance >= RECOVERY_CLEAR_CM) {
+                return turn;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Narrowest panorama reading in the window around a bearing from the reference heading, -1 if it saw none of it
+ */
+static int recovery_panoramaClearance(int bearing) {
+    int b;
+    int nearest = -1;
+
+    for (b = bearing - RECOVERY_HALF_WIDTH_DEG; b <= bearing + RECOVERY_HALF_WIDTH_DEG; b += PANO_BIN_DEG) {
+        int r = pano_range(b);
+        if (r > 0 && (nearest < 0 || r < nearest)) {
+            nearest = r;
+        }
+    }
+    return nearest;
+}
+
+/**
+ * Turn from where we face now onto a bearing from the panorama's reference heading
+ */
+static int recovery_panoramaToTurn(int bearing, float headingSinceRef) {
+    int turn = (int)(bearing - headingSinceRef) % 360;
+    if (turn > 180) {
+        turn -= 360;
+    }
+    else if (turn <= -180) {
+        turn += 360;
+    }
+    return turn;
+}
+
+int recovery_choosePanoramaTurn(int leftSide, float headingSinceRef) {
+    int i, side;
+    int away = leftSide ? -1 : 1;
+    int bestBearing = away * RECOVERY_DEFAULT_TURN;
+    int bestClearance = -1;
+
+    for (side = 0; side < 2; side++) {
+        int sign = side == 0 ? away : -away;
+        for (i = 0; i < NUM_PANORAMA_TURNS; i++) {
+            int bearing = sign * panoramaTurns[i];
+            int clearance = recovery_panoramaClearance(bearing);
+            if (clearance < 0) {
+                continue;
+            }
+            if (side == 0 && clearance >= RECOVERY_CLEAR_CM) {
+                return recovery_panoramaToTurn(bearing, headingSinceRef);
+            }
+            if (clearance > bestClearance) {
+                bestClearance = clearance;
+                bestBearing = bearing;
+            }
+        }
+    }
+    return recovery_panoramaToTurn(bestBearing, headingSinceRef);
+}
@@ -0,0 +1,60 @@
+/**
+ * Hazard recovery planning
+ * @file recovery.h
+ *
+ * After a bump, boundary or cliff the robot only needs to back off far enough
+ * to turn without touching whatever it hit, not all the way back to where the
+ * move started. The turn away is picked from the last scan rather than a
+ * blind 90 degrees, and when that shows no way out, from a panorama taken
+ * all round (see panorama.h).
+ */
+
+#ifndef RECOVERY_H_
+#define RECOVERY_H_
+
+/// Reverse clearance per hazard type in mm. Cliffs get the most room since the wheels are right behind the sensors
+#define RECOVERY_BUMP_BACKOFF_MM 80
+#define RECOVERY_TAPE_BACKOFF_MM 100
+#define RECOVERY_CLIFF_BACKOFF_MM 150
+
+/// Free PING distance in cm that makes a heading good enough to take straight away
+#define RECOVERY_CLEAR_CM 100
+/// Degrees either side of a candidate heading that must be clear, about half the robot at a metre
+#define RECOVERY_HALF_WIDTH_DEG 10
+/// Turn used when the scan says nothing useful, same as the old fixed response
+#define RECOVERY_DEFAULT_TURN 90
+
+/**
+ * @brief How far to reverse after a goal ends with the given outcome
+ *
+ * @param status MOTION_* outcome of the goal
+ * @return distance in mm, 0 if no back off is needed
+ */
+int recovery_backoff(int status);
+
+/**
+ * @brief Pick the turn away from a hazard using the last sweep. Headings on
+ * the side away from the hazard are tried smallest first and the first one
+ * with RECOVERY_CLEAR_CM of room is taken, then the same on the other side.
+ *
+ * @param leftSide 1 if the hazard was on the left, 0 if on the right
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param headingSinceScan degrees the robot has turned since the sweep, positive is counter-clockwise
+ * @return degrees to turn, positive is left, 0 if no heading the sweep covers has room and it's time to look all round
+ */
+int recovery_chooseTurn(int leftSide, int scan[181][2], float headingSinceScan);
+
+/**
+ * @brief Pick a way out from the panorama, all the way round to straight
+ * back. Headings are tried away from the hazard first, smallest turn first,
+ * and the first with RECOVERY_CLEAR_CM of room is taken, otherwise the most
+ * open heading anywhere wins.
+ *
+ * @param leftSide 1 if the hazard was on the left, 0 if on the right
+ * @param headingSinceRef degrees the robot has turned since the panorama's reference pose, positive is
+ *                        counter-clockwise
+ * @return degrees to turn from where the robot faces now, positive is left
+ */
+int recovery_choosePanoramaTurn(int leftSide, float headingSinceRef);
+
+#endif /* RECOVERY_H_ */
@@ -4,9 +4,203 @@
 
 #include "scan.h"
 
+/*
+ * Where the sweep started by scan_startRegions() is up to. PING is triggered as the servo is sent to each angle,
+ * like doScan() does, and read SCAN_PING_MS later. Moves too long to settle in that time wait in SWEEP_SLEWING first.
+ */
+static enum {SWEEP_IDLE, SWEEP_SLEWING, SWEEP_PINGING} sweepState = SWEEP_IDLE;
+static scan_region_t sweepRegions[SCAN_MAX_REGIONS];
+static int sweepCount;
+static int sweepRegion;
+static int sweepDir;
+static int sweepAngle;
+static unsigned int sweepDue;
+
+//Where the servo was last sent, -1 until it has been
+static int servoAt = -1;
+
+//When and where the PING in flight was triggered
+static unsigned int pingMillis;
+static pose_t pingPose;
+
 void doScan(int angle, scanInstance* scan) {
     servo_move(angle);
+    servoAt = angle;
+    scan->angle = angle;
+    scan->fromAngle = angle;
+    scan->toAngle = angle;
+    scan->millis = timer_getMillis();
+    odom_getPose(&scan->pose);
     scan->irRaw = adc_read();
     scan->irDist = adc_getDistance(scan->irRaw);
     scan->pingDist = ping_getDistance() * 100;
 }
+
+/**
+ * Send the servo to an angle
+ * @return How long it needs to get there before PING can be trusted, ms
+ */
+static int scan_slew(int angle) {
+    int travel = servoAt < 0 ? 180 : angle > servoAt ? angle - servoAt : servoAt - angle;
+    servo_move(angle);
+    servoAt = angle;
+    return travel <= SCAN_FREE_DEG ? 0 : travel * SCAN_SLEW_MS_PER_DEG;
+}
+
+/**
+ * The sample of the current region nearest its start in the direction we're going
+ */
+static int scan_regionStart(const scan_region_t *r) {
+    if (sweepDir > 0) {
+        return r->fromAngle;
+    }
+    return r->fromAngle + (r->toAngle - r->fromAngle) / r->step * r->step;
+}
+
+/**
+ * Send PING out, noting when and from where
+ */
+static void scan_ping(void) {
+    pingMillis = timer_getMillis();
+    odom_getPose(&pingPose);
+    ping_trigger();
+    sweepDue = pingMillis + SCAN_PING_MS;
+    sweepState = SWEEP_PINGING;
+}
+
+/**
+ * Move on to sweepAngle, waiting on the servo first if it has far to go
+ */
+static void scan_goTo(void) {
+    int wait = scan_slew(sweepAngle);
+    if (wait > 0) {
+        sweepDue = timer_getMillis() + wait;
+        sweepState = SWEEP_SLEWING;
+    }
+    else {
+        scan_ping();
+    }
+}
+
+void scan_startSweep(int fromAngle, int toAngle, int step) {
+    scan_region_t all = {fromAngle, toAngle, step};
+    scan_startRegions(&all, 1);
+}
+
+int scan_startRegions(const scan_region_t *regions, int count) {
+    int i, j;
+
+    if (count > SCAN_MAX_REGIONS) {
+        count = SCAN_MAX_REGIONS;
+    }
+
+    //Tidied up and sorted by where they start
+    sweepCount = 0;
+    for (i = 0; i < count; i++) {
+        scan_region_t r = regions[i];
+        if (r.fromAngle > r.toAngle) {
+            int tmp = r.fromAngle;
+            r.fromAngle = r.toAngle;
+            r.toAngle = tmp;
+        }
+        r.step = r.step < 0 ? -r.step : r.step == 0 ? 2 : r.step;
+        r.fromAngle = r.fromAngle < 0 ? 0 : r.fromAngle;
+        r.toAngle = r.toAngle > 180 ? 180 : r.toAngle;
+        if (r.fromAngle > r.toAngle) {
+            continue;
+        }
+        for (j = sweepCount; j > 0 && sweepRegions[j - 1].fromAngle > r.fromAngle; j--) {
+            sweepRegions[j] = sweepRegions[j - 1];
+        }
+        sweepRegions[j] = r;
+        sweepCount++;
+    }
+
+    //Nothing gets sampled twice, a region starts one of its steps after the last sample of the one before
+    for (i = 1; i < sweepCount;) {
+        scan_region_t *prev = &sweepRegions[i - 1];
+        int prevLast = prev->fromAngle + (prev->toAngle - prev->fromAngle) / prev->step * prev->step;
+        if (sweepRegions[i].fromAngle <= prevLast) {
+            sweepRegions[i].fromAngle = prevLast + sweepRegions[i].step;
+        }
+        if (sweepRegions[i].fromAngle > sweepRegions[i].toAngle) {
+            for (j = i + 1; j < sweepCount; j++) {
+                sweepRegions[j - 1] = sweepRegions[j];
+            }
+            sweepCount--;
+        }
+        else {
+            i++;
+        }
+    }
+
+    if (sweepCount == 0) {
+        sweepState = SWEEP_IDLE;
+        return 0;
+    }
+
+    //Start from whichever end of the lot is nearer the servo and work across to the other
+    int toLow = servoAt - sweepRegions[0].fromAngle;
+    int toHigh = sweepRegions[sweepCount - 1].toAngle - servoAt;
+    sweepDir = servoAt >= 0 && toHigh < toLow ? -1 : 1;
+    sweepRegion = sweepDir > 0 ? 0 : sweepCount - 1;
+    sweepAngle = scan_regionStart(&sweepRegions[sweepRegion]);
+    scan_goTo();
+    return sweepCount;
+}
+
+int scan_pollSweep(scanInstance* scan) {
+    if (sweepState == SWEEP_IDLE) {
+        return SCAN_DONE;
+    }
+    //Signed so the millisecond counter wrapping doesn't matter
+    if ((int)(timer_getMillis() - sweepDue) < 0) {
+        return SCAN_BUSY;
+    }
+
+    if (sweepState == SWEEP_SLEWING) {
+        scan_ping();
+        return SCAN_BUSY;
+    }
+
+    const scan_region_t *r = &sweepRegions[sweepRegion];
+    scan->angle = sweepAngle;
+    scan->irRaw = adc_read();
+    scan->irDist = adc_getDistance(scan->irRaw);
+    scan->pingDist = ping_lastDistance() * 100;
+    scan->millis = pingMillis;
+    scan->pose = pingPose;
+
+    //Half a step either side, so a coarse region still fills every angle it spans
+    scan->fromAngle = sweepAngle - r->step / 2 + 1;
+    scan->toAngle = sweepAngle + r->step / 2;
+    if (scan->fromAngle > sweepAngle) {
+        scan->fromAngle = sweepAngle;
+    }
+    if (scan->toAngle < sweepAngle || r->step <= 2) {
+        scan->toAngle = sweepAngle;
+    }
+    scan->fromAngle = scan->fromAngle < r->fromAngle ? r->fromAngle : scan->fromAngle;
+    scan->toAngle = scan->toAngle > r->toAngle ? r->toAngle : scan->toAngle;
+
+    //Straight on to the next angle, its echo comes back while the caller gets on with other things
+    sweepAngle += sweepDir * r->step;
+    if (sweepAngle < r->fromAngle || sweepAngle > r->toAngle) {
+        sweepRegion += sweepDir;
+        if (sweepRegion < 0 || sweepRegion >= sweepCount) {
+            sweepState = SWEEP_IDLE;
+            return SCAN_SAMPLE;
+        }
+        sweepAngle = scan_regionStart(&sweepRegions[sweepRegion]);
+    }
+    scan_goTo();
+    return SCAN_SAMPLE;
+}
+
+int scan_isSweeping(void) {
+    return sweepState != SWEEP_IDLE;
+}
+
+void scan_stopSweep(void) {
+    sweepState = SWEEP_IDLE;
+}
@@ -9,15 +9,85 @@
 #include "ping.h"
 #include "servo.h"
 #include "Timer.h"
+#include "odometry.h"
 
 typedef struct {
     uint16_t irRaw;
     double irDist;
     float pingDist;
     int angle;
+    //The angles this sample stands for, from and to inclusive. Just angle unless it came from a region swept coarser
+    //than the 2 degrees dataPoints[][] is filled at
+    int fromAngle;
+    int toAngle;
+    //When PING was triggered for it and where the robot was then, so samples taken on the move can be put together
+    unsigned int millis;
+    pose_t pose;
 } scanInstance;
 
+/**
+ * One stretch of a region sweep, sampled every step degrees from fromAngle up to toAngle
+ */
+typedef struct {
+    int fromAngle;
+    int toAngle;
+    int step;
+} scan_region_t;
+
+//Time for the servo to swing back to the start of a sweep, ms
+#define SCAN_RETURN_MS 1500
+//Servo travel time, ms per degree. Moves of up to SCAN_FREE_DEG settle while PING is out
+#define SCAN_SLEW_MS_PER_DEG (SCAN_RETURN_MS / 180)
+#define SCAN_FREE_DEG 2
+//Most regions in one sweep
+#define SCAN_MAX_REGIONS 8
+//Time a PING echo gets to come back, ms
+#define SCAN_PING_MS 50
+
+//scan_pollSweep() outcomes
+#define SCAN_BUSY 0
+#define SCAN_SAMPLE 1
+#define SCAN_DONE 2
+
 void doScan(int angle, scanInstance* scan);
 
+/**
+ * Start a sweep that is taken a sample at a time by scan_pollSweep(), so the caller never waits on the servo or PING.
+ * Anything left of a previous sweep is dropped. It is a single region for scan_startRegions(), so it runs from
+ * whichever end the servo is nearer.
+ * @param fromAngle One end of the sweep
+ * @param toAngle The other end
+ * @param step Degrees between samples
+ */
+void scan_startSweep(int fromAngle, int toAngle, int step);
+
+/**
+ * Start a sweep of just the given stretches of the field, each at its own resolution, taken a sample at a time by
+ * scan_pollSweep() like scan_startSweep(). The stretches are sorted and run in whichever direction starts nearest the
+ * servo, so it only crosses the field once, and it waits on the servo only as long as each move needs rather than a
+ * full return. A stretch overlapping one before it starts after it.
+ * @param regions Stretches to sample, in any order. Angles outside 0 to 180 are cut off
+ * @param count Number of regions, only the first SCAN_MAX_REGIONS are used
+ * @return Number of stretches that will be swept, 0 if none were left and the sweep is already done
+ */
+int scan_startRegions(const scan_region_t *regions, int count);
+
+/**
+ * Check on the sweep. Returns straight away.
+ * @param scan Filled with the next sample, angle included, when SCAN_SAMPLE is returned
+ * @return SCAN_SAMPLE for a new sample, SCAN_BUSY while waiting on the hardware, SCAN_DONE once the sweep is over
+ */
+int scan_pollSweep(scanInstance* scan);
+
+/**
+ * @return 1 while a sweep is under way, 0 once it is done or stopped
+ */
+int scan_isSweeping(void);
+
+/**
+ * Drop the rest of the sweep, so the next scan_pollSweep() says it's done. The servo stays where it is
+ */
+void scan_stopSweep(void);
+
 #endif //CPRE288_PROJECT_SCAN_H
 
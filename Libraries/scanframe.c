@@ -0,0 +1,148 @@
+/**
+ * Sweeps taken on the move
+ * @file scanframe.c
+ */
+
+#include <math.h>
+#include "scanframe.h"
+
+//Two angles either side of a hole agree if they're this close, cm
+#define FRAME_FILL_CM 10
+
+/// What PING hit at one servo angle, in the odometry frame
+typedef struct {
+    int16_t x;          // mm
+    int16_t y;
+    uint16_t range;     // cm from where it was taken, to carry the IR reading over to another pose
+    uint16_t irRaw;
+    uint32_t taken;     // timer_getMillis() when PING was triggered
+    uint8_t valid;
+} frame_point_t;
+
+static frame_point_t points[FRAME_ANGLES];
+//What the light bumps saw, kept apart so they never stand in for a servo sample
+static frame_point_t nearPoints[FRAME_ANGLES];
+
+void frame_clear(void) {
+    int i;
+    for (i = 0; i < FRAME_ANGLES; i++) {
+        points[i].valid = 0;
+        nearPoints[i].valid = 0;
+    }
+}
+
+static void frame_put(frame_point_t layer[FRAME_ANGLES], const scanInstance *s) {
+    int a;
+    int range = (int)s->pingDist;
+    if (range <= 0) {
+        return;
+    }
+
+    //Every even angle the sample stands for gets its own point along that angle
+    for (a = (s->fromAngle + 1) & ~1; a <= s->toAngle; a += 2) {
+        if (a < 0 || a > 180) {
+            continue;
+        }
+        frame_point_t *p = &layer[a / 2];
+        float ray = s->pose.theta + (a - 90) * DEG_TO_RAD;
+        p->x = (int16_t)(s->pose.x + range * 10.0f * cosf(ray));
+        p->y = (int16_t)(s->pose.y + range * 10.0f * sinf(ray));
+        p->range = range;
+        p->irRaw = s->irRaw;
+        p->taken = s->millis;
+        p->valid = 1;
+    }
+}
+
+void frame_add(const scanInstance *s) {
+    frame_put(points, s);
+}
+
+void frame_addNear(const scanInstance *s) {
+    frame_put(nearPoints, s);
+}
+
+/**
+ * Where a point is from ref, as the even servo angle it lands on and its distance in cm
+ * @return 0 if it lands outside 0 to 180 degrees
+ */
+static int frame_locate(const frame_point_t *p, const pose_t *ref, int *angle, int *dist) {
+    float dx = p->x - ref->x;
+    float dy = p->y - ref->y;
+    float bearing = odom_wrapAngle(atan2f(dy, dx) - ref->theta) / DEG_TO_RAD;
+    *angle = (int)floorf((bearing + 90.0f) / 2.0f + 0.5f) * 2;
+    if (*angle < 0 || *angle > 180) {
+        return 0;
+    }
+    *dist = (int)(sqrtf(dx * dx + dy * dy) / 10.0f + 0.5f);
+    if (*dist < 1) {
+        *dist = 1;
+    }
+    return 1;
+}
+
+int frame_project(const pose_t *ref, unsigned int since, int scan[181][2]) {
+    int i, a;
+    int n = 0;
+
+    for (a = 0; a <= 180; a++) {
+        scan[a][0] = 0;
+        scan[a][1] = 0;
+    }
+
+    for (i = 0; i < FRAME_ANGLES; i++) {
+        const frame_point_t *p = &points[i];
+        //Signed so the millisecond counter wrapping doesn't matter
+        if (!p->valid || (int)(p->taken - since) < 0) {
+            continue;
+        }
+        int dist;
+        if (!frame_locate(p, ref, &a, &dist)) {
+            continue;
+        }
+        if (scan[a][0] > 0 && scan[a][0] <= dist) {
+            continue;
+        }
+        if (scan[a][0] == 0) {
+            n++;
+        }
+        scan[a][0] = dist;
+
+        //The IR curve in adc_getDistance() is close to inverse in range, so scale the reading by how much nearer or
+        //further the point is from here than from where it was taken
+        int ir = p->irRaw * p->range / dist;
+        scan[a][1] = ir > FRAME_IR_MAX ? FRAME_IR_MAX : ir;
+    }
+
+    //Moving spreads the angles out, so fill the odd one left between two that saw the same thing
+    for (a = 2; a <= 178; a += 2) {
+        int l = scan[a - 2][0];
+        int r = scan[a + 2][0];
+        if (scan[a][0] > 0 || l <= 0 || r <= 0 || l - r > FRAME_FILL_CM || r - l > FRAME_FILL_CM) {
+            continue;
+        }
+        int from = l < r ? a - 2 : a + 2;
+        scan[a][0] = scan[from][0];
+        scan[a][1] = scan[from][1];
+        n++;
+    }
+    return n;
+}
+
+int frame_mergeNear(const pose_t *ref, unsigned int since, int scan[181][2]) {
+    int i, a, dist;
+    int n = 0;
+
+    for (i = 0; i < FRAME_ANGLES; i++) {
+        const frame_point_t *p = &nearPoints[i];
+        if (!p->valid || (int)(p->taken - since) < 0 || !frame_locate(p, ref, &a, &dist)) {
+            continue;
+        }
+        //Only ever brings a range in, the IR reading stays whatever the servo saw there
+        if (scan[a][0] == 0 || dist < scan[a][0]) {
+            scan[a][0] = dist;
+            n++;
+        }
+    }
+    return n;
+}
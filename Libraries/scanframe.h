@@ -0,0 +1,74 @@
+/**
+ * Sweeps taken on the move
+ * @file scanframe.h
+ *
+ * A sample is only an angle and a range until it is known where the robot
+ * was when it was taken. Every sample comes out of scan_pollSweep() tagged
+ * with the pose and time PING was triggered at, and is kept here as the
+ * point it hit in the odometry frame, one per even servo angle. Whenever a
+ * decision is due the points are turned back into a sweep as seen from the
+ * robot's pose right then, so a sweep taken while driving reads just like
+ * one taken standing still and everything downstream keeps working off
+ * dataPoints[][].
+ *
+ * The light bumps only say how far away something is, not what it is, so
+ * what they see is kept in a layer of its own. Only the decisions about how
+ * far we can go take it in, with frame_mergeNear(), so it never hides what
+ * PING and IR saw from the object finder or the map.
+ */
+
+#ifndef SCANFRAME_H_
+#define SCANFRAME_H_
+
+#include <stdint.h>
+#include "odometry.h"
+#include "scan.h"
+
+/// Servo angles kept, every even one from 0 to 180
+#define FRAME_ANGLES 91
+/// Highest raw IR reading, the ADC is 12 bit
+#define FRAME_IR_MAX 4095
+
+/**
+ * @brief Forget every sample
+ */
+void frame_clear(void);
+
+/**
+ * @brief Put a sample on the floor, replacing the last one taken at its angles
+ *
+ * @param s sample from scan_pollSweep() or doScan(), with the pose and time it was taken
+ */
+void frame_add(const scanInstance *s);
+
+/**
+ * @brief Put a light bump sample on the floor in the near-field layer, replacing the last one there at its angles
+ *
+ * @param s sample from lbump_toSample()
+ */
+void frame_addNear(const scanInstance *s);
+
+/**
+ * @brief Turn the kept samples into a sweep as seen from a pose. Each lands on the even angle nearest where it is
+ * from there, the nearest wins if two land together, and a single angle left empty between two that agree is
+ * filled from the nearer one. Angles nothing lands on are 0. Light bump samples are left out.
+ *
+ * @param ref pose to see the samples from
+ * @param since samples taken before this timer_getMillis() time are left out
+ * @param scan filled indexed by servo angle, scan[a][0] PING distance in cm and scan[a][1] raw IR
+ * @return angles filled
+ */
+int frame_project(const pose_t *ref, unsigned int since, int scan[181][2]);
+
+/**
+ * @brief Bring the ranges of a sweep in to whatever the light bumps have seen closer, as seen from a pose. IR
+ * readings are left alone
+ *
+ * @param ref pose the sweep is seen from
+ * @param since light bump samples taken before this timer_getMillis() time are left out
+ * @param scan sweep from frame_project(), indexed by servo angle
+ * @return angles brought in
+ */
+int frame_mergeNear(const pose_t *ref, unsigned int since, int scan[181][2]);
+
+#endif /* SCANFRAME_H_ */
@@ -0,0 +1,94 @@
+/**
+ * Correlative scan matching against the occupancy grid
+ * @file scanmatch.c
+ */
+
+#include <math.h>
+#include "scanmatch.h"
+
+#define MATCH_MAX_ECHOES 91
+
+static int match_abs(int x) {
+    return x < 0 ? -x : x;
+}
+
+int match_sweep(int scan[181][2], const pose_t *scanPose, match_result_t *out) {
+    int16_t ex[MATCH_MAX_ECHOES];
+    int16_t ey[MATCH_MAX_ECHOES];
+    int range[MATCH_MAX_ECHOES];
+    int angle[MATCH_MAX_ECHOES];
+    int n = 0;
+    int a, k, ix, iy, i;
+
+    //Only real echoes can be matched, out of range readings say nothing about where walls are
+    for (a = 0; a <= 180; a += 2) {
+        if (scan[a][0] > 0 && scan[a][0] < GRID_MAX_RANGE_CM) {
+            range[n] = scan[a][0] * 10;
+            angle[n] = a - 90;
+            n++;
+        }
+    }
+
+    out->dx = 0;
+    out->dy = 0;
+    out->dtheta = 0;
+    out->score = 0;
+    out->support = 0;
+    out->echoes = n;
+    if (n < MATCH_MIN_ECHOES) {
+        return 0;
+    }
+
+    int bestK = 0;
+    int bestX = 0;
+    int bestY = 0;
+    int32_t best = INT32_MIN;
+
+    for (k = -MATCH_ANGLE_STEPS; k <= MATCH_ANGLE_STEPS; k++) {
+        float theta = scanPose->theta + k * MATCH_ANGLE_STEP_DEG * DEG_TO_RAD;
+        for (i = 0; i < n; i++) {
+            int cx, cy;
+            float ray = theta + angle[i] * DEG_TO_RAD;
+            grid_worldToCell(scanPose->x + range[i] * cosf(ray), scanPose->y + range[i] * sinf(ray), &cx, &cy);
+            ex[i] = (int16_t)cx;
+            ey[i] = (int16_t)cy;
+        }
+
+        for (iy = -MATCH_SHIFT_CELLS; iy <= MATCH_SHIFT_CELLS; iy++) {
+            for (ix = -MATCH_SHIFT_CELLS; ix <= MATCH_SHIFT_CELLS; ix++) {
+                int32_t score = -MATCH_PRIOR_WEIGHT * (match_abs(ix) + match_abs(iy) + match_abs(k));
+                for (i = 0; i < n; i++) {
+                    score += grid_get(ex[i] + ix, ey[i] + iy);
+                }
+                if (score > best) {
+                    best = score;
+                    bestK = k;
+                    bestX = ix;
+                    bestY = iy;
+                }
+            }
+        }
+    }
+
+    //Count how much of the sweep the map actually backs up at the winning pose
+    float theta = scanPose->theta + bestK * MATCH_ANGLE_STEP_DEG * DEG_TO_RAD;
+    for (i = 0; i < n; i++) {
+        int cx, cy;
+        float ray = theta + angle[i] * DEG_TO_RAD;
+        grid_worldToCell(scanPose->x + range[i] * cosf(ray), scanPose->y + range[i] * sinf(ray), &cx, &cy);
+        if (grid_isOccupied(cx + bestX, cy + bestY)) {
+            out->support++;
+        }
+    }
+
+    out->dx = bestX * GRID_CELL_MM;
+    out->dy = bestY * GRID_CELL_MM;
+    out->dtheta = bestK * MATCH_ANGLE_STEP_DEG * DEG_TO_RAD;
+    out->score = best;
+
+    //A best fit on the edge of the window probably belongs outside it, so don't trust it
+    if (match_abs(bestK) == MATCH_ANGLE_STEPS || match_abs(bestX) == MATCH_SHIFT_CELLS || match_abs(bestY) == MATCH_SHIFT_CELLS) {
+        return 0;
+    }
+    return out->support >= MATCH_MIN_SUPPORT;
+}
@@ -0,0 +1,59 @@
+/**
+ * Correlative scan matching against the occupancy grid
+ * @file scanmatch.h
+ *
+ * Before a new sweep goes into the map, every pose in a small window around
+ * the odometry estimate is tried and the one that lands the most PING echoes
+ * on cells the map already holds as occupied wins. Headings are tried one at a
+ * time so the trig is done once per heading, and translations are whole grid
+ * cells so each one is just an integer offset. The window is fixed, so the
+ * worst case cost is too: (2 * MATCH_ANGLE_STEPS + 1) * (2 * MATCH_SHIFT_CELLS
+ * + 1)^2 * 91 cell lookups, about 75k.
+ */
+
+#ifndef SCANMATCH_H_
+#define SCANMATCH_H_
+
+#include "odometry.h"
+#include "grid.h"
+
+/// Heading window, MATCH_ANGLE_STEPS steps of MATCH_ANGLE_STEP_DEG either side of odometry
+#define MATCH_ANGLE_STEP_DEG 1
+#define MATCH_ANGLE_STEPS 8
+/// Translation window in grid cells either side of odometry
+#define MATCH_SHIFT_CELLS 3
+
+/// Score taken off per cell or step away from odometry, so ties go to the smallest correction
+#define MATCH_PRIOR_WEIGHT 4
+/// Fewest echoes a sweep needs to be worth matching
+#define MATCH_MIN_ECHOES 12
+/// Fewest echoes that must land on occupied map cells to trust the match
+#define MATCH_MIN_SUPPORT 8
+
+/// Uncertainty of an accepted match, half a cell and one step
+#define MATCH_XY_VARIANCE ((GRID_CELL_MM / 2.0f) * (GRID_CELL_MM / 2.0f))
+#define MATCH_THETA_VARIANCE (0.0175f * 0.0175f)
+
+/// Outcome of a match
+typedef struct {
+    float dx;           // correction to add to the sweep pose, mm
+    float dy;
+    float dtheta;       // radians
+    int32_t score;      // summed log-odds under the echoes at the best pose, less the prior
+    int support;        // echoes landing on occupied cells at the best pose
+    int echoes;         // echoes used
+} match_result_t;
+
+/**
+ * @brief Find the pose near the odometry estimate where the sweep best fits
+ * the map. Must be called before the sweep itself is added to the grid.
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param scanPose odometry pose when the sweep was taken
+ * @param out filled with the correction
+ * @return 1 if the match is good enough to apply, 0 if the map doesn't have
+ * enough to go on or the best fit was on the edge of the window
+ */
+int match_sweep(int scan[181][2], const pose_t *scanPose, match_result_t *out);
+
+#endif /* SCANMATCH_H_ */
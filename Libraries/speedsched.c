@@ -0,0 +1,69 @@
+/**
+ * Clearance based speed scheduling
+ * @file speedsched.c
+ */
+
+#include <math.h>
+#include "speedsched.h"
+#include "motion.h"
+#include "boundary.h"
+
+float speed_clearance(int scan[181][2], const pose_t *scanPose, const pose_t *now, float bearing) {
+    int a;
+    float clearance = SPEED_MAX_RANGE_CM * 10.0f;
+
+    //Direction of travel in the world frame
+    float heading = now->theta + bearing * DEG_TO_RAD;
+    float ch = cosf(heading);
+    float sh = sinf(heading);
+
+    for (a = 0; a <= 180; a += 2) {
+        int r = scan[a][0];
+        if (r <= 0 || r >= SPEED_MAX_RANGE_CM) {
+            continue;
+        }
+
+        //Where the echo came from in the world, servo angle 90 was straight ahead at scan time
+        float ray = scanPose->theta + (a - 90) * DEG_TO_RAD;
+        float wx = scanPose->x + r * 10.0f * cosf(ray) - now->x;
+        float wy = scanPose->y + r * 10.0f * sinf(ray) - now->y;
+
+        //Split into distance along the direction of travel and distance off to the side of it
+        float along = wx * ch + wy * sh;
+        float across = -wx * sh + wy * ch;
+        if (along > 0 && across < SPEED_CORRIDOR_HALF_MM && across > -SPEED_CORRIDOR_HALF_MM && along < clearance) {
+            clearance = along;
+        }
+    }
+
+    //Tape and cliffs we've run into before count as much as anything the sweep saw
+    return boundary_clearance(now->x, now->y, heading, SPEED_CORRIDOR_HALF_MM, clearance);
+}
+
+int speed_forClearance(float clearance_mm) {
+    //Distance to stop from v is v*t + v^2/2a, solved for v
+    float d = clearance_mm - SPEED_STOP_MARGIN_MM;
+    float at = MOTION_DRIVE_DECEL * SPEED_REACTION_S;
+    float v = d > 0 ? sqrtf(at * at + 2.0f * MOTION_DRIVE_DECEL * d) - at : 0;
+
+    //Never past the drive ceiling, the heading hold needs the rest of the wheel range
+    if (v > MOTION_DRIVE_SPEED) {
+        return MOTION_DRIVE_SPEED;
+    }
+    if (v < SPEED_FLOOR) {
+        return SPEED_FLOOR;
+    }
+    return (int)v;
+}
+
+int speed_schedule(int scan[181][2], const pose_t *scanPose, const pose_t *now, float bearing, const hazard_t *haz) {
+    if (haz->contact != MOTION_OK) {
+        return SPEED_FLOOR;
+    }
+
+    int speed = speed_forClearance(speed_clearance(scan, scanPose, now, bearing));
+
+    //Something close in front of the bumper right now trumps an old sweep
+    speed = (int)(speed * haz->speedScale);
+    return speed < SPEED_FLOOR ? SPEED_FLOOR : speed;
+}
@@ -0,0 +1,61 @@
+/**
+ * Clearance based speed scheduling
+ * @file speedsched.h
+ *
+ * Picks the fastest cruise speed that can still stop inside the free space the
+ * last sweep showed along the direction we're about to drive. Open stretches
+ * get the full cruise speed, cluttered ones get crept through.
+ */
+
+#ifndef SPEEDSCHED_H_
+#define SPEEDSCHED_H_
+
+#include "odometry.h"
+#include "hazard.h"
+
+/// Half of the corridor that has to be clear, robot radius plus a little, mm
+#define SPEED_CORRIDOR_HALF_MM 200.0f
+/// Room left between where we plan to stop and the obstacle, mm
+#define SPEED_STOP_MARGIN_MM 150.0f
+/// Time between something appearing and the brakes going on, sensor period plus command latency, s
+#define SPEED_REACTION_S 0.1f
+/// PING readings past this are treated as open space, cm
+#define SPEED_MAX_RANGE_CM 250
+/// Never schedule slower than this, the light bumpers cover the last few cm, mm/s
+#define SPEED_FLOOR 100
+
+/**
+ * @brief Free distance along a bearing inside a robot-wide corridor, using
+ * the last sweep moved into the robot's current frame and any boundary tape
+ * or cliffs run into so far (boundary.h)
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param scanPose pose when the sweep was taken
+ * @param now current pose
+ * @param bearing degrees from the current heading to check, positive is left
+ * @return free distance in mm
+ */
+float speed_clearance(int scan[181][2], const pose_t *scanPose, const pose_t *now, float bearing);
+
+/**
+ * @brief Fastest speed that can stop within the given free distance
+ *
+ * @param clearance_mm free distance ahead in mm
+ * @return speed in mm/s, SPEED_FLOOR to MOTION_DRIVE_SPEED
+ */
+int speed_forClearance(float clearance_mm);
+
+/**
+ * @brief Cruise speed for a move along a bearing, from the sweep clearance
+ * and the current light bumper and contact state
+ *
+ * @param scan sweep as for speed_clearance()
+ * @param scanPose pose when the sweep was taken
+ * @param now current pose
+ * @param bearing degrees from the current heading of the move, positive is left
+ * @param haz latest hazard state
+ * @return speed in mm/s to hand to motion_setMaxSpeed()
+ */
+int speed_schedule(int scan[181][2], const pose_t *scanPose, const pose_t *now, float bearing, const hazard_t *haz);
+
+#endif /* SPEEDSCHED_H_ */
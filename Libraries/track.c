@@ -0,0 +1,166 @@
+/**
+ * Object tracking across sweeps
+ * @file track.c
+ */
+
+#include <math.h>
+#include "track.h"
+
+static track_t tracks[TRACK_MAX];
+static int numTracks = 0;
+static int nextId = 1;
+
+void track_clear(void) {
+    numTracks = 0;
+}
+
+/**
+ * Start a track for a detection nobody claimed, pushing out the least seen one if there's no room
+ */
+static int track_start(float x, float y, float width) {
+    int i;
+    int slot = numTracks;
+
+    if (numTracks < TRACK_MAX) {
+        numTracks++;
+    }
+    else {
+        slot = 0;
+        for (i = 1; i < numTracks; i++) {
+            if (tracks[i].sightings - tracks[i].missed < tracks[slot].sightings - tracks[slot].missed) {
+                slot = i;
+            }
+        }
+    }
+
+    track_t *t = &tracks[slot];
+    t->id = nextId;
+    t->x = x;
+    t->y = y;
+    t->width_cm = width;
+    t->sightings = 1;
+    t->missed = 0;
+    nextId = nextId >= 9999 ? 1 : nextId + 1;
+    return t->id;
+}
+
+void track_update(const pose_t *scanPose, int scan[181][2], int objects[][4], int numObjs, int *ids) {
+    float ox[TRACK_MAX_DETECTIONS];
+    float oy[TRACK_MAX_DETECTIONS];
+    int claimed[TRACK_MAX];
+    int i, j;
+
+    if (numObjs > TRACK_MAX_DETECTIONS) {
+        numObjs = TRACK_MAX_DETECTIONS;
+    }
+
+    //Detections on the floor. PING measures to the near face, the centre is half a width further
+    for (i = 0; i < numObjs; i++) {
+        float range = (objects[i][1] + objects[i][2] / 2.0f) * 10.0f;
+        float heading = scanPose->theta + (objects[i][0] - 90) * DEG_TO_RAD;
+        ox[i] = scanPose->x + range * cosf(heading);
+        oy[i] = scanPose->y + range * sinf(heading);
+        ids[i] = 0;
+    }
+    for (j = 0; j < numTracks; j++) {
+        claimed[j] = 0;
+    }
+
+    //Closest detection and track pair inside the gate first, until there are none left
+    while (1) {
+        int bestObj = -1;
+        int bestTrack = -1;
+        float bestD2 = TRACK_GATE_MM * TRACK_GATE_MM;
+        for (i = 0; i < numObjs; i++) {
+            if (ids[i] || objects[i][1] <= 0) {
+                continue;
+            }
+            for (j = 0; j < numTracks; j++) {
+                float dx = ox[i] - tracks[j].x;
+                float dy = oy[i] - tracks[j].y;
+                if (!claimed[j] && dx * dx + dy * dy < bestD2) {
+                    bestD2 = dx * dx + dy * dy;
+                    bestObj = i;
+                    bestTrack = j;
+                }
+            }
+        }
+        if (bestObj < 0) {
+            break;
+        }
+
+        //Average in new sightings until there are enough, then keep following at a fixed rate
+        track_t *t = &tracks[bestTrack];
+        float gain = 1.0f / (t->sightings + 1);
+        if (gain < TRACK_MIN_GAIN) {
+            gain = TRACK_MIN_GAIN;
+        }
+        t->x += gain * (ox[bestObj] - t->x);
+        t->y += gain * (oy[bestObj] - t->y);
+        t->width_cm += gain * (objects[bestObj][2] - t->width_cm);
+        t->sightings++;
+        t->missed = 0;
+        claimed[bestTrack] = 1;
+        ids[bestObj] = t->id;
+    }
+
+    //Tracks the sweep should have picked up and didn't
+    int existing = numTracks;
+    for (j = 0; j < existing; j++) {
+        int angle, dist;
+        if (claimed[j] || !track_predict(&tracks[j], scanPose, &angle, &dist)) {
+            continue;
+        }
+        //Sweeps fill every other angle
+        if (scan[angle & ~1][0] > 0 && dist * 10.0f < TRACK_VISIBLE_MM) {
+            tracks[j].missed++;
+        }
+    }
+    for (j = 0; j < numTracks;) {
+        if (tracks[j].missed >= TRACK_MAX_MISSES) {
+            tracks[j] = tracks[--numTracks];
+        }
+        else {
+            j++;
+        }
+    }
+
+    for (i = 0; i < numObjs; i++) {
+        if (!ids[i] && objects[i][1] > 0) {
+            ids[i] = track_start(ox[i], oy[i], objects[i][2]);
+        }
+    }
+}
+
+int track_count(void) {
+    return numTracks;
+}
+
+int track_get(int i, track_t *out) {
+    if (i < 0 || i >= numTracks) {
+        return 0;
+    }
+    *out = tracks[i];
+    return 1;
+}
+
+int track_find(int id, track_t *out) {
+    int i;
+    for (i = 0; i < numTracks; i++) {
+        if (tracks[i].id == id) {
+            *out = tracks[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int track_predict(const track_t *t, const pose_t *now, int *angle, int *dist_cm) {
+    float dx = t->x - now->x;
+    float dy = t->y - now->y;
+    float bearing = odom_wrapAngle(atan2f(dy, dx) - now->theta) / DEG_TO_RAD;
+
+    *angle = (int)floorf(bearing + 90.0f + 0.5f);
+    *dist_cm = (int)((sqrtf(dx * dx + dy * dy) / 10.0f) - t->width_cm / 2.0f);
+    return *angle >= 0 && *angle <= 180;
+}
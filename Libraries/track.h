@@ -0,0 +1,90 @@
+/**
+ * Object tracking across sweeps
+ * @file track.h
+ *
+ * findObjects() starts from nothing every sweep. The tracker keeps what it
+ * found: every object is put on the floor in the odometry frame, so moving
+ * the robot between sweeps is already allowed for when old and new are
+ * compared. Each new detection goes to the nearest track inside a gate,
+ * closest pairs first and one detection per track, and the track's position
+ * and width are smoothed towards it. Detections nobody claims start new
+ * tracks with a new ID. A track that should have been seen but wasn't, for
+ * TRACK_MAX_MISSES sweeps in a row, is dropped; ones out of view are kept.
+ */
+
+#ifndef TRACK_H_
+#define TRACK_H_
+
+#include "odometry.h"
+
+/// Tracks kept at once
+#define TRACK_MAX 12
+/// Most detections taken from one sweep, the size of findObjects()' table
+#define TRACK_MAX_DETECTIONS 15
+/// A detection this close to a track's position is a candidate for it, mm
+#define TRACK_GATE_MM 250.0f
+/// Smoothing never weighs a new sighting less than this
+#define TRACK_MIN_GAIN 0.3f
+/// Tracks missed this many sweeps in a row while in view are dropped
+#define TRACK_MAX_MISSES 3
+/// Objects further than this aren't picked out by the IR threshold, so a track out there isn't missed, mm
+#define TRACK_VISIBLE_MM 700.0f
+
+/// A tracked object
+typedef struct {
+    int id;             // stays the same for as long as the object is tracked, above 0
+    float x;            // centre in the odometry frame, mm
+    float y;
+    float width_cm;     // smoothed width
+    int sightings;      // sweeps it has been seen in
+    int missed;         // sweeps in a row it should have been seen in and wasn't
+} track_t;
+
+/**
+ * @brief Drop every track
+ */
+void track_clear(void);
+
+/**
+ * @brief Match the objects from a sweep against the tracks
+ *
+ * @param scanPose where the sweep was taken from
+ * @param scan the sweep the objects came from, indexed by servo angle. Only tracks that should show up at an angle
+ *             it sampled (PING above 0) can be missed, so a sweep of part of the field leaves the rest alone
+ * @param objects findObjects() table: centre servo angle, PING distance (cm), width (cm), angular width
+ * @param numObjs objects in the table
+ * @param ids filled with the track ID each object was given
+ */
+void track_update(const pose_t *scanPose, int scan[181][2], int objects[][4], int numObjs, int *ids);
+
+/**
+ * @return number of tracks
+ */
+int track_count(void);
+
+/**
+ * @param i track index, not ID
+ * @param out filled with the track
+ * @return 1 if i was a track, 0 if not
+ */
+int track_get(int i, track_t *out);
+
+/**
+ * @param id track ID
+ * @param out filled with the track
+ * @return 1 if the ID is still tracked, 0 if not
+ */
+int track_find(int id, track_t *out);
+
+/**
+ * @brief Where a track should show up in a sweep taken from here
+ *
+ * @param t track
+ * @param now current pose
+ * @param angle set to the servo angle of its centre, 90 is straight ahead
+ * @param dist_cm set to the range to its near face
+ * @return 1 if it is in front of the servo (angle 0 to 180), 0 if not
+ */
+int track_predict(const track_t *t, const pose_t *now, int *angle, int *dist_cm);
+
+#endif /* TRACK_H_ */
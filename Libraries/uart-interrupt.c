@@ -31,6 +31,7 @@ volatile int scanKey = 102;     //letter 'f' starts a scan
 volatile int turnLeft90 = 122;  //letter 'z' turns left 90 degrees
 volatile int turnRight90 = 99;  //letter 'c' turns right 90 degrees
 volatile int turnAround = 120;  //letter 'x' turns bot 180 degrees
+volatile int lookKey = 101;     //letter 'e' scans just what's ahead
 volatile int movementCode = -1;
 
 void uart_interrupt_init(void){
@@ -219,6 +220,9 @@ void UART1_Handler(void)
             else if(byte_received == turnAround) {
                 movementCode = 8;
             }
+            else if(byte_received == lookKey) {
+                movementCode = 9;
+            }
 
         }
     }
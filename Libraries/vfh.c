@@ -0,0 +1,124 @@
+/**
+ * Vector Field Histogram local planner
+ * @file vfh.c
+ */
+
+#include <stdint.h>
+#include "vfh.h"
+
+//Scores prefer the target heading, then not having to turn much to get onto it
+#define VFH_TARGET_WEIGHT 5
+#define VFH_TURN_WEIGHT 2
+
+/**
+ * Half the angle a circle of the given radius covers at a range, in sectors.
+ * Small angle asin, 573/10 degrees per radian.
+ */
+static int vfh_halfSectors(int radius, int range) {
+    int deg = range <= radius ? 90 : (radius * 573 / range + 5) / 10;
+    return (deg + VFH_SECTOR_DEG - 1) / VFH_SECTOR_DEG;
+}
+
+static int vfh_abs(int x) {
+    return x < 0 ? -x : x;
+}
+
+int vfh_steer(int scan[181][2], int targetBearing, int robotWidth, vfh_result_t *out) {
+    int diff[VFH_SECTORS + 1] = {0};
+    //How many sectors either side each reading widens into, -1 for angles that don't count
+    int8_t span[VFH_SECTORS];
+    int radius = robotWidth / 2 + VFH_SAFETY_CM;
+    int a, s;
+
+    //Each reading adds its density across every sector it widens into. Marking
+    //only where the span starts and stops keeps this to one pass over the sweep
+    for (a = 0; a <= 180; a += VFH_SECTOR_DEG) {
+        int d = scan[a][0];
+        int centre = a / VFH_SECTOR_DEG;
+        span[centre] = -1;
+        if (d <= 0 || d >= VFH_RANGE_CM) {
+            continue;
+        }
+        int half = vfh_halfSectors(radius, d);
+        span[centre] = (int8_t)half;
+        int lo = centre - half < 0 ? 0 : centre - half;
+        int hi = centre + half >= VFH_SECTORS ? VFH_SECTORS - 1 : centre + half;
+        diff[lo] += VFH_RANGE_CM - d;
+        diff[hi + 1] -= VFH_RANGE_CM - d;
+    }
+
+    int target = (targetBearing + 90) / VFH_SECTOR_DEG;
+    if (target < 0) {
+        target = 0;
+    } else if (target >= VFH_SECTORS) {
+        target = VFH_SECTORS - 1;
+    }
+    int ahead = 90 / VFH_SECTOR_DEG;
+
+    //Running sum of the marks gives the histogram, walk it for valleys as we go
+    int density = 0;
+    int valleyStart = -1;
+    int best = -1;
+    int bestScore = 0;
+    int bestWidth = 0;
+    for (s = 0; s <= VFH_SECTORS; s++) {
+        int isFree = 0;
+        if (s < VFH_SECTORS) {
+            density += diff[s];
+            isFree = density < VFH_THRESHOLD;
+        }
+        if (isFree && valleyStart < 0) {
+            valleyStart = s;
+        }
+        if (isFree || valleyStart < 0) {
+            continue;
+        }
+
+        //A valley just ended at s - 1
+        int lo = valleyStart;
+        int hi = s - 1;
+        int width = hi - lo + 1;
+        valleyStart = -1;
+        if (width < VFH_MIN_VALLEY) {
+            continue;
+        }
+
+        int candidate;
+        if (width > VFH_WIDE_VALLEY) {
+            //Anywhere half a wide valley in from the edges is fine, as close to the target as that allows
+            candidate = target;
+            if (candidate < lo + VFH_WIDE_VALLEY / 2) {
+                candidate = lo + VFH_WIDE_VALLEY / 2;
+            } else if (candidate > hi - VFH_WIDE_VALLEY / 2) {
+                candidate = hi - VFH_WIDE_VALLEY / 2;
+            }
+        } else {
+            candidate = (lo + hi) / 2;
+        }
+
+        int score = VFH_TARGET_WEIGHT * vfh_abs(candidate - target) + VFH_TURN_WEIGHT * vfh_abs(candidate - ahead);
+        if (best < 0 || score < bestScore) {
+            best = candidate;
+            bestScore = score;
+            bestWidth = width;
+        }
+    }
+
+    if (best < 0) {
+        return 0;
+    }
+
+    //Free distance is the nearest reading whose widened span covers the chosen sector. That sector isn't known
+    //until the valleys are scored, and a nearest-per-sector table built in the first pass would cost a write for
+    //every sector of every span, so this walks the readings again with the spans already worked out
+    out->clearance_cm = VFH_RANGE_CM;
+    for (s = 0; s < VFH_SECTORS; s++) {
+        int d = scan[s * VFH_SECTOR_DEG][0];
+        if (span[s] >= 0 && d < out->clearance_cm && vfh_abs(s - best) <= span[s]) {
+            out->clearance_cm = d;
+        }
+    }
+    out->bearing = best * VFH_SECTOR_DEG - 90;
+    out->valleyWidth = bestWidth * VFH_SECTOR_DEG;
+    return 1;
+}
@@ -0,0 +1,49 @@
+/**
+ * Vector Field Histogram local planner
+ * @file vfh.h
+ *
+ * Turns one PING sweep into a polar obstacle density histogram, one 2 degree
+ * sector per sweep sample. Every reading is widened by the angle the robot's
+ * half width takes up at that range, so any sector left below the threshold
+ * is a heading the whole robot fits down. Runs of free sectors (valleys) are
+ * then scored against the heading we would like to take. Everything is
+ * integer math and the sweep is only walked once.
+ */
+
+#ifndef VFH_H_
+#define VFH_H_
+
+/// Degrees per histogram sector, the sweep's step size
+#define VFH_SECTOR_DEG 2
+#define VFH_SECTORS (180 / VFH_SECTOR_DEG + 1)
+
+/// Readings beyond this don't count as obstacles, cm
+#define VFH_RANGE_CM 150
+/// Sector density above which a heading is blocked. Density is VFH_RANGE_CM minus the range, so a single reading nearer than 90cm blocks
+#define VFH_THRESHOLD 60
+/// Extra room kept either side of the robot, cm
+#define VFH_SAFETY_CM 5
+/// Narrowest valley worth steering into, sectors
+#define VFH_MIN_VALLEY 2
+/// Valleys wider than this are steered along one edge instead of down the middle, sectors
+#define VFH_WIDE_VALLEY 16
+
+/// Chosen heading
+typedef struct {
+    int bearing;        // degrees from straight ahead, positive is left
+    int clearance_cm;   // free distance along the bearing, VFH_RANGE_CM if nothing was seen
+    int valleyWidth;    // width of the valley it came from, degrees
+} vfh_result_t;
+
+/**
+ * @brief Pick the free heading closest to the one we want
+ *
+ * @param scan sweep indexed by servo angle, scan[a][0] is PING distance in cm (0 if not sampled)
+ * @param targetBearing heading we'd like, degrees from straight ahead, positive is left
+ * @param robotWidth width of the robot in cm
+ * @param out filled with the chosen heading
+ * @return 1 if a heading was found, 0 if every direction is blocked
+ */
+int vfh_steer(int scan[181][2], int targetBearing, int robotWidth, vfh_result_t *out);
+
+#endif /* VFH_H_ */
@@ -0,0 +1,212 @@
+/**
+ * Parking zone detector fitting the known post layout
+ * @file zone.c
+ */
+
+#include <math.h>
+#include "zone.h"
+
+typedef struct {
+    float x;
+    float y;
+    int sightings;
+} zone_post_t;
+
+static zone_post_t seen[ZONE_MAX_CANDIDATES];
+static int numSeen = 0;
+
+/// The layout relative to its own centre
+static float layoutX[ZONE_MAX_POSTS];
+static float layoutY[ZONE_MAX_POSTS];
+static int numLayout = 0;
+
+void zone_init(const int16_t *postX, const int16_t *postY, int numPosts) {
+    int i;
+    float cx = 0;
+    float cy = 0;
+
+    if (numPosts > ZONE_MAX_POSTS) {
+        numPosts = ZONE_MAX_POSTS;
+    }
+    for (i = 0; i < numPosts; i++) {
+        cx += postX[i];
+        cy += postY[i];
+    }
+    for (i = 0; i < numPosts; i++) {
+        layoutX[i] = postX[i] - cx / numPosts;
+        layoutY[i] = postY[i] - cy / numPosts;
+    }
+    numLayout = numPosts;
+    numSeen = 0;
+}
+
+void zone_addPost(float x, float y) {
+    int i;
+    int nearest = -1;
+    int weakest = 0;
+    float nearestD2 = ZONE_MERGE_MM * ZONE_MERGE_MM;
+
+    for (i = 0; i < numSeen; i++) {
+        float dx = seen[i].x - x;
+        float dy = seen[i].y - y;
+        if (dx * dx + dy * dy < nearestD2) {
+            nearestD2 = dx * dx + dy * dy;
+            nearest = i;
+        }
+        if (seen[i].sightings < seen[weakest].sightings) {
+            weakest = i;
+        }
+    }
+
+    //Seen before, average it in
+    if (nearest >= 0) {
+        zone_post_t *p = &seen[nearest];
+        p->x = (p->x * p->sightings + x) / (p->sightings + 1);
+        p->y = (p->y * p->sightings + y) / (p->sightings + 1);
+        if (p->sightings < 100) {
+            p->sightings++;
+        }
+        return;
+    }
+
+    //New, making room by forgetting the least seen post if we have to
+    if (numSeen < ZONE_MAX_CANDIDATES) {
+        weakest = numSeen++;
+    }
+    seen[weakest].x = x;
+    seen[weakest].y = y;
+    seen[weakest].sightings = 1;
+}
+
+/**
+ * How well the posts agree with the layout rotated by (c, s) and centred on (tx, ty). Each layout
+ * post found counts its sightings up to ZONE_FULL_SIGHTINGS. The average offset from where the
+ * found posts should be is added to (dx, dy) if they aren't 0.
+ */
+static int zone_score(float c, float s, float tx, float ty, int *matched, float *dx, float *dy) {
+    int i, j;
+    int score = 0;
+    float sumX = 0;
+    float sumY = 0;
+
+    *matched = 0;
+    for (i = 0; i < numLayout; i++) {
+        float px = tx + c * layoutX[i] - s * layoutY[i];
+        float py = ty + s * layoutX[i] + c * layoutY[i];
+        int best = -1;
+        float bestD2 = ZONE_INLIER_MM * ZONE_INLIER_MM;
+        for (j = 0; j < numSeen; j++) {
+            float ex = seen[j].x - px;
+            float ey = seen[j].y - py;
+            if (ex * ex + ey * ey < bestD2) {
+                bestD2 = ex * ex + ey * ey;
+                best = j;
+            }
+        }
+        if (best < 0) {
+            continue;
+        }
+        score += seen[best].sightings < ZONE_FULL_SIGHTINGS ? seen[best].sightings : ZONE_FULL_SIGHTINGS;
+        sumX += seen[best].x - px;
+        sumY += seen[best].y - py;
+        (*matched)++;
+    }
+    if (dx && *matched > 0) {
+        *dx += sumX / *matched;
+        *dy += sumY / *matched;
+    }
+    return score;
+}
+
+int zone_fit(const pose_t *now, zone_t *out) {
+    int i, j, k, l;
+    int matched;
+    int bestScore = 0;
+    float bestC = 1;
+    float bestS = 0;
+    float bestX = 0;
+    float bestY = 0;
+    float bestD2 = 0;
+
+    //Every pair of posts seen against every pair in the layout their spacing could be
+    for (i = 0; i < numSeen; i++) {
+        for (j = i + 1; j < numSeen; j++) {
+            float sx = seen[j].x - seen[i].x;
+            float sy = seen[j].y - seen[i].y;
+            float spacing = sqrtf(sx * sx + sy * sy);
+            for (k = 0; k < numLayout; k++) {
+                for (l = 0; l < numLayout; l++) {
+                    if (k == l) {
+                        continue;
+                    }
+                    float lx = layoutX[l] - layoutX[k];
+                    float ly = layoutY[l] - layoutY[k];
+                    if (fabsf(sqrtf(lx * lx + ly * ly) - spacing) > ZONE_PAIR_TOLERANCE_MM) {
+                        continue;
+                    }
+
+                    //Turn the layout so post k to l lines up with i to j, then put k on i
+                    float rot = atan2f(sy, sx) - atan2f(ly, lx);
+                    float c = cosf(rot);
+                    float s = sinf(rot);
+                    float tx = seen[i].x - (c * layoutX[k] - s * layoutY[k]);
+                    float ty = seen[i].y - (s * layoutX[k] + c * layoutY[k]);
+                    int score = zone_score(c, s, tx, ty, &matched, 0, 0);
+
+                    //Too few posts to tell it apart from its mirror image across them, and the zone is on the far
+                    //side of whatever we see of it, or we'd have seen the posts nearer us too
+                    float d2 = (tx - now->x) * (tx - now->x) + (ty - now->y) * (ty - now->y);
+                    if (score > bestScore || (score == bestScore && d2 > bestD2)) {
+                        bestScore = score;
+                        bestD2 = d2;
+                        bestC = c;
+                        bestS = s;
+                        bestX = tx;
+                        bestY = ty;
+                    }
+                }
+            }
+        }
+    }
+
+    if (bestScore == 0) {
+        return 0;
+    }
+
+    //Centre the winner on the posts that agreed with it rather than just the pair that proposed it
+    bestScore = zone_score(bestC, bestS, bestX, bestY, &matched, &bestX, &bestY);
+    if (matched < 2) {
+        return 0;
+    }
+    out->x = bestX;
+    out->y = bestY;
+    out->matched = matched;
+    out->confidence = bestScore * 100 / (numLayout * ZONE_FULL_SIGHTINGS);
+
+    //Drive in square on through whichever side of the layout faces us
+    float toX = now->x - bestX;
+    float toY = now->y - bestY;
+    float nx = bestC;
+    float ny = bestS;
+    int alongX = 1;
+    if (fabsf(-bestS * toX + bestC * toY) > fabsf(bestC * toX + bestS * toY)) {
+        nx = -bestS;
+        ny = bestC;
+        alongX = 0;
+    }
+    if (nx * toX + ny * toY < 0) {
+        nx = -nx;
+        ny = -ny;
+    }
+    float halfDepth = 0;
+    for (i = 0; i < numLayout; i++) {
+        float d = fabsf(alongX ? layoutX[i] : layoutY[i]);
+        if (d > halfDepth) {
+            halfDepth = d;
+        }
+    }
+    out->entryX = bestX + nx * (halfDepth + ZONE_STANDOFF_MM);
+    out->entryY = bestY + ny * (halfDepth + ZONE_STANDOFF_MM);
+    out->entryHeading = atan2f(-ny, -nx);
+    return 1;
+}
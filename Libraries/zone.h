@@ -0,0 +1,79 @@
+/**
+ * Parking zone detector fitting the known post layout
+ * @file zone.h
+ *
+ * Skinny posts seen in each sweep are put on the floor in the odometry frame
+ * and merged with the ones seen before, so a post only glimpsed once doesn't
+ * get forgotten and a one-off false detection never gathers many sightings.
+ *
+ * The zone is then found RANSAC style: every pair of remembered posts whose
+ * spacing matches a pair of posts in the course layout proposes where the
+ * whole layout sits, and the proposal most of the other posts agree with
+ * wins. With at most ZONE_MAX_CANDIDATES posts there are few enough pairs to
+ * try all of them instead of sampling at random. A lone pair fits the layout
+ * either side of it just as well, so ties go to the zone further from the
+ * robot, on the side it can't see yet. The fit gives the zone
+ * centre, the heading to drive in on through the side facing the robot, and
+ * a confidence from how many of the layout's posts were found and how often
+ * they were seen.
+ */
+
+#ifndef ZONE_H_
+#define ZONE_H_
+
+#include <stdint.h>
+#include "odometry.h"
+
+/// Posts remembered across sweeps
+#define ZONE_MAX_CANDIDATES 12
+/// Most posts the layout can have
+#define ZONE_MAX_POSTS 8
+/// Sightings this close are the same post, mm
+#define ZONE_MERGE_MM 150.0f
+/// A pair of posts matches a pair in the layout if their spacings agree this well, mm
+#define ZONE_PAIR_TOLERANCE_MM 100.0f
+/// A post agrees with a proposed layout if it is this close to where one should be, mm
+#define ZONE_INLIER_MM 120.0f
+/// Sightings after which a post is fully trusted
+#define ZONE_FULL_SIGHTINGS 3
+/// How far outside the zone the straight run in starts, mm
+#define ZONE_STANDOFF_MM 350.0f
+
+/// The fitted zone, in the odometry frame
+typedef struct {
+    float x;                // centre, mm
+    float y;
+    float entryX;           // where to line up before driving in, mm
+    float entryY;
+    float entryHeading;     // heading to drive in on, radians
+    int matched;            // layout posts found
+    int confidence;         // 0 to 100
+} zone_t;
+
+/**
+ * @brief Set the layout to look for and forget every post seen so far
+ *
+ * @param postX post x positions in any frame, mm
+ * @param postY post y positions in the same frame, mm
+ * @param numPosts number of posts, at most ZONE_MAX_POSTS
+ */
+void zone_init(const int16_t *postX, const int16_t *postY, int numPosts);
+
+/**
+ * @brief Add a skinny post from a sweep
+ *
+ * @param x post centre in the odometry frame, mm
+ * @param y post centre in the odometry frame, mm
+ */
+void zone_addPost(float x, float y);
+
+/**
+ * @brief Fit the layout to the posts seen so far
+ *
+ * @param now current pose, decides which side of the zone to drive in through
+ * @param out filled with the best fit
+ * @return 1 if at least two posts fit the layout, 0 if there is no fit yet
+ */
+int zone_fit(const pose_t *now, zone_t *out);
+
+#endif /* ZONE_H_ */
@@ -3,6 +3,7 @@
 //
 
 #include "stdio.h"
+#include "string.h"
 #include "Libraries/lcd.h"
 #include "Libraries/Timer.h"
 #include "Libraries/uart-interrupt.h"
@@ -13,11 +14,67 @@
 #include "Libraries/servo.h"
 #include "Libraries/scan.h"
 #include "Libraries/movement.h"
+#include "Libraries/odometry.h"
+#include "Libraries/motion.h"
+#include "Libraries/recovery.h"
+#include "Libraries/speedsched.h"
+#include "Libraries/grid.h"
+#include "Libraries/plan.h"
+#include "Libraries/vfh.h"
+#include "Libraries/scanmatch.h"
+#include "Libraries/ekf.h"
+#include "Libraries/mcl.h"
+#include "Libraries/explore.h"
+#include "Libraries/hsm.h"
+#include "Libraries/gap.h"
+#include "Libraries/zone.h"
+#include "Libraries/boundary.h"
+#include "Libraries/track.h"
+#include "Libraries/scanframe.h"
+#include "Libraries/panorama.h"
+#include "Libraries/lightbump.h"
 
 #define IR_THRESHOLD_VAL 675
-#define LEFT_TURN_OFFSET 0
-#define RIGHT_TURN_OFFSET 0
 #define ROBOT_WIDTH 35
+//Where autonomous mode heads for until it sees the parking zone, the far end of the course straight ahead of the start and short of the tape, mm
+#define EXPLORE_GOAL_MM 3600
+//How many planner nodes along the route we look for a straight line to drive
+#define PLAN_LOOKAHEAD 8
+//How far short of the nearest thing on our heading autonomous moves stop, cm
+#define STOP_SHORT_CM 20
+//Objects up to this wide are compact enough to use as landmarks, cm
+#define LANDMARK_MAX_WIDTH 15
+//The skinny post width findObjects() uses, cm
+#define SKINNY_MAX_WIDTH 9
+//Course localization is trusted once the particles are within this spread, mm
+#define COURSE_LOCALIZED_MM 150
+//Zone fits at least this confident (see zone.h) get the final approach instead of another look
+#define ZONE_CONFIDENT 60
+//Most goals one move is made of
+#define MAX_LEGS 4
+//Samples older than this are left out when a sweep is put together, ms. A little over a full sweep
+#define SWEEP_FRESH_MS 6000
+//A sweep taken on the move is decided from if it puts at least this many of the 91 angles in view of where we stopped
+#define SWEEP_ON_MOVE_ANGLES 86
+//How often the light bumps go into the sweep, the motion controller's tick, ms
+#define NEAR_FIELD_MS 30
+//Manual mode's look ahead sweeps this far either side of straight ahead, degrees
+#define LOOK_AHEAD_DEG 45
+//Before driving into the zone the lane ahead is looked at again this far either side, and each post we expect to
+//pass this far either side of where it should be, degrees
+#define RECHECK_LANE_DEG 20
+#define RECHECK_POST_DEG 8
+
+/*
+ * Events for the state machine. The UART interrupt only sets flags, so the main loop posts an event whenever one of
+ * them changes, and finished moves post EV_MOVE_DONE through goalDone(). A manual mode key press is EV_KEY plus its
+ * movementCode.
+ */
+#define EV_GO 1
+#define EV_STOP 2
+#define EV_MODE 3
+#define EV_MOVE_DONE 4
+#define EV_KEY 16
 
 /*
  * Holds data points from sensor scan.
@@ -27,13 +84,30 @@
  */
 int dataPoints[181][2];
 
+/*
+ * dataPoints[][] with the ranges brought in to whatever the light bumps have seen closer since, for deciding how far
+ * and fast we can go. Objects are only ever found in dataPoints[][], from what PING and IR saw
+ */
+int rangePoints[181][2];
+
 /*
  * Dimension 1 stores object number. Dimension 2 contains angular position of object, distance to object, linear width, and angular width respectively.
  */
 int objects[15][4] = { '\0' };
 
+/*
+ * Servo angles of the right and left edge of each object in objects[][]
+ */
+int objectEdges[15][2];
+
+/*
+ * Tracker ID of each object in objects[][], the same from sweep to sweep for as long as the object stays tracked
+ */
+int objectIds[15];
+
 /**
- * Dimension 1 stores gap number. Dimension 2 contains gap width and angular position of the center of the gap, and the distance to the gap
+ * Dimension 1 stores gap number, best first. Dimension 2 contains gap width across the way we'd approach it and angular
+ * position of the center of the gap, and the distance to the gap
  */
 int gaps[14][3] = {'\0'};
 
@@ -51,6 +125,97 @@ int skinnyPostFound = -1;
 
 int skinnyIndex = 0;
 
+/*
+ * The course as laid out for the run, in mm with the origin at the bottom left corner of the boundary tape and +x
+ * along its long side. Measure the posts around the parking zone and fill them in before a run.
+ */
+const mcl_field_t course = {0, 0, 4270, 2440, 4, {3500, 3900, 3500, 3900}, {1020, 1020, 1420, 1420}};
+
+/*
+ * Roughly where the robot is put down on the course, facing along +x
+ */
+const pose_t courseStart = {.x = 300, .y = 1220, .theta = 0};
+
+/*
+ * 1 once the planner has been pointed at the parking zone from the course layout
+ */
+int zoneGoalSet = 0;
+
+/*
+ * The pose dataPoints[][] was put together as seen from, so later decisions can line the sweep up with where we are now
+ */
+pose_t scanPose;
+
+/*
+ * 1 from when a sweep starts until sweepTick() has put it together
+ */
+int sweepOpen = 0;
+
+/*
+ * When the last autonomous decision was taken. A sweep taken on the move since then that has seen every angle is as
+ * good as stopping for one
+ */
+unsigned int decidedAt = 0;
+
+/*
+ * When the light bumps were last put on the floor
+ */
+unsigned int nearFieldAt = 0;
+
+/*
+ * The goals the current move is made of, run one after another. legIndex is the one running or last run
+ */
+motion_cmd_t legs[MAX_LEGS];
+int numLegs = 0;
+int legIndex = 0;
+
+/*
+ * How the last goal ended, kept by goalDone()
+ */
+motion_result_t lastMove;
+
+/*
+ * Hazard code (see move_reportHazard()) and raw MOTION_* outcome of the goal that sent us into recovery, and how far
+ * recovery backed off from it
+ */
+int hitCode = 0;
+int hitStatus = MOTION_OK;
+int hitBackoff = 0;
+
+/*
+ * 0 while recovery backs off, 1 once it is turning away
+ */
+int recoverTurning = 0;
+
+/*
+ * Where the look all round is up to: 0 first sweep, 1 turning round, 2 second sweep, 3 turning onto the way out
+ */
+int panoStage = 0;
+
+/*
+ * 1 while the move being driven is the final approach into the parking zone
+ */
+int finalApproach = 0;
+
+/*
+ * How far the drive into the zone is, mm, while we square up in front of it. It is only driven once a look at the
+ * way in says it's still clear
+ */
+int zoneDrive = 0;
+
+/*
+ * When the go command came in. How long it takes to find the first post is what exploration is judged on
+ */
+unsigned int searchStart = 0;
+
+/*
+ * Tape and cliff hits this run, and how many of them were on a boundary we had already run into
+ */
+int boundaryHits = 0;
+int boundaryRepeats = 0;
+
+oi_t *robot;
+
 /*
  * Below are some simple functions to clear arrays. They should be self-explanatory
  */
@@ -91,62 +256,122 @@ int getNumSkinnys() {
     return i;
 }
 
-void scanSweep(scanInstance scan) {
-    //Scan Angle Range
-    doScan(0, &scan);
-    timer_waitMillis(1500);
-    int currAngle;
+/*
+ * The sample the sweep in progress last took
+ */
+scanInstance scan;
 
+/**
+ * Start a sweep of just some stretches of the field. It is taken a sample at a time by sweepTick(), so nothing waits
+ * on the servo, and the robot may keep moving. The new samples replace the old ones at their angles and the rest are
+ * kept for SWEEP_FRESH_MS, each where on the floor it was seen
+ * @param regions Stretches to sweep and how finely, see scan_startRegions()
+ * @param count Number of regions
+ */
+void startRegionSweep(const scan_region_t *regions, int count) {
+    sweepOpen = 1;
+    scan_startRegions(regions, count);
     uart_sendStr("!Degrees\t\tPING Distance (cm)\tIR Value\r\n");
+}
 
-    //Make a 180 degree sweep of the field
-    for (currAngle = 0; currAngle <= 180; currAngle += 2) {
-        int i;
-        doScan(currAngle, &scan);
-
-        float pingDist = scan.pingDist;
-        //Read PING distance into data points
-        dataPoints[currAngle][0] = pingDist;
+/**
+ * Start a 180 degree sweep of the field
+ */
+void startSweep(void) {
+    scan_region_t all = {0, 180, 2};
+    startRegionSweep(&all, 1);
+}
 
-        //Read raw IR value into data points
-        int irDist = scan.irRaw;
-        dataPoints[currAngle][1] = irDist;
+/**
+ * Take the next sample of the sweep if it's ready. Once the last one is in, put the sweep together as seen from where
+ * we are now and line it up with the map
+ * @return 1 once the sweep is over, 0 while it's still going
+ */
+int sweepTick(void) {
+    int status = scan_pollSweep(&scan);
+    if (status == SCAN_SAMPLE) {
+        //Each sample goes down where it was seen from, so it doesn't matter if we've moved since
+        frame_add(&scan);
+
+        //Standing still, PING says how far whatever a light bump sees really is
+        if (!motion_isBusy()) {
+            hazard_t haz;
+            hazard_get(&haz);
+            lbump_calibrate(&scan, &haz);
+        }
 
         //Only in we're in manual mode, send the data from each angle scanned to the terminal
         if (manualMode == 1) {
-            //Send the angle we just scanned to putty
-            char angle[4] = {'\0'};
-            sprintf(angle, "%d", currAngle);
-            for (i = 0; i < 4; i++) {
-                uart_sendChar(angle[i]);
-            }
-            uart_sendChar('\t');
-            uart_sendChar('\t');
+            char str[50] = {'\0'};
+            sprintf(str, "%d\t\t%f\t\t\t%d\r\n", scan.angle, scan.pingDist, scan.irRaw);
+            uart_sendStr(str);
+        }
+        return 0;
+    }
+    if (status == SCAN_BUSY) {
+        return 0;
+    }
 
-            //Send the initial ping distance to putty
-            char ping[5] = {'\0'};
+    odom_getPose(&scanPose);
+    frame_project(&scanPose, timer_getMillis() - SWEEP_FRESH_MS, dataPoints);
+    sweepOpen = 0;
+
+    //Line the sweep up with what the map already holds, which also takes out the heading drift from our turns. Not
+    //while a goal is being driven, a correction would move where it ends
+    match_result_t match;
+    if (!motion_isBusy() && match_sweep(dataPoints, &scanPose, &match)) {
+        odom_correct(match.dx, match.dy, match.dtheta, MATCH_XY_VARIANCE, MATCH_THETA_VARIANCE);
+        scanPose.x += match.dx;
+        scanPose.y += match.dy;
+        scanPose.theta = odom_wrapAngle(scanPose.theta + match.dtheta);
+    }
 
-            sprintf(ping, "%f", pingDist);
-            for (i = 0; i < 6; i++) {
-                uart_sendChar(ping[i]);
-            }
-            uart_sendChar('\t');
-            uart_sendChar('\t');
-            uart_sendChar('\t');
+    //Keep what this sweep saw for the next time around
+    grid_addSweep(dataPoints, &scanPose);
+    return 1;
+}
 
-            //Send the IR distance to putty
-            char ir[5] = {'\0'};
+/**
+ * Put whatever the light bumps see on the floor, so deciding where to go knows what's close in front without moving
+ * the servo
+ */
+void senseNearField(void) {
+    hazard_t haz;
+    pose_t now;
+    scanInstance near;
+    int i;
 
-            sprintf(ir, "%d", irDist);
-            for (i = 0; i < 5; i++) {
-                uart_sendChar(ir[i]);
-            }
-            uart_sendChar('\r');
-            uart_sendChar('\n');
+    if ((int)(timer_getMillis() - nearFieldAt) < NEAR_FIELD_MS) {
+        return;
+    }
+    nearFieldAt = timer_getMillis();
+    hazard_get(&haz);
+    odom_getPose(&now);
+    for (i = 0; i < HAZARD_NUM_SECTORS; i++) {
+        if (lbump_toSample(&haz, i, &now, nearFieldAt, &near)) {
+            frame_addNear(&near);
         }
     }
 }
 
+/**
+ * Put rangePoints[][] together from dataPoints[][] and what the light bumps have seen lately, both as seen from
+ * scanPose
+ */
+void mergeNearField(void) {
+    memcpy(rangePoints, dataPoints, sizeof(rangePoints));
+    frame_mergeNear(&scanPose, timer_getMillis() - SWEEP_FRESH_MS, rangePoints);
+}
+
+/**
+ * The edges of an object in objects[][] as the gap solver wants them
+ */
+void toGapObject(int i, gap_object_t *out) {
+    out->startDeg = objectEdges[i][0];
+    out->endDeg = objectEdges[i][1];
+    out->dist_cm = objects[i][1];
+}
+
 /**
  * Find objects from the most recent scan, given a raw IR threshold value
  */
@@ -155,7 +380,6 @@ int findObjects(scanInstance scan, oi_t *robot) {
     clearSkinny();
     skinnyIndex = 0;
     int objectStartDeg, objectEndDeg, angularWidth;
-    double arcLength;
     int i, j;
     double sum = 0;
     int objNum = 0;
@@ -194,13 +418,16 @@ int findObjects(scanInstance scan, oi_t *robot) {
             angularWidth = objectEndDeg - objectStartDeg;
             objects[objNum][3] = angularWidth;
 
-            //Find linear width using arc length as a pretty reasonable approximation. We could find chord length using arc len for an exact reading if arc len is not good enough
-            int radius = objects[objNum][1];
-            arcLength = 2.0 * M_PI * (double)radius * ((double)angularWidth / 360.0);
-            objects[objNum][2] = (int)arcLength;
+            //The edges fall halfway between the last sample on the object and the first one off it either side
+            objectEdges[objNum][0] = objectStartDeg - 1;
+            objectEdges[objNum][1] = objectEndDeg - 1;
+            //Linear width is the straight line between the edges, not the arc around them
+            gap_object_t edges;
+            toGapObject(objNum, &edges);
+            objects[objNum][2] = gap_objectWidth(&edges);
 
             //If we've detected a skinny object, then assign it an angular position and a distance from robot
-            if(objects[objNum][2] <= 9) {
+            if(objects[objNum][2] <= SKINNY_MAX_WIDTH) {
                 skinnyObjects[skinnyIndex][0] = objAngPos;
                 skinnyObjects[skinnyIndex][1] = pingDistToObj;
                 skinnyIndex++;
@@ -211,6 +438,42 @@ int findObjects(scanInstance scan, oi_t *robot) {
         }
     }
 
+    //Add whatever the light bumps see right now that the sweep didn't. They can't tell how wide it is, so it goes in
+    //too wide to be taken for a post or a landmark
+    hazard_t haz;
+    hazard_get(&haz);
+    int sweepObjs = objNum;
+    for (i = 0; i < HAZARD_NUM_SECTORS && objNum < 15; i++) {
+        float d = lbump_range(&haz, i);
+        if (d < 0) {
+            continue;
+        }
+        int angle = 90 + lbump_bearing(i);
+        int dist = (int)((LBUMP_RADIUS_MM + d) / 10.0f);
+        int seen = 0;
+        for (j = 0; j < sweepObjs; j++) {
+            if (angle >= objectEdges[j][0] && angle <= objectEdges[j][1] && objects[j][1] - dist < 10 && dist - objects[j][1] < 10) {
+                seen = 1;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+
+        objects[objNum][0] = angle;
+        objects[objNum][1] = dist;
+        objects[objNum][3] = 2 * LBUMP_HALF_BEAM_DEG;
+        objectEdges[objNum][0] = angle - LBUMP_HALF_BEAM_DEG;
+        objectEdges[objNum][1] = angle + LBUMP_HALF_BEAM_DEG;
+        gap_object_t edges;
+        toGapObject(objNum, &edges);
+        objects[objNum][2] = gap_objectWidth(&edges);
+        if (objects[objNum][2] <= LANDMARK_MAX_WIDTH) {
+            objects[objNum][2] = LANDMARK_MAX_WIDTH + 1;
+        }
+        objNum++;
+    }
+
     //Send out info to putty regarding the detected objects
     char angle[4] = { '\0' };
     char irDist[5] = { '\0' };
@@ -251,48 +514,32 @@ int findObjects(scanInstance scan, oi_t *robot) {
 }
 
 /**
- * Given an objects[][] array, find gaps in the objects as well as the positions, and widths
- * **HIGHLY EXPERIMENTAL**
+ * Given an objects[][] array, find the gaps between neighbouring objects the robot fits through, widest margin first
  * @param numObjs How many objects are contained within the array from the current scan
  * @return An int corresponding to the number of gaps found
  */
 int findGaps(int numObjs) {
-    clearGaps();
+    gap_object_t edges[15];
+    gap_t found[GAP_MAX];
     int i;
-    uart_sendStr("Gap angle\tDist to gap\tGap lin width\r\n");
-    for(i = 0; i < numObjs - 1; i++) {
-        //Angular position to center of gap
-        gaps[i][1] = (objects[i][0] + objects[i + 1][0]) / 2;
-
-        //Angular width of gap
-        int angularWidthGap = objects[i + 1][0] - objects[i][0];
 
-        //Distance to gap
-        int distToSmallestObj;
-        //We use the distance to the closer object to gauge the width of gap
-        if (objects[i][1] > objects[i + 1][1]) {
-            distToSmallestObj = objects[i + 1][1];
-            gaps[i][2] = distToSmallestObj;
-        } else {
-            distToSmallestObj = objects[i][1];
-            gaps[i][2] = distToSmallestObj;
-        }
+    clearGaps();
+    for (i = 0; i < numObjs; i++) {
+        toGapObject(i, &edges[i]);
+    }
+    int numGaps = gap_solve(edges, numObjs, ROBOT_WIDTH, found);
 
-        //Linear width of gap
-        if (angularWidthGap < 90) {
-            gaps[i][0] = distToSmallestObj * angularWidthGap * (M_PI / 180);
-        }
-        else {
-            gaps[i][0] = distToSmallestObj * angularWidthGap * (M_PI / 180);
-        }
-        uart_sendStr("\r\n");
+    uart_sendStr("Gap angle\tDist to gap\tGap lin width\tMargin\r\n");
+    for (i = 0; i < numGaps; i++) {
+        gaps[i][0] = found[i].corridor_cm;
+        gaps[i][1] = found[i].bearing + 90;
+        gaps[i][2] = found[i].distance_cm;
 
         char str[50] = {'\0'};
-        sprintf(str, "%d\t\t%d\t\t%d\r\n", gaps[i][1], distToSmallestObj, gaps[i][0]);
+        sprintf(str, "%d\t\t%d\t\t%d\t\t%d\r\n", gaps[i][1], gaps[i][2], gaps[i][0], found[i].margin_cm);
         uart_sendStr(str);
     }
-
-    return i;
+    return numGaps;
 }
 
 /**
@@ -326,267 +573,1055 @@ int findClosestGap(int numGaps) {
 }
 
 /**
- * Main function containing autonomous and manual control
- * **PLEASE NOTE:**
- * We demoed in full manual mode because autonomous just wasn't there in terms of polish.
- * Autonomous code was still present but just not utilized.
+ * Set the cruise speed for the next move from how much room the last sweep showed along its bearing
+ * @param bearing Degrees from our current heading the move will head off in, positive is left
  */
-void main() {
-    timer_init();
-    lcd_init();
-    adc_init();
-    button_init();
-    ping_init();
-    servo_init();
-    uart_interrupt_init();
+void scheduleSpeed(int bearing) {
+    pose_t now;
+    hazard_t haz;
+    odom_getPose(&now);
+    hazard_get(&haz);
+    mergeNearField();
+    motion_setMaxSpeed(speed_schedule(rangePoints, &scanPose, &now, bearing, &haz));
+}
 
-    //Servo calibration actions, uncomment when doing new robot
-    //Current for CYBOT 8
-    //servo_calibrate();
-    set_left(35700);
-    set_right(8300);
+/**
+ * Find the next straight leg of the planned route to the goal, so gaps the map already knows lead nowhere
+ * get passed over
+ * @param bearing Set to the leg's heading in degrees from our current heading, positive is left
+ * @param distance_mm Set to the leg's length
+ * @return 1 if the map has a route, 0 if it doesn't and bearing and distance_mm were left alone
+ */
+int planLeg(int *bearing, int *distance_mm) {
+    pose_t now;
+    plan_path_t path;
+    float wx, wy;
+
+    odom_getPose(&now);
+    plan_refreshCosts();
+    if (plan_dstarReplan(now.x, now.y, &path) != PLAN_OK || path.length < 2) {
+        return 0;
+    }
 
-    //Create an open interface object
-    oi_t *robot = oi_alloc();
-    //Initialize it
-    oi_init(robot);
+    //Aim for the furthest point along the route we can reach in a straight line
+    plan_nodeToWorld(path.node[plan_farthestVisible(&path, PLAN_LOOKAHEAD)], &wx, &wy);
+    float dx = wx - now.x;
+    float dy = wy - now.y;
+    int dist = (int)sqrtf(dx * dx + dy * dy);
+    if (dist < PLAN_CELL_MM) {
+        return 0;
+    }
+
+    *bearing = (int)(odom_wrapAngle(atan2f(dy, dx) - now.theta) * (180.0 / M_PI));
+    *distance_mm = dist;
+    return 1;
+}
 
-    scanInstance scan;
+/**
+ * Hand the compact objects from the last findObjects() to the landmark filter, then move odometry onto its estimate
+ * @param numObjs Number of objects in objects[][]
+ */
+void updateLandmarks(int numObjs) {
+    pose_t now;
+    pose_t raw;
+    int i;
 
-    char display[21];
-    int isAvoiding = 0;
-    int moveStatus = -1;
+    odom_getPose(&now);
+    odom_getRawPose(&raw);
+    ekf_predict(&now);
+    mcl_predict(&raw);
+    for (i = 0; i < numObjs; i++) {
+        if (objects[i][1] <= 0 || objects[i][2] > LANDMARK_MAX_WIDTH) {
+            continue;
+        }
+        //PING measures to the near face, the landmark is the object's centre
+        float range = (objects[i][1] + objects[i][2] / 2.0f) * 10.0f;
+        float bearing = (objects[i][0] - 90) * (M_PI / 180.0);
+        ekf_observe(range, bearing, objects[i][2] <= SKINNY_MAX_WIDTH);
+        //The posts are the only thing in the sweep the course layout knows about
+        if (objects[i][2] <= SKINNY_MAX_WIDTH) {
+            mcl_observePost(range, bearing);
+        }
+    }
+    ekf_applyToOdometry();
+    mcl_update();
+
+    //The robot hasn't moved since the sweep was put together, so it is seen from the corrected pose
+    odom_getPose(&scanPose);
+
+    //Every post goes towards the zone fit, from wherever in the run it was seen
+    for (i = 0; i < numObjs; i++) {
+        if (objects[i][1] > 0 && objects[i][2] <= SKINNY_MAX_WIDTH) {
+            float range = (objects[i][1] + objects[i][2] / 2.0f) * 10.0f;
+            float heading = scanPose.theta + (objects[i][0] - 90) * (M_PI / 180.0);
+            zone_addPost(scanPose.x + range * cosf(heading), scanPose.y + range * sinf(heading));
+        }
+    }
+}
+
+/**
+ * Tie the objects from the last findObjects() to the ones seen in earlier sweeps, and list them over UART by ID
+ * @param numObjs Number of objects in objects[][]
+ */
+void trackObjects(int numObjs) {
+    int i;
+    track_update(&scanPose, dataPoints, objects, numObjs, objectIds);
+    for (i = 0; i < numObjs; i++) {
+        char str[50] = {'\0'};
+        sprintf(str, "!OBJECT #%d AT %d deg, %d cm\r\n", objectIds[i], objects[i][0], objects[i][1]);
+        uart_sendStr(str);
+    }
+}
+
+/**
+ * Where the parking zone is, from the skinny posts the landmark filter remembers
+ * @param x Set to the middle of the known posts in mm
+ * @param y Set to the middle of the known posts in mm
+ * @return 1 if any posts are remembered, 0 if not
+ */
+int rememberedZone(float *x, float *y) {
+    ekf_landmark_t landmark;
+    int i;
+    int posts = 0;
+
+    *x = 0;
+    *y = 0;
+    for (i = 0; i < ekf_numLandmarks(); i++) {
+        if (ekf_getLandmark(i, &landmark) && landmark.isPost) {
+            *x += landmark.x;
+            *y += landmark.y;
+            posts++;
+        }
+    }
+    if (posts == 0) {
+        return 0;
+    }
+    *x /= posts;
+    *y /= posts;
+    return 1;
+}
+
+/**
+ * Once we know where we are on the course, point the planner at the parking zone instead of just exploring
+ */
+void aimForZone(void) {
+    mcl_estimate_t est;
+    pose_t now;
+    int i;
+    float zoneX = 0;
+    float zoneY = 0;
+
+    mcl_getEstimate(&est);
+    if (zoneGoalSet || course.numPosts == 0 || est.pose.cov[0][0] + est.pose.cov[1][1] > COURSE_LOCALIZED_MM * COURSE_LOCALIZED_MM) {
+        return;
+    }
+    for (i = 0; i < course.numPosts; i++) {
+        zoneX += course.postX[i];
+        zoneY += course.postY[i];
+    }
+    zoneX = zoneX / course.numPosts - est.pose.x;
+    zoneY = zoneY / course.numPosts - est.pose.y;
+
+    //Carry the zone's offset from us on the course over into the odometry frame
+    odom_getPose(&now);
+    float rot = now.theta - est.pose.theta;
+    float c = cosf(rot);
+    float s = sinf(rot);
+    if (plan_dstarSetGoal(now.x + c * zoneX - s * zoneY, now.y + s * zoneX + c * zoneY) == PLAN_OK) {
+        uart_sendStr("!LOCALIZED ON COURSE, HEADING FOR ZONE\r\n");
+        zoneGoalSet = 1;
+    }
+}
 
-    while (!goCmd) {};  //busywait on the command to go from the uart controller
+/**
+ * Until we know where the zone is, point the planner at whichever frontier of the map looks most worth the trip
+ */
+void chooseFrontier(void) {
+    pose_t now;
+    float gx, gy;
+
+    odom_getPose(&now);
+    plan_refreshCosts();
+    if (explore_update(&now, &gx, &gy) == EXPLORE_NEW) {
+        plan_dstarSetGoal(gx, gy);
+    }
+}
+
+
+/**
+ * Remember where a goal ran into tape or a cliff so nothing plans or steers over it again
+ * @param status MOTION_* outcome of the goal
+ */
+void recordBoundary(int status) {
+    pose_t now;
+    char str[50] = {'\0'};
+    if (status != MOTION_BOUND_LEFT && status != MOTION_BOUND_RIGHT && status != MOTION_CLIFF_LEFT && status != MOTION_CLIFF_RIGHT) {
+        return;
+    }
+
+    odom_getPose(&now);
+    int isCliff = status == MOTION_CLIFF_LEFT || status == MOTION_CLIFF_RIGHT;
+    boundaryHits++;
+    if (boundary_addHit(&now, status == MOTION_BOUND_LEFT || status == MOTION_CLIFF_LEFT, isCliff)) {
+        boundaryRepeats++;
+    }
+    sprintf(str, "!BOUNDARY HIT %d, %d ON KNOWN ONES\r\n", boundaryHits, boundaryRepeats);
+    uart_sendStr(str);
+}
+
+/**
+ * Completion callback for every goal started by startLeg(). Runs from motion_poll() in the main loop
+ */
+void goalDone(const motion_result_t *result) {
+    lastMove = *result;
+    hsm_post(EV_MOVE_DONE);
+}
+
+void clearLegs(void) {
+    numLegs = 0;
+    legIndex = 0;
+}
+
+/**
+ * Add a goal to the end of the move being put together
+ */
+void addLeg(motion_mode_t type, int distance_mm, float degrees) {
+    motion_cmd_t leg = {type, distance_mm, degrees, goalDone};
+    if (numLegs < MAX_LEGS) {
+        legs[numLegs++] = leg;
+    }
+}
+
+/**
+ * Add the goals that curve onto a point at the given bearing (degrees, positive is left) and distance
+ */
+void addArcTo(int bearing, int distance_mm) {
+    if (numLegs <= MAX_LEGS - 2) {
+        numLegs += move_arcToLegs(bearing, distance_mm, goalDone, &legs[numLegs]);
+    }
+}
+
+/**
+ * Start one of the move's goals without waiting for it, replacing whatever the robot was doing
+ */
+void startLeg(int i) {
+    char str[50] = {'\0'};
+    const motion_cmd_t *leg = &legs[i];
+
+    legIndex = i;
+    if (leg->type == MOTION_DRIVE && leg->distance_mm < 0) {
+        sprintf(str, "!GOING BACKWARD %d cm\r\n", -leg->distance_mm / 10);
+    }
+    else if (leg->type == MOTION_DRIVE) {
+        sprintf(str, "!GOING FORWARD %d cm\r\n", leg->distance_mm / 10);
+    }
+    else if (leg->type == MOTION_TURN) {
+        sprintf(str, "!TURNING %s %d degrees\r\n", leg->degrees > 0 ? "LEFT" : "RIGHT", (int)leg->degrees);
+    }
+    else {
+        sprintf(str, "!ARCING %d degrees over %d cm\r\n", (int)leg->degrees, leg->distance_mm / 10);
+    }
+    uart_sendStr(str);
+    motion_start(leg);
+}
+
+/**
+ * Start a manual mode move, replacing whatever the robot was doing
+ */
+void startManualMove(motion_mode_t type, int distance_mm, float degrees) {
+    clearLegs();
+    addLeg(type, distance_mm, degrees);
+    //The operator is driving by eye, so keep to the usual speed
+    motion_setMaxSpeed(MOTION_DRIVE_SPEED);
+    startLeg(0);
+}
+
+/*
+ * The control states. Every handler returns straight away; anything that takes time is a goal handed to the motion
+ * controller or a sweep taken a sample per tick, so a stop or a mode change is acted on the next time around the
+ * main loop.
+ *
+ *  waiting                 until the go command
+ *  running                 stop and mode changes for everything below
+ *      autonomous
+ *          sweep           finish the sweep, then decide where to go
+ *          drive           run the goals of the chosen move, sweeping on the way
+ *          recheck         squared up in front of the zone, look down the way in once more before driving it
+ *          recover         back off and turn away from whatever a move ran into
+ *          panorama        boxed in: sweep, turn round, sweep again and pick a way out of the lot
+ *          parked          in the zone, waiting for the stop command
+ *      manual              one move per key press
+ *          manualSweep     key 5, a sweep reported over UART
+ *          manualLook      key 9, the same for just what's ahead
+ *  done                    stopped for good
+ */
+extern const hsm_state_t waitingState;
+extern const hsm_state_t runningState;
+extern const hsm_state_t autoState;
+extern const hsm_state_t sweepState;
+extern const hsm_state_t driveState;
+extern const hsm_state_t recheckState;
+extern const hsm_state_t recoverState;
+extern const hsm_state_t panoramaState;
+extern const hsm_state_t parkedState;
+extern const hsm_state_t manualState;
+extern const hsm_state_t manualSweepState;
+extern const hsm_state_t manualLookState;
+extern const hsm_state_t doneState;
+
+int waitingEvent(int event) {
+    if (event != EV_GO) {
+        return 0;
+    }
     uart_sendStr("!STARTING SEQUENCE\r\n");
+    searchStart = timer_getMillis();
+    hsm_transition(&runningState);
+    return 1;
+}
 
-    //Print the table header for the initial sweep of the field
-
-    #pragma clang diagnostic push
-    #pragma ide diagnostic ignored "EndlessLoop"
-        //Repeatedly scan, find objects, and move forward accordingly. If bump sensors are triggered, stop, back
-        //up, and turn, but don't move forward. Repeat sequence and essentially bounce around testing area until
-        //cliff sensors pick up blue tape that mark the end zone, which will then trigger the parking sequence
-    while (1) {
-        //removed skinnyPostFound == -1
-        while (goCmd && !manualMode) {
-            int numGaps = 0;
-            int closestGap = -1;
-            int distToGap = -1;
-            int gapAngPos = -1;
-
-            //Do initial scan
-            scanSweep(scan);
-            int numObjs = findObjects(scan, robot);
-            //Realize that this condition never gets checked if we have skinnyPostFound == -1 as the outer while condition
-            if (skinnyPostFound != -1) {
-                uart_sendStr("!PARKING SEQUENCE INITIATED\r\n");
-                break;
-            }
+void runningEntry(void) {
+    hsm_transition(manualMode ? &manualState : &autoState);
+}
 
-            //Special cases if there's no gaps to go
-            if (numObjs == 0) {
-                moveStatus = move_forward(robot, 350);
-            }
-            //If there's only one object just go towards it
-            else if (numObjs == 1) {
-                if (objects[0][0] <= 90) {
-                    turnRightAngle(robot, -30);
-                } else {
-                    turnLeftAngle(robot, 30);
-                }
-                moveStatus = move_forward(robot, 350);
-            }
-            //We have several objects so go towards the closest gap
-            else if (numObjs > 1) {
-                numGaps = findGaps(numObjs);
-                closestGap = findClosestGap(numGaps);
-
-                gapAngPos = gaps[closestGap][1];
-                gapAngPos = gapAngPos - 90;
-                if (gapAngPos > 0) {
-                    turnLeftAngle(robot, gapAngPos);
-                }
-                else if (gapAngPos < 0 ) {
-                    turnRightAngle(robot, gapAngPos);
-                }
+void runningTick(void) {
+    senseNearField();
+}
 
-                distToGap = gaps[closestGap][2];
-                //Check to make sure we fit thru the gap
-                if (gaps[closestGap][0] >= 35) {
-                    moveStatus = move_forward(robot, (distToGap + 10) * 10);
-                }
-                //If not then we move forward a little bit and scan again
-                else {
-                    move_forward(robot, 100);
+int runningEvent(int event) {
+    if (event == EV_STOP) {
+        hsm_transition(&doneState);
+        return 1;
+    }
+    if (event == EV_MODE) {
+        if (manualMode && !hsm_isIn(&manualState)) {
+            hsm_transition(&manualState);
+        }
+        else if (!manualMode && !hsm_isIn(&autoState)) {
+            hsm_transition(&autoState);
+        }
+        return 1;
+    }
+    //Nothing else matters to a state that didn't take it, e.g. manual keys while autonomous
+    return 1;
+}
+
+void autoEntry(void) {
+    uart_sendStr("!ENTERING AUTONOMOUS MODE\r\n");
+}
+
+void autoExit(void) {
+    motion_cancel();
+    scan_stopSweep();
+    sweepOpen = 0;
+    clearLegs();
+}
+
+/**
+ * Until a skinny post turns up, head for the goal the planner has, steering round whatever this sweep shows
+ */
+void chooseSearchMove(void) {
+    if (!zoneGoalSet) {
+        chooseFrontier();
+    }
+
+    //The map's route to the goal says where we'd like to go, this sweep says where we can
+    int targetBearing = 0;
+    int legDist = 350;
+    vfh_result_t steer;
+    //A frontier we can't find a way to isn't worth sitting on
+    if (!planLeg(&targetBearing, &legDist) && !zoneGoalSet) {
+        explore_giveUp();
+    }
+
+    mergeNearField();
+    if (vfh_steer(rangePoints, targetBearing, ROBOT_WIDTH, &steer)) {
+        //Stop a little short of whatever is down that heading
+        int dist = (steer.clearance_cm - STOP_SHORT_CM) * 10;
+        if (dist > legDist) {
+            dist = legDist;
+        }
+        if (dist < 100) {
+            dist = 100;
+        }
+        scheduleSpeed(steer.bearing);
+        addArcTo(steer.bearing, dist);
+    }
+    //Boxed in on this side, turn and look somewhere else
+    else {
+        addLeg(MOTION_TURN, 0, 90);
+    }
+}
+
+/**
+ * Parking: if we see skinny objects, they are logged into the skinnyObjects array. If we have 1, go towards the
+ * object. If we have 2 then shoot the gap
+ * @param numObjs Number of objects in objects[][]
+ */
+void chooseParkingMove(int numObjs) {
+    int howManySkinny = getNumSkinnys();
+    float zoneX, zoneY;
+
+    //If we lose sight of the destination head back to where we remember it, and only if we don't
+    //remember one return to normal mode
+    if (howManySkinny == 0) {
+        if (!rememberedZone(&zoneX, &zoneY)) {
+            skinnyPostFound = -1;
+            return;
+        }
+        pose_t now;
+        odom_getPose(&now);
+        float dx = zoneX - now.x;
+        float dy = zoneY - now.y;
+        int turnAng = (int)(odom_wrapAngle(atan2f(dy, dx) - now.theta) * (180.0 / M_PI));
+        scheduleSpeed(turnAng);
+        addArcTo(turnAng, (int)sqrtf(dx * dx + dy * dy));
+    }
+    //If 1 skinny then go towards it
+    else if (howManySkinny == 1) {
+        int turnAng = skinnyObjects[0][0] - 90;
+        scheduleSpeed(turnAng);
+        addArcTo(turnAng, skinnyObjects[0][1] * 10);
+    }
+    //If more than 1 skinny, go between the first (rightmost) and the last (leftmost)
+    else {
+        gap_object_t right, left;
+        gap_t gap;
+        int i;
+        int first = -1;
+        int last = -1;
+
+        for (i = 0; i < numObjs; i++) {
+            if (objects[i][2] <= SKINNY_MAX_WIDTH) {
+                if (first < 0) {
+                    first = i;
                 }
+                last = i;
             }
+        }
+        toGapObject(first, &right);
+        toGapObject(last, &left);
+        gap_measure(&right, &left, ROBOT_WIDTH, &gap);
 
-            //Code for object avoidance after the above actions are taken
-            if (moveStatus == 1) {
-                turnRightAngle(robot, -90);
-            }
-            else if (moveStatus == 2) {
-                turnLeftAngle(robot, 90);
-            }
-                //We have a left side cliff detection
-            else if (moveStatus == 4) {
-                turnRightAngle(robot, -90);
-            }
-                //We have a right side cliff detection
-            else if (moveStatus == 5) {
-                turnLeftAngle(robot, 90);
-            }
+        //Aim for the middle of the gap between the posts' near edges, not just the angle between their centres
+        scheduleSpeed(gap.bearing);
+        addArcTo(gap.bearing, gap.distance_cm * 10);
+    }
+}
+
+/**
+ * Once the post layout fits the posts we've seen well enough, plan the way in: onto the line in front of the zone and
+ * square up, leaving the drive to the centre in zoneDrive until the recheck has looked down it
+ * @return 1 if the approach was planned, 0 if the fit isn't good enough yet
+ */
+int planZoneApproach(void) {
+    pose_t now;
+    zone_t zone;
+    char str[50] = {'\0'};
+
+    odom_getPose(&now);
+    if (!zone_fit(&now, &zone) || zone.confidence < ZONE_CONFIDENT) {
+        return 0;
+    }
+    sprintf(str, "!ZONE FOUND, %d POSTS, %d%% SURE\r\n", zone.matched, zone.confidence);
+    uart_sendStr(str);
+
+    float dx = zone.entryX - now.x;
+    float dy = zone.entryY - now.y;
+    int bearing = (int)(odom_wrapAngle(atan2f(dy, dx) - now.theta) * (180.0 / M_PI));
+    float heading = now.theta;
+    if (dx * dx + dy * dy > (float)PLAN_CELL_MM * PLAN_CELL_MM) {
+        scheduleSpeed(bearing);
+        addArcTo(bearing, (int)sqrtf(dx * dx + dy * dy));
+        //An arc onto a point ends up turned by twice its bearing, wide ones turn the part past ARC_MAX_BEARING on the spot
+        int arcPart = bearing > ARC_MAX_BEARING ? ARC_MAX_BEARING : bearing < -ARC_MAX_BEARING ? -ARC_MAX_BEARING : bearing;
+        heading += (bearing + arcPart) * (M_PI / 180.0);
+    }
+
+    int square = (int)(odom_wrapAngle(zone.entryHeading - heading) * (180.0 / M_PI));
+    if (square != 0) {
+        addLeg(MOTION_TURN, 0, square);
+    }
+    dx = zone.x - zone.entryX;
+    dy = zone.y - zone.entryY;
+    zoneDrive = (int)sqrtf(dx * dx + dy * dy);
+    return 1;
+}
+
+/**
+ * Whether anything other than a post sits in the lane the robot would sweep out driving straight ahead
+ * @param numObjs Number of objects in objects[][]
+ * @param distance_mm Length of the lane
+ */
+int laneBlocked(int numObjs, int distance_mm) {
+    int i;
+    for (i = 0; i < numObjs; i++) {
+        if (objects[i][1] <= 0 || objects[i][2] <= SKINNY_MAX_WIDTH) {
+            continue;
+        }
+        float bearing = (objects[i][0] - 90) * (M_PI / 180.0);
+        float along = objects[i][1] * 10.0f * cosf(bearing);
+        float across = objects[i][1] * 10.0f * sinf(bearing);
+        //Its near edge, not its centre, has to stay out of the way
+        float halfWidth = ROBOT_WIDTH * 5.0f + objects[i][2] * 5.0f;
+        if (along > 0 && along < distance_mm && across < halfWidth && across > -halfWidth) {
+            return 1;
         }
+    }
+    return 0;
+}
 
-        /*
-         * This is manual mode, which we used to complete the demo
-         */
-        while (goCmd && manualMode) {
-            if (manualMode == 0) {
-                uart_sendStr("!ENTERING AUTONOMOUS MODE\r\n");
-                break;
-            }
-            //Forward
-            if (movementCode == 1) {
-                move_forward(robot, 100);
-                movementCode = 0;
-            }
-            //Backward
-            else if (movementCode == 2) {
-                //do a jank backwards thing spin around, move forward, then spin back to avoid holes
-                turnLeftAngle(robot, 180 + LEFT_TURN_OFFSET);
-                move_forward(robot, 100);
-                turnRightAngle(robot, -180 + RIGHT_TURN_OFFSET);
-                movementCode = 0;
+void autoSweepTick(void) {
+    if (!sweepTick()) {
+        return;
+    }
 
-            }
-            //Left a little
-            else if (movementCode == 3) {
-                turnLeftAngle(robot, 10 + LEFT_TURN_OFFSET);
-                movementCode = 0;
-            }
-            //Right a little
-            else if (movementCode == 4) {
-                turnRightAngle(robot, -10 + RIGHT_TURN_OFFSET);
-                movementCode = 0;
-            }
-            //Scan
-            else if (movementCode == 5) {
-                scanSweep(scan);
-                int numObjects = findObjects(scan, robot);
-                findGaps(numObjects);
-                movementCode = 0;
-            }
-            //Left 90
-            else if(movementCode == 6) {
-                turnLeftAngle(robot, 90 + LEFT_TURN_OFFSET);
-                movementCode = 0;
-            }
-            //Right 90
-            else if(movementCode == 7) {
-                turnRightAngle(robot, -90 + RIGHT_TURN_OFFSET);
-                movementCode = 0;
-            }
-            //Turn around
-            else if(movementCode == 8) {
-                turnLeftAngle(robot, 180 + LEFT_TURN_OFFSET);
-                movementCode = 0;
-            }
+    int parking = skinnyPostFound != -1;
+    //Steering works off the raw sweep, but this is still what spots the skinny posts around the zone
+    int numObjs = findObjects(scan, robot);
+    updateLandmarks(numObjs);
+    trackObjects(numObjs);
+    //Steering, speed and recovery all read the sweep, so cut it short at the boundaries we know of
+    boundary_applyToSweep(dataPoints, &scanPose);
+    clearLegs();
+    finalApproach = 0;
+    zoneDrive = 0;
+    if (parking) {
+        if (!planZoneApproach()) {
+            chooseParkingMove(numObjs);
+        }
+    }
+    else {
+        aimForZone();
+        if (skinnyPostFound != -1) {
+            char str[50] = {'\0'};
+            sprintf(str, "!FIRST POST AFTER %u ms\r\n", timer_getMillis() - searchStart);
+            uart_sendStr(str);
+            uart_sendStr("!PARKING SEQUENCE INITIATED\r\n");
+        }
+        else {
+            chooseSearchMove();
+        }
+    }
+
+    decidedAt = timer_getMillis();
+    //Nothing to drive means sweep again, e.g. to take a fresh look once parking has started
+    if (numLegs > 0) {
+        hsm_transition(&driveState);
+    }
+    else {
+        hsm_transition(zoneDrive > 0 ? &recheckState : &sweepState);
+    }
+}
 
+/**
+ * Squared up in front of the zone: sweep the lane in and the posts either side of it, not the whole field
+ */
+void recheckEntry(void) {
+    scan_region_t regions[SCAN_MAX_REGIONS];
+    pose_t now;
+    track_t t;
+    int angle, dist;
+    int i;
+    int n = 0;
+
+    //All the lane has to show is whether it's empty, so every other sample will do
+    scan_region_t lane = {90 - RECHECK_LANE_DEG, 90 + RECHECK_LANE_DEG, 4};
+    regions[n++] = lane;
+
+    //The tracker says where the posts we're about to pass between should be, take those finely
+    odom_getPose(&now);
+    for (i = 0; i < track_count() && n < SCAN_MAX_REGIONS; i++) {
+        if (track_get(i, &t) && t.width_cm <= SKINNY_MAX_WIDTH && track_predict(&t, &now, &angle, &dist) &&
+            dist * 10.0f < TRACK_VISIBLE_MM) {
+            scan_region_t post = {angle - RECHECK_POST_DEG, angle + RECHECK_POST_DEG, 2};
+            regions[n++] = post;
         }
+    }
+    startRegionSweep(regions, n);
+}
 
-        //removed skinnyPostFound != -1
-        //Our parking zone detected logic
-        //We encountered major issues getting this to work, which is the primary reason we did not do autonomous for the demo
-        while (goCmd && skinnyPostFound) {
-            //Start by running a scan. If we see skinny objects, they will be logged into the skinnyObjects array.
-            //Go through that and see how many we have. If we have 1, go towards the object. If we have 2 then shoot the gap
-            scanSweep(scan);
-            int numObjs = findObjects(scan, robot);
-            int howManySkinny = getNumSkinnys();
-            //If we for some reason lose sight of the destination then return to normal mode
-            if (howManySkinny == 0) {
-                skinnyPostFound = -1;
-                break;
-            }
-            //If 1 skinny then go towards it
-            else if (howManySkinny == 1) {
-                int turnAng = skinnyObjects[0][0] - 90;
-                if (turnAng > 0) {
-                    turnLeftAngle(robot, turnAng);
-                }
-                else if (turnAng < 0) {
-                    turnRightAngle(robot, turnAng);
-                }
+/**
+ * Once the recheck is in, drive into the zone, through the middle of the posts if both sides showed up. Anything new
+ * in the way sends us back for a full look
+ */
+void recheckTick(void) {
+    if (!sweepTick()) {
+        return;
+    }
 
-                moveStatus = move_forward(robot, skinnyObjects[0][1] * 10);
+    int numObjs = findObjects(scan, robot);
+    trackObjects(numObjs);
+    boundary_applyToSweep(dataPoints, &scanPose);
+    clearLegs();
+    if (laneBlocked(numObjs, zoneDrive)) {
+        uart_sendStr("!ZONE ENTRY BLOCKED, LOOKING AGAIN\r\n");
+        zoneDrive = 0;
+        hsm_transition(&sweepState);
+        return;
+    }
 
-                //Code for object avoidance after the above actions are taken
-                if (moveStatus == 1) {
-                    turnRightAngle(robot, -90);
-                }
-                else if (moveStatus == 2) {
-                    turnLeftAngle(robot, 90);
-                }
-                    //We have a left side cliff detection
-                else if (moveStatus == 4) {
-                    turnRightAngle(robot, -90);
-                }
-                    //We have a right side cliff detection
-                else if (moveStatus == 5) {
-                    turnLeftAngle(robot, 90);
-                }
+    //With a post either side, aim through the middle of the gap as it is now rather than as the zone fit put it
+    int first = -1;
+    int last = -1;
+    int i;
+    for (i = 0; i < numObjs; i++) {
+        if (objects[i][1] > 0 && objects[i][2] <= SKINNY_MAX_WIDTH) {
+            if (first < 0) {
+                first = i;
             }
-            //If more than 1 skinny, go between the first (rightmost) and the last (leftmost)
-            else {
-                int gapAng = skinnyObjects[skinnyIndex - 1][0] - skinnyObjects[0][0];
-                int gapDist;
+            last = i;
+        }
+    }
+    int bearing = 0;
+    if (first >= 0 && objects[first][0] < 90 && objects[last][0] > 90) {
+        gap_object_t right, left;
+        gap_t gap;
+        toGapObject(first, &right);
+        toGapObject(last, &left);
+        gap_measure(&right, &left, ROBOT_WIDTH, &gap);
+        if (gap.margin_cm >= 0 && gap.bearing >= -RECHECK_LANE_DEG && gap.bearing <= RECHECK_LANE_DEG) {
+            bearing = gap.bearing;
+        }
+    }
 
-                if (skinnyObjects[skinnyIndex - 1][1] > skinnyObjects[0][0]) {
-                    gapDist = skinnyObjects[skinnyIndex - 1][1];
-                }
-                else {
-                    gapDist = skinnyObjects[0][0];
-                }
+    scheduleSpeed(bearing);
+    if (bearing != 0) {
+        addArcTo(bearing, zoneDrive);
+    }
+    else {
+        addLeg(MOTION_DRIVE, zoneDrive, 0);
+    }
+    zoneDrive = 0;
+    finalApproach = 1;
+    hsm_transition(&driveState);
+}
 
-                if (gapAng > 0) {
-                    turnLeftAngle(robot, gapAng);
-                }
-                else if (gapAng < 0) {
-                    turnRightAngle(robot, gapAng);
-                }
+/**
+ * Decide straight away if a sweep taken on the way here has seen all round in front of us since the last decision.
+ * Otherwise finish the sweep the drive was taking, standing still, or start one
+ */
+void sweepEntry(void) {
+    pose_t now;
+    odom_getPose(&now);
+    //Counted as seen from here, a turn on the way can leave much of what was swept behind us
+    if (frame_project(&now, decidedAt, dataPoints) >= SWEEP_ON_MOVE_ANGLES) {
+        scan_stopSweep();
+        sweepOpen = 1;
+    }
+    else if (!sweepOpen) {
+        startSweep();
+    }
+}
 
-                moveStatus = move_forward(robot, gapDist);
+void driveEntry(void) {
+    startLeg(0);
+}
 
-                //Code for object avoidance after the above actions are taken
-                if (moveStatus == 1) {
-                    turnRightAngle(robot, -90);
-                }
-                else if (moveStatus == 2) {
-                    turnLeftAngle(robot, 90);
-                }
-                    //We have a left side cliff detection
-                else if (moveStatus == 4) {
-                    turnRightAngle(robot, -90);
-                }
-                    //We have a right side cliff detection
-                else if (moveStatus == 5) {
-                    turnLeftAngle(robot, 90);
-                }
-                //TODO ADD AVOIDANCE LOGIC IN PARKING MODE
+/**
+ * Keep sweeping while moving, so the next decision may not have to stop for a look
+ */
+void driveTick(void) {
+    if (!sweepOpen || sweepTick()) {
+        startSweep();
+    }
+}
+
+int driveEvent(int event) {
+    if (event != EV_MOVE_DONE) {
+        return 0;
+    }
+    //Left over from a goal that was replaced, the one we're waiting on is still going
+    if (motion_isBusy()) {
+        return 1;
+    }
+
+    hitCode = move_reportHazard(lastMove.status);
+    if (hitCode) {
+        hsm_transition(&recoverState);
+    }
+    else if (legIndex + 1 < numLegs) {
+        startLeg(legIndex + 1);
+    }
+    else if (zoneDrive > 0) {
+        hsm_transition(&recheckState);
+    }
+    else {
+        hsm_transition(finalApproach ? &parkedState : &sweepState);
+    }
+    return 1;
+}
+
+/**
+ * Second half of recovery: turn away from the hazard, using what the sweeps and light bumps have seen lately to pick
+ * the most open direction on the far side
+ */
+void recoverTurn(void) {
+    pose_t now;
+    odom_getPose(&now);
+
+    //Boundary tape tells the course localizer we're on an edge
+    if (hitStatus == MOTION_BOUND_LEFT || hitStatus == MOTION_BOUND_RIGHT) {
+        pose_t raw;
+        odom_getRawPose(&raw);
+        mcl_predict(&raw);
+        mcl_observeTape(hitStatus == MOTION_BOUND_LEFT, hitBackoff);
+        mcl_update();
+    }
+
+    //Rather than the last sweep, which may be from before the move, put together what has been seen since from here,
+    //the light bumps included
+    frame_project(&now, timer_getMillis() - SWEEP_FRESH_MS, dataPoints);
+    scanPose = now;
+    boundary_applyToSweep(dataPoints, &scanPose);
+
+    //Codes 1 (bump) and 4 (tape or cliff) are on the left, 2 and 5 on the right
+    mergeNearField();
+    int turn = recovery_chooseTurn(hitCode == 1 || hitCode == 4, rangePoints, 0);
+
+    recoverTurning = 1;
+    clearLegs();
+    //Nothing in front has room, look behind us too before choosing
+    if (turn == 0) {
+        hsm_transition(&panoramaState);
+        return;
+    }
+    addLeg(MOTION_TURN, 0, turn);
+    startLeg(0);
+}
+
+/**
+ * One place for every move's obstacle handling: back off only as far as recovery_backoff() asks, retracing an arc
+ * along itself, then turn away
+ */
+void recoverEntry(void) {
+    motion_mode_t hitType = legs[legIndex].type;
+
+    //Only back off far enough to turn clear, never more than we came
+    int backoff = recovery_backoff(lastMove.status);
+    if (backoff > lastMove.travelled) {
+        backoff = (int)lastMove.travelled;
+    }
+    hitStatus = lastMove.status;
+    hitBackoff = backoff > 0 ? backoff : 0;
+    recordBoundary(hitStatus);
+    recoverTurning = 0;
+    clearLegs();
+
+    if (backoff <= 0) {
+        recoverTurn();
+        return;
+    }
+    if (hitType == MOTION_ARC) {
+        addLeg(MOTION_ARC, -backoff, -lastMove.turned * backoff / lastMove.travelled);
+    }
+    else {
+        addLeg(MOTION_DRIVE, -backoff, 0);
+    }
+    startLeg(0);
+}
+
+int recoverEvent(int event) {
+    if (event != EV_MOVE_DONE) {
+        return 0;
+    }
+    if (motion_isBusy()) {
+        return 1;
+    }
+
+    if (!recoverTurning) {
+        recoverTurn();
+    }
+    else {
+        hsm_transition(&sweepState);
+    }
+    return 1;
+}
+
+/**
+ * Boxed in: sweep, turn round on the spot and sweep again, stitching the two together with the turn odometry measured
+ */
+void panoramaEntry(void) {
+    pose_t now;
+    odom_getPose(&now);
+    pano_clear(&now);
+    panoStage = 0;
+    uart_sendStr("!BOXED IN, LOOKING ALL ROUND\r\n");
+    startSweep();
+}
+
+void panoramaTick(void) {
+    char str[50] = {'\0'};
+    if ((panoStage != 0 && panoStage != 2) || !sweepTick()) {
+        return;
+    }
+
+    pano_addSweep(dataPoints, &scanPose);
+    clearLegs();
+    if (panoStage == 0) {
+        addLeg(MOTION_TURN, 0, 180);
+    }
+    else {
+        pose_t ref;
+        pano_getReference(&ref);
+        float turned = odom_wrapAngle(scanPose.theta - ref.theta) * (180.0 / M_PI);
+        //Codes 1 (bump) and 4 (tape or cliff) are on the left
+        int turn = recovery_choosePanoramaTurn(hitCode == 1 || hitCode == 4, turned);
+        sprintf(str, "!TURNED %d, WAY OUT %d FROM HERE\r\n", (int)turned, turn);
+        uart_sendStr(str);
+        if (turn == 0) {
+            hsm_transition(&sweepState);
+            return;
+        }
+        addLeg(MOTION_TURN, 0, turn);
+    }
+    panoStage++;
+    startLeg(0);
+}
+
+int panoramaEvent(int event) {
+    if (event != EV_MOVE_DONE) {
+        return 0;
+    }
+    if (motion_isBusy()) {
+        return 1;
+    }
+
+    int hazard = move_reportHazard(lastMove.status);
+    if (hazard) {
+        hitCode = hazard;
+        hsm_transition(&recoverState);
+    }
+    else if (panoStage == 1) {
+        panoStage = 2;
+        startSweep();
+    }
+    else {
+        hsm_transition(&sweepState);
+    }
+    return 1;
+}
+
+void parkedEntry(void) {
+    char str[50] = {'\0'};
+    sprintf(str, "!PARKED AFTER %u ms\r\n", timer_getMillis() - searchStart);
+    uart_sendStr(str);
+}
+
+/*
+ * This is manual mode, which we used to complete the demo
+ */
+void manualEntry(void) {
+    uart_sendStr("!ENTERING MANUAL MODE\r\n");
+    clearLegs();
+}
+
+void manualExit(void) {
+    motion_cancel();
+    clearLegs();
+}
+
+int manualEvent(int event) {
+    char str[50] = {'\0'};
+
+    if (event == EV_MOVE_DONE) {
+        if (!motion_isBusy()) {
+            move_reportHazard(lastMove.status);
+            recordBoundary(lastMove.status);
+            sprintf(str, "!MOVED %d cm, TURNED %d degrees\r\n", (int)lastMove.travelled / 10, (int)lastMove.turned);
+            uart_sendStr(str);
+            if (legIndex + 1 < numLegs) {
+                startLeg(legIndex + 1);
             }
         }
+        return 1;
+    }
+    if (event < EV_KEY) {
+        return 0;
+    }
+
+    //A key press takes over from a sweep in progress
+    if (hsm_current() != &manualState) {
+        hsm_transition(&manualState);
+    }
 
-        //Emergency stop/program completed procedure
-        if (goCmd == 0) {
-            oi_setWheels(0, 0);
-            lcd_printf("Program exited/\nDestination found");
-            uart_sendStr("Exit/Destination found");
-            oi_free(robot);
+    //Moves don't block, so the next key press takes over straight away
+    switch (event - EV_KEY) {
+        //Forward
+        case 1:
+            startManualMove(MOTION_DRIVE, 100, 0);
+            break;
+        //Backward
+        case 2:
+            //do a jank backwards thing spin around, move forward, then spin back to avoid holes
+            clearLegs();
+            addLeg(MOTION_TURN, 0, 180);
+            addLeg(MOTION_DRIVE, 100, 0);
+            addLeg(MOTION_TURN, 0, -180);
+            motion_setMaxSpeed(MOTION_DRIVE_SPEED);
+            startLeg(0);
+            break;
+        //Left a little
+        case 3:
+            startManualMove(MOTION_TURN, 0, 10);
+            break;
+        //Right a little
+        case 4:
+            startManualMove(MOTION_TURN, 0, -10);
+            break;
+        //Scan
+        case 5:
+            hsm_transition(&manualSweepState);
+            break;
+        //Left 90
+        case 6:
+            startManualMove(MOTION_TURN, 0, 90);
+            break;
+        //Right 90
+        case 7:
+            startManualMove(MOTION_TURN, 0, -90);
+            break;
+        //Turn around
+        case 8:
+            startManualMove(MOTION_TURN, 0, 180);
+            break;
+        //Scan just what's ahead
+        case 9:
+            hsm_transition(&manualLookState);
             break;
+        default:
+            break;
+    }
+    return 1;
+}
+
+void manualSweepEntry(void) {
+    //Hold still while the servo sweeps
+    motion_cancel();
+    clearLegs();
+    startSweep();
+}
+
+void manualLookEntry(void) {
+    scan_region_t ahead = {90 - LOOK_AHEAD_DEG, 90 + LOOK_AHEAD_DEG, 2};
+    motion_cancel();
+    clearLegs();
+    startRegionSweep(&ahead, 1);
+}
+
+void manualSweepTick(void) {
+    if (sweepTick()) {
+        int numObjects = findObjects(scan, robot);
+        trackObjects(numObjects);
+        findGaps(numObjects);
+        hsm_transition(&manualState);
+    }
+}
+
+/*
+ * Emergency stop/program completed procedure
+ */
+void doneEntry(void) {
+    motion_close();
+    lcd_printf("Program exited/\nDestination found");
+    uart_sendStr("Exit/Destination found");
+}
+
+const hsm_state_t waitingState = {"waiting", 0, 0, 0, 0, 0, waitingEvent};
+const hsm_state_t runningState = {"running", 0, 0, runningEntry, 0, runningTick, runningEvent};
+const hsm_state_t autoState = {"autonomous", &runningState, &sweepState, autoEntry, autoExit, 0, 0};
+const hsm_state_t sweepState = {"sweep", &autoState, 0, sweepEntry, 0, autoSweepTick, 0};
+const hsm_state_t driveState = {"drive", &autoState, 0, driveEntry, 0, driveTick, driveEvent};
+const hsm_state_t recheckState = {"recheck", &autoState, 0, recheckEntry, 0, recheckTick, 0};
+const hsm_state_t recoverState = {"recover", &autoState, 0, recoverEntry, 0, driveTick, recoverEvent};
+const hsm_state_t panoramaState = {"panorama", &autoState, 0, panoramaEntry, 0, panoramaTick, panoramaEvent};
+const hsm_state_t parkedState = {"parked", &autoState, 0, parkedEntry, 0, 0, 0};
+const hsm_state_t manualState = {"manual", &runningState, 0, manualEntry, manualExit, 0, manualEvent};
+const hsm_state_t manualSweepState = {"manualSweep", &manualState, 0, manualSweepEntry, 0, manualSweepTick, 0};
+const hsm_state_t manualLookState = {"manualLook", &manualState, 0, manualLookEntry, 0, manualSweepTick, 0};
+const hsm_state_t doneState = {"done", 0, 0, doneEntry, 0, 0, 0};
+
+/**
+ * Main function containing autonomous and manual control
+ * **PLEASE NOTE:**
+ * We demoed in full manual mode because autonomous just wasn't there in terms of polish.
+ * Autonomous code was still present but just not utilized.
+ */
+void main() {
+    timer_init();
+    lcd_init();
+    adc_init();
+    button_init();
+    ping_init();
+    servo_init();
+    uart_interrupt_init();
+
+    //Servo calibration actions, uncomment when doing new robot
+    //Current for CYBOT 8
+    //servo_calibrate();
+    set_left(35700);
+    set_right(8300);
+
+    //Create an open interface object
+    robot = oi_alloc();
+    //Initialize it
+    oi_init(robot);
+    //Start dead reckoning from wherever we were placed on the field
+    odom_reset(0, 0, 0);
+    //The map is anchored to the same origin
+    grid_clear();
+    plan_dstarSetGoal(EXPLORE_GOAL_MM, 0);
+    pose_t startPose;
+    pose_t rawStart;
+    odom_getPose(&startPose);
+    odom_getRawPose(&rawStart);
+    ekf_init(&startPose);
+    mcl_initAround(&course, &rawStart, &courseStart, 250, 0.3);
+    zone_init(course.postX, course.postY, course.numPosts);
+    boundary_clear();
+    track_clear();
+    frame_clear();
+    //From here on the motion controller's interrupt owns the OI link
+    motion_init(robot);
+
+    int lastGo = 0;
+    int lastManual = manualMode;
+    const hsm_state_t *shown = 0;
+
+    //Scan, find objects and move accordingly, backing off and turning away from anything we run into, until the
+    //skinny posts around the parking zone turn up and the parking moves take over
+    hsm_start(&waitingState);
+    while (!hsm_isIn(&doneState)) {
+        //Whatever the robot is in the middle of, the UART commands are looked at every time around
+        if (goCmd != lastGo) {
+            lastGo = goCmd;
+            hsm_post(goCmd ? EV_GO : EV_STOP);
+        }
+        if (manualMode != lastManual) {
+            lastManual = manualMode;
+            hsm_post(EV_MODE);
+        }
+        //Taken and cleared with the UART interrupt held off, or a key arriving in between is lost. It starts out at
+        //-1, which isn't a key
+        bool wasDisabled = IntMasterDisable();
+        int key = movementCode;
+        movementCode = 0;
+        if (!wasDisabled) {
+            IntMasterEnable();
+        }
+        if (key > 0) {
+            hsm_post(EV_KEY + key);
+        }
+
+        //Hands any finished goal to goalDone()
+        motion_poll(0);
+        hsm_run();
+
+        if (hsm_current() != shown) {
+            char str[50] = {'\0'};
+            shown = hsm_current();
+            sprintf(str, "!STATE %s\r\n", shown->name);
+            uart_sendStr(str);
         }
     }
     oi_free(robot);
 }
-#pragma clang diagnostic pop
@@ -0,0 +1,36 @@
+/**
+ * Minimal assertions and timing for the host harnesses
+ * @file check.h
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+#include <time.h>
+
+static int checkFailures = 0;
+
+/// Report a failed condition with where it was and carry on with the rest of the harness
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            checkFailures++; \
+        } \
+    } while (0)
+
+/// Print the outcome and give the exit status for main() to return
+#define CHECK_DONE() (printf("%s: %s\n", __FILE__, checkFailures ? "FAILED" : "ok"), checkFailures != 0)
+
+/**
+ * Wall clock in microseconds, for rough host timings only. The robot runs a
+ * far slower core, so these say how the cost scales rather than what it is there.
+ */
+static inline double check_micros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+#endif /* CHECK_H_ */
@@ -0,0 +1,18 @@
+/**
+ * Host stand-in for the TivaWare interrupt API
+ * @file interrupt.h
+ *
+ * Only what the Libraries modules under test call. There are no interrupts on
+ * the host, so masking them is a no-op.
+ */
+
+#ifndef INTERRUPT_H_
+#define INTERRUPT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool IntMasterEnable(void);
+bool IntMasterDisable(void);
+
+#endif /* INTERRUPT_H_ */
@@ -0,0 +1,14 @@
+/**
+ * Host stand-in for the TivaWare interrupt API
+ * @file interrupt.c
+ */
+
+#include "driverlib/interrupt.h"
+
+bool IntMasterEnable(void) {
+    return false;
+}
+
+bool IntMasterDisable(void) {
+    return false;
+}
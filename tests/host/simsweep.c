@@ -0,0 +1,47 @@
+/**
+ * Simulated PING sweeps for the host harnesses
+ * @file simsweep.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "simsweep.h"
+
+static const float (*world)[4];
+static int numWalls;
+
+void sim_setWorld(const float (*walls)[4], int count) {
+    world = walls;
+    numWalls = count;
+}
+
+float sim_castRay(float x, float y, float heading) {
+    int i;
+    float best = SIM_NO_ECHO_CM * 10.0f;
+    float dx = cosf(heading);
+    float dy = sinf(heading);
+    for (i = 0; i < numWalls; i++) {
+        float ex = world[i][2] - world[i][0];
+        float ey = world[i][3] - world[i][1];
+        float den = dx * ey - dy * ex;
+        if (fabsf(den) < 1e-6f) {
+            continue;
+        }
+        float wx = world[i][0] - x;
+        float wy = world[i][1] - y;
+        float t = (wx * ey - wy * ex) / den;
+        float u = (wx * dy - wy * dx) / den;
+        if (t > 0 && u >= 0 && u <= 1 && t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+void sim_sweep(const pose_t *truth, int scan[181][2]) {
+    int a;
+    memset(scan, 0, sizeof(int) * 181 * 2);
+    for (a = 0; a <= 180; a += 2) {
+        scan[a][0] = (int)(sim_castRay(truth->x, truth->y, truth->theta + (a - 90) * DEG_TO_RAD) / 10.0f + 0.5f);
+    }
+}
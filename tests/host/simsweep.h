@@ -0,0 +1,41 @@
+/**
+ * Simulated PING sweeps for the host harnesses
+ * @file simsweep.h
+ *
+ * The world is a list of wall segments. A sweep casts a ray on every even
+ * servo angle, the way scanSweep() samples PING, and reports the distance to
+ * the nearest wall in whole cm.
+ */
+
+#ifndef SIMSWEEP_H_
+#define SIMSWEEP_H_
+
+#include "odometry.h"
+
+/// Reported when a ray hits nothing, well past what the grid trusts, cm
+#define SIM_NO_ECHO_CM 400
+
+/**
+ * @brief Set the walls later sweeps are cast into
+ *
+ * @param walls segments as {x0, y0, x1, y1} in mm, must outlive the sweeps
+ * @param count number of segments
+ */
+void sim_setWorld(const float (*walls)[4], int count);
+
+/**
+ * @brief Distance along a ray to the nearest wall
+ *
+ * @return mm, SIM_NO_ECHO_CM * 10 if nothing is in the way
+ */
+float sim_castRay(float x, float y, float heading);
+
+/**
+ * @brief Fill a sweep taken from the given pose, 0 on odd angles
+ *
+ * @param truth where the robot really is
+ * @param scan filled as scanSweep() would, scan[a][0] is PING distance in cm
+ */
+void sim_sweep(const pose_t *truth, int scan[181][2]);
+
+#endif /* SIMSWEEP_H_ */
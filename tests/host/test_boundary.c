@@ -0,0 +1,226 @@
+/**
+ * Host harness for the boundary map
+ * @file test_boundary.c
+ *
+ * Hits are put down by working back from where the cliff sensor should be to
+ * the pose that puts it there, so each case knows exactly which stretch of
+ * tape was run into. The last case drives a simulated robot around the
+ * course rectangle on random legs, once ignoring what it has learned and
+ * once keeping every leg short of the boundaries it knows, and checks that
+ * running into known tape again gets much rarer, the goal Parking.c only
+ * reports over UART.
+ */
+
+#include <math.h>
+#include "check.h"
+#include "boundary.h"
+
+/// The tape rectangle as Parking.c has it, mm
+#define COURSE_X 4270.0f
+#define COURSE_Y 2440.0f
+
+/// Half the robot's width, for lanes, and how far short of a known boundary a leg stops, mm
+#define ROBOT_HALF_MM 175.0f
+#define STOP_SHORT_MM 60.0f
+
+static float wrap(float a) {
+    while (a > M_PI) {
+        a -= 2 * M_PI;
+    }
+    while (a < -M_PI) {
+        a += 2 * M_PI;
+    }
+    return a;
+}
+
+/**
+ * Record a hit by the given cliff sensor at (x, y), seen heading theta
+ */
+static int hitAt(float x, float y, float theta, int leftSide, int isCliff) {
+    float c = cosf(theta);
+    float s = sinf(theta);
+    float side = leftSide ? BOUNDARY_SENSOR_SIDE_MM : -BOUNDARY_SENSOR_SIDE_MM;
+    pose_t pose = {.x = x - (c * BOUNDARY_SENSOR_FWD_MM - s * side), .y = y - (s * BOUNDARY_SENSOR_FWD_MM + c * side),
+                   .theta = theta};
+    return boundary_addHit(&pose, leftSide, isCliff);
+}
+
+/**
+ * Furthest any point of the segment is from the line y = slope * x + offset
+ */
+static float offLine(const boundary_segment_t *seg, float slope, float offset) {
+    float n = sqrtf(1 + slope * slope);
+    float d0 = fabsf(seg->y0 - slope * seg->x0 - offset) / n;
+    float d1 = fabsf(seg->y1 - slope * seg->x1 - offset) / n;
+    return d0 > d1 ? d0 : d1;
+}
+
+static void testMerge(void) {
+    boundary_segment_t seg;
+    boundary_clear();
+    CHECK(boundary_count() == 0);
+    uint32_t v = boundary_version();
+
+    //Tape along y = 1000, run into head on at points 300mm apart
+    CHECK(!hitAt(0, 1000, M_PI / 2, 1, 0));
+    CHECK(boundary_version() != v);
+    CHECK(!hitAt(300, 1000, M_PI / 2, 0, 0));
+    CHECK(!hitAt(600, 1000, M_PI / 2, 1, 0));
+    CHECK(boundary_count() == 1);
+
+    //Inside the stretch already known it's a repeat, past its end but close enough it extends it
+    CHECK(hitAt(350, 1020, M_PI / 2, 1, 0));
+    CHECK(!hitAt(1000, 1000, M_PI / 2, 1, 0));
+    CHECK(boundary_count() == 1);
+    boundary_get(0, &seg);
+    CHECK(seg.hits == 5);
+    CHECK(!seg.isCliff);
+    CHECK(offLine(&seg, 0, 1000) < 20.0f);
+    CHECK(fminf(seg.x0, seg.x1) < -BOUNDARY_HIT_HALF_MM + 20.0f);
+    CHECK(fmaxf(seg.x0, seg.x1) > 1000 + BOUNDARY_HIT_HALF_MM - 20.0f);
+
+    //A cliff in the same place is a different boundary, so is tape well off the line or well past its end
+    hitAt(300, 1000, M_PI / 2, 0, 1);
+    hitAt(300, 1500, M_PI / 2, 0, 0);
+    hitAt(2500, 1000, M_PI / 2, 0, 0);
+    CHECK(boundary_count() == 4);
+    CHECK(boundary_get(3, &seg) && !boundary_get(4, &seg));
+    boundary_get(0, &seg);
+    printf("  merging: %d segments, first from %.0f to %.0f\n", boundary_count(), seg.x0, seg.x1);
+}
+
+static void testFit(void) {
+    boundary_segment_t seg;
+    int i;
+    boundary_clear();
+
+    //A lone hit is taken to run across the way we were going, here 30 degrees off the tape's own direction
+    float slope = 0.4f;
+    float heading = atanf(slope) + M_PI / 2 - 30 * (M_PI / 180);
+    hitAt(0, 1000, heading, 1, 0);
+    boundary_get(0, &seg);
+    float dir = atan2f(seg.y1 - seg.y0, seg.x1 - seg.x0);
+    CHECK(fabsf(wrap(2 * (dir - (heading + M_PI / 2)))) < 0.01f);
+
+    //Once the hits spread out along the tape its direction comes from them
+    for (i = 1; i < 5; i++) {
+        float x = i * 200.0f;
+        hitAt(x, 1000 + slope * x, heading, i & 1, 0);
+    }
+    CHECK(boundary_count() == 1);
+    boundary_get(0, &seg);
+    dir = atan2f(seg.y1 - seg.y0, seg.x1 - seg.x0);
+    //A line's direction either way is the same line, so compare doubled angles
+    CHECK(fabsf(wrap(2 * (dir - atanf(slope)))) < 0.02f);
+    CHECK(offLine(&seg, slope, 1000) < 15.0f);
+    printf("  fit: %.1f degrees for tape at %.1f\n", dir * (180 / M_PI), atanf(slope) * (180 / M_PI));
+}
+
+static void testClearance(void) {
+    boundary_clear();
+    //Tape along y = 1000 from about x = -150 to 1050
+    hitAt(0, 1000, M_PI / 2, 1, 0);
+    hitAt(450, 1000, M_PI / 2, 1, 0);
+    hitAt(900, 1000, M_PI / 2, 1, 0);
+    CHECK(boundary_count() == 1);
+    float d;
+
+    //Straight at it from 1m short, then at 45 degrees where the left edge of the lane meets it first
+    d = boundary_clearance(450, 0, M_PI / 2, ROBOT_HALF_MM, 3000);
+    CHECK(fabsf(d - 1000) < 5.0f);
+    d = boundary_clearance(0, 0, M_PI / 4, ROBOT_HALF_MM, 3000);
+    CHECK(fabsf(d - (1000 * sqrtf(2) - ROBOT_HALF_MM)) < 5.0f);
+
+    //Away from it, or past its end with the lane just clear
+    CHECK(boundary_clearance(450, 0, -M_PI / 2, ROBOT_HALF_MM, 3000) == 3000);
+    CHECK(boundary_clearance(-150 - ROBOT_HALF_MM - 30, 0, M_PI / 2, ROBOT_HALF_MM, 3000) == 3000);
+    //The lane's edge just catching its end is enough
+    d = boundary_clearance(-150 - ROBOT_HALF_MM + 30, 0, M_PI / 2, ROBOT_HALF_MM, 3000);
+    CHECK(fabsf(d - 1000) < 5.0f);
+
+    //Running along beside it, within the lane already
+    CHECK(boundary_clearance(450, 900, 0, ROBOT_HALF_MM, 3000) == 0);
+    //Out of reach
+    CHECK(boundary_clearance(450, 0, M_PI / 2, ROBOT_HALF_MM, 800) == 800);
+    printf("  clearance: %.0fmm head on\n", boundary_clearance(450, 0, M_PI / 2, ROBOT_HALF_MM, 3000));
+}
+
+static uint32_t rng = 1;
+
+static float randf(void) {
+    rng = rng * 1103515245u + 12345u;
+    return ((rng >> 8) & 0xFFFF) / 65536.0f;
+}
+
+static int outside(float x, float y) {
+    return x < 0 || x > COURSE_X || y < 0 || y > COURSE_Y;
+}
+
+/**
+ * Drive the given number of random legs around the course, from the middle. Hits on tape already known are counted
+ * in repeats
+ * @return tape hits
+ */
+static int wander(int useMap, int legs, int *repeats) {
+    int i;
+    int hits = 0;
+    float x = COURSE_X / 2;
+    float y = COURSE_Y / 2;
+
+    boundary_clear();
+    rng = 7;
+    *repeats = 0;
+    for (i = 0; i < legs; i++) {
+        float theta = (randf() * 2 - 1) * M_PI;
+        float c = cosf(theta);
+        float s = sinf(theta);
+        float len = 600 + 1200 * randf();
+        if (useMap) {
+            float room = boundary_clearance(x, y, theta, ROBOT_HALF_MM, len + BOUNDARY_SENSOR_FWD_MM + STOP_SHORT_MM);
+            room -= BOUNDARY_SENSOR_FWD_MM + STOP_SHORT_MM;
+            len = room < len ? room : len;
+        }
+
+        //Drive until a cliff sensor is over the tape
+        float moved;
+        for (moved = 0; moved < len; moved += 10) {
+            float fx = x + c * BOUNDARY_SENSOR_FWD_MM;
+            float fy = y + s * BOUNDARY_SENSOR_FWD_MM;
+            int left = outside(fx - s * BOUNDARY_SENSOR_SIDE_MM, fy + c * BOUNDARY_SENSOR_SIDE_MM);
+            int right = outside(fx + s * BOUNDARY_SENSOR_SIDE_MM, fy - c * BOUNDARY_SENSOR_SIDE_MM);
+            if (left || right) {
+                pose_t pose = {.x = x, .y = y, .theta = theta};
+                hits++;
+                *repeats += boundary_addHit(&pose, left, 0);
+                //Back away from it
+                x -= c * 200;
+                y -= s * 200;
+                break;
+            }
+            x += c * 10;
+            y += s * 10;
+        }
+    }
+    return hits;
+}
+
+static void testRepeatsDrop(void) {
+    int blindRepeats, mapRepeats;
+    int blind = wander(0, 200, &blindRepeats);
+    int mapped = wander(1, 200, &mapRepeats);
+
+    //Blind, the robot keeps finding the same tape. Keeping off what it knows, it mostly only finds new stretches
+    CHECK(blindRepeats > blind / 2);
+    CHECK(mapRepeats * 4 < blindRepeats);
+    CHECK(mapped < blind);
+    printf("  200 random legs: %d tape hits, %d on known tape blind; %d and %d keeping off it\n", blind, blindRepeats,
+           mapped, mapRepeats);
+}
+
+int main(void) {
+    testMerge();
+    testFit();
+    testClearance();
+    testRepeatsDrop();
+    return CHECK_DONE();
+}
@@ -0,0 +1,152 @@
+/**
+ * Host harness for frontier exploration
+ * @file test_explore.c
+ *
+ * A simulated robot is put down at the start of the course, in the odometry
+ * frame, with the room's walls, a couple of boxes and the four zone posts
+ * around it. It sweeps, lets the explorer pick a frontier and is moved
+ * straight there, until the explorer runs out of frontiers worth the trip.
+ */
+
+#include <math.h>
+#include "check.h"
+#include "explore.h"
+#include "grid.h"
+#include "plan.h"
+#include "simsweep.h"
+
+#define MAX_SWEEPS 40
+
+/// Course corners in the odometry frame, where Parking.c's layout puts them from the start pose
+#define COURSE_MIN_X (-300.0f)
+#define COURSE_MAX_X 3970.0f
+#define COURSE_HALF_Y 1220.0f
+
+/// Room walls well outside the tape, two boxes on the course and the posts, line segments in mm
+static const float walls[][4] = {
+    {-500, -1500, 4200, -1500},
+    {4200, -1500, 4200, 1500},
+    {4200, 1500, -500, 1500},
+    {-500, 1500, -500, -1500},
+    {1200, -700, 1500, -700},
+    {1500, -700, 1500, -300},
+    {1500, -300, 1200, -300},
+    {1200, -300, 1200, -700},
+    {2200, 400, 2500, 400},
+    {2500, 400, 2500, 800},
+    {2500, 800, 2200, 800},
+    {2200, 800, 2200, 400},
+    {3180, -220, 3220, -180},
+    {3580, -220, 3620, -180},
+    {3180, 180, 3220, 220},
+    {3580, 180, 3620, 220},
+};
+#define NUM_WALLS ((int)(sizeof(walls) / sizeof(walls[0])))
+
+/**
+ * Fraction of the map cells inside the tape that are no longer unknown
+ */
+static float courseCovered(void) {
+    int cx, cy, x0, y0, x1, y1;
+    int known = 0;
+    int total = 0;
+    grid_worldToCell(COURSE_MIN_X, -COURSE_HALF_Y, &x0, &y0);
+    grid_worldToCell(COURSE_MAX_X, COURSE_HALF_Y, &x1, &y1);
+    for (cy = y0; cy <= y1; cy++) {
+        for (cx = x0; cx <= x1; cx++) {
+            known += grid_get(cx, cy) != 0;
+            total++;
+        }
+    }
+    return (float)known / total;
+}
+
+/**
+ * 1 if a post would show up in a sweep from here, within PING range and in front
+ */
+static int postInView(const pose_t *p) {
+    int i;
+    for (i = NUM_WALLS - 4; i < NUM_WALLS; i++) {
+        float dx = (walls[i][0] + walls[i][2]) * 0.5f - p->x;
+        float dy = (walls[i][1] + walls[i][3]) * 0.5f - p->y;
+        float bearing = atan2f(dy, dx) - p->theta;
+        while (bearing > 3.14159265f) {
+            bearing -= 2 * 3.14159265f;
+        }
+        while (bearing < -3.14159265f) {
+            bearing += 2 * 3.14159265f;
+        }
+        if (dx * dx + dy * dy < (GRID_MAX_RANGE_CM * 10.0f) * (GRID_MAX_RANGE_CM * 10.0f) && fabsf(bearing) < 90 * DEG_TO_RAD) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void sweepFrom(const pose_t *p) {
+    int scan[181][2];
+    sim_sweep(p, scan);
+    grid_addSweep(scan, p);
+    plan_refreshCosts();
+}
+
+int main(void) {
+    pose_t robot = {.x = 0, .y = 0, .theta = 0};
+    float gx, gy;
+    int sweeps = 0;
+    int firstPost = -1;
+    int outcome;
+    double us = 0;
+
+    sim_setWorld(walls, NUM_WALLS);
+
+    //Nothing seen yet, so nothing borders on anything
+    grid_clear();
+    plan_refreshCosts();
+    CHECK(explore_update(&robot, &gx, &gy) == EXPLORE_NONE);
+
+    //The first sweep gives a goal, and until it is reached the explorer sticks with it
+    sweepFrom(&robot);
+    sweeps++;
+    CHECK(explore_update(&robot, &gx, &gy) == EXPLORE_NEW);
+    float firstX = gx;
+    float firstY = gy;
+    CHECK(explore_update(&robot, &gx, &gy) == EXPLORE_SAME);
+    CHECK(gx == firstX && gy == firstY);
+
+    //A goal given up on isn't picked again
+    explore_giveUp();
+    CHECK(explore_update(&robot, &gx, &gy) == EXPLORE_NEW);
+    CHECK(gx != firstX || gy != firstY);
+
+    //Sweep, go to the frontier, repeat
+    while (sweeps < MAX_SWEEPS) {
+        double t0 = check_micros();
+        outcome = explore_update(&robot, &gx, &gy);
+        us += check_micros() - t0;
+        if (outcome == EXPLORE_NONE) {
+            break;
+        }
+
+        //Every goal has to be somewhere the robot fits and can get to
+        int node = plan_nodeAt(gx, gy);
+        CHECK(node >= 0);
+        CHECK(!plan_isBlocked(node));
+
+        robot.theta = atan2f(gy - robot.y, gx - robot.x);
+        robot.x = gx;
+        robot.y = gy;
+        sweepFrom(&robot);
+        sweeps++;
+        if (firstPost < 0 && postInView(&robot)) {
+            firstPost = sweeps;
+        }
+    }
+
+    printf("  %d sweeps, %.0f%% of the course mapped, posts first in view on sweep %d, %.0fus per update on the host\n",
+           sweeps, courseCovered() * 100.0f, firstPost, us / sweeps);
+    CHECK(sweeps < MAX_SWEEPS);
+    CHECK(firstPost > 0);
+    CHECK(courseCovered() > 0.8f);
+    return CHECK_DONE();
+}
@@ -0,0 +1,173 @@
+/**
+ * Host harness for the gap solver
+ * @file test_gap.c
+ *
+ * Objects are laid out by servo angle and range as findObjects() would list
+ * them, so where every edge lands on the floor is known. Each case works out
+ * the width it expects straight from those points and checks gap_solve()
+ * agrees, ranks what it keeps and drops what the robot won't fit through.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "gap.h"
+
+/// As Parking.c has it, cm
+#define ROBOT_WIDTH 35
+
+/**
+ * Width across the line from the robot to the middle of the gap between two edge points, worked out here rather than
+ * taken from the solver: the chord times the sine of the angle between it and the approach
+ */
+static float expectedCorridor(int rightDeg, int rightDist, int leftDeg, int leftDist) {
+    float ax, ay, bx, by;
+    gap_toPoint(rightDeg, rightDist, &ax, &ay);
+    gap_toPoint(leftDeg, leftDist, &bx, &by);
+    float chord = atan2f(by - ay, bx - ax);
+    float approach = atan2f((ay + by) / 2, (ax + bx) / 2);
+    return sqrtf((bx - ax) * (bx - ax) + (by - ay) * (by - ay)) * fabsf(sinf(chord - approach));
+}
+
+static void testHeadOn(void) {
+    //Two posts 150cm out either side of straight ahead, 78cm apart
+    gap_object_t objs[2] = {{70, 75, 150}, {105, 110, 150}};
+    gap_t gaps[GAP_MAX];
+
+    int n = gap_solve(objs, 2, ROBOT_WIDTH, gaps);
+    CHECK(n == 1);
+    CHECK(gaps[0].right == 0 && gaps[0].left == 1);
+    CHECK(gaps[0].bearing == 0);
+    CHECK(abs(gaps[0].distance_cm - 145) <= 1);
+    //Square on, the corridor is the whole chord
+    CHECK(abs(gaps[0].corridor_cm - gaps[0].width_cm) <= 1);
+    CHECK(abs(gaps[0].width_cm - 78) <= 1);
+    CHECK(gaps[0].margin_cm == gaps[0].corridor_cm - ROBOT_WIDTH);
+    printf("  head on: width %d corridor %d margin %d\n", gaps[0].width_cm, gaps[0].corridor_cm, gaps[0].margin_cm);
+}
+
+static void testOblique(void) {
+    //A near object on the right and a far one on the left. Edge to edge is a long way, but most of it runs along the
+    //way we'd come at it
+    gap_object_t objs[2] = {{30, 40, 60}, {70, 80, 160}};
+    gap_t gap;
+
+    gap_measure(&objs[0], &objs[1], ROBOT_WIDTH, &gap);
+    float expected = expectedCorridor(40, 60, 70, 160);
+    CHECK(fabsf(gap.corridor_cm - expected) <= 1.0f);
+    CHECK(gap.corridor_cm < gap.width_cm * 2 / 3);
+    printf("  oblique: width %d corridor %d (%.1f expected)\n", gap.width_cm, gap.corridor_cm, expected);
+
+    //The chord alone would fit the robot, the corridor doesn't
+    gap_t gaps[GAP_MAX];
+    gap_object_t narrow[2] = {{30, 40, 40}, {75, 80, 120}};
+    gap_measure(&narrow[0], &narrow[1], ROBOT_WIDTH, &gap);
+    CHECK(gap.width_cm - ROBOT_WIDTH >= GAP_MIN_MARGIN_CM);
+    CHECK(gap.margin_cm < GAP_MIN_MARGIN_CM);
+    CHECK(gap_solve(narrow, 2, ROBOT_WIDTH, gaps) == 0);
+}
+
+static void testLaneIntrusion(void) {
+    //The head on gap again, with something close in on the left that's beside it by angle but in the lane by
+    //position. Its nearest point to the lane is its right edge, 45cm out at 125 degrees
+    gap_object_t objs[3] = {{70, 75, 150}, {105, 110, 150}, {125, 130, 45}};
+    gap_t gaps[GAP_MAX];
+    float px, py;
+    int i;
+    gap_toPoint(125, 45, &px, &py);
+
+    int n = gap_solve(objs, 3, ROBOT_WIDTH, gaps);
+    CHECK(n == 1);
+    CHECK(gaps[0].right == 0 && gaps[0].left == 1);
+    CHECK(abs(gaps[0].margin_cm - ((int)(2 * py) - ROBOT_WIDTH)) <= 1);
+    CHECK(gaps[0].margin_cm < gaps[0].corridor_cm - ROBOT_WIDTH);
+    int squeezed = gaps[0].margin_cm;
+
+    //Past the gap it's no longer in the way, though it now makes a gap of its own with the left post
+    objs[2].dist_cm = 250;
+    n = gap_solve(objs, 3, ROBOT_WIDTH, gaps);
+    CHECK(n >= 1);
+    int found = 0;
+    for (i = 0; i < n; i++) {
+        if (gaps[i].right == 0) {
+            CHECK(gaps[i].margin_cm == gaps[i].corridor_cm - ROBOT_WIDTH);
+            found = 1;
+        }
+    }
+    CHECK(found);
+    printf("  lane intrusion: margin %d with it in the lane\n", squeezed);
+
+    //Far enough in that the robot no longer fits
+    gap_object_t tight[3] = {{70, 75, 150}, {105, 110, 150}, {105, 125, 30}};
+    CHECK(gap_solve(tight, 3, ROBOT_WIDTH, gaps) == 0);
+}
+
+static void testRanking(void) {
+    //Right to left, five gaps of all sorts with one too narrow to keep
+    gap_object_t objs[6] = {
+        {0, 10, 120},
+        {35, 45, 120},      //0-1: 25 degrees at 120cm
+        {60, 70, 120},      //1-2: 15 degrees, too narrow
+        {85, 95, 200},      //2-3: uneven ranges
+        {110, 120, 80},
+        {156, 170, 80},     //4-5: 36 degrees at 80cm
+    };
+    gap_t gaps[GAP_MAX];
+    int i;
+
+    int n = gap_solve(objs, 6, ROBOT_WIDTH, gaps);
+    CHECK(n >= 2);
+    for (i = 0; i < n; i++) {
+        CHECK(gaps[i].margin_cm >= GAP_MIN_MARGIN_CM);
+        CHECK(gaps[i].left == gaps[i].right + 1);
+        CHECK(gaps[i].right != 1);
+        if (i > 0) {
+            CHECK(gaps[i - 1].margin_cm > gaps[i].margin_cm ||
+                  (gaps[i - 1].margin_cm == gaps[i].margin_cm && gaps[i - 1].distance_cm <= gaps[i].distance_cm));
+        }
+    }
+    printf("  ranking: %d gaps kept of 5, best %d-%d margin %d\n", n, gaps[0].right, gaps[0].left, gaps[0].margin_cm);
+
+    //Two gaps with the same room to spare, 200cm and 100cm out. The far one is listed first, the near one is put
+    //ahead of it
+    gap_object_t twins[4] = {{30, 40, 200}, {54, 60, 200}, {70, 79, 100}, {107, 115, 100}};
+    gap_t far, near;
+    gap_measure(&twins[0], &twins[1], ROBOT_WIDTH, &far);
+    gap_measure(&twins[2], &twins[3], ROBOT_WIDTH, &near);
+    CHECK(far.margin_cm == near.margin_cm);
+    n = gap_solve(twins, 4, ROBOT_WIDTH, gaps);
+    CHECK(n >= 2);
+    CHECK(gaps[0].right == 2 && gaps[1].right == 0);
+    CHECK(gaps[0].distance_cm < gaps[1].distance_cm);
+}
+
+static void testRejected(void) {
+    gap_t gaps[GAP_MAX];
+
+    //Edges that overlap by angle leave no way through however far apart they are
+    gap_object_t overlap[2] = {{60, 100, 50}, {95, 120, 200}};
+    CHECK(gap_solve(overlap, 2, ROBOT_WIDTH, gaps) == 0);
+
+    //An object with no range says nothing about where its edges are
+    gap_object_t unknown[2] = {{40, 50, 0}, {130, 140, 100}};
+    CHECK(gap_solve(unknown, 2, ROBOT_WIDTH, gaps) == 0);
+
+    //Just under and just over the margin, 150cm out
+    gap_object_t under[2] = {{70, 75, 150}, {90, 95, 150}};
+    gap_object_t over[2] = {{70, 75, 150}, {92, 95, 150}};
+    gap_measure(&under[0], &under[1], ROBOT_WIDTH, &gaps[0]);
+    CHECK(gaps[0].margin_cm < GAP_MIN_MARGIN_CM);
+    CHECK(gap_solve(under, 2, ROBOT_WIDTH, gaps) == 0);
+    gap_measure(&over[0], &over[1], ROBOT_WIDTH, &gaps[0]);
+    CHECK(gaps[0].margin_cm >= GAP_MIN_MARGIN_CM);
+    CHECK(gap_solve(over, 2, ROBOT_WIDTH, gaps) == 1);
+}
+
+int main(void) {
+    testHeadOn();
+    testOblique();
+    testLaneIntrusion();
+    testRanking();
+    testRejected();
+    return CHECK_DONE();
+}
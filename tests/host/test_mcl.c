@@ -0,0 +1,217 @@
+/**
+ * Host harness for course localization
+ * @file test_mcl.c
+ *
+ * Drives a simulated robot from the start area towards the parking zone on
+ * the course Parking.c describes. The wheels feed odometry.c through encoder
+ * counts with one wheel reading a little long, so dead reckoning drifts the
+ * way it does on the floor. Every 300mm a sweep reports the posts in PING
+ * range with noise, and odometry is knocked about by the sort of corrections
+ * the scan matcher and landmark filter make, which MCL must not mistake for
+ * motion. At the end of each run the zone goal is worked out the way
+ * aimForZone() does and handed to the planner.
+ */
+
+#include <math.h>
+#include "check.h"
+#include "grid.h"
+#include "mcl.h"
+#include "odometry.h"
+#include "plan.h"
+
+#define SIM_PI 3.14159265f
+
+/// As laid out in Parking.c
+static const mcl_field_t course = {0, 0, 4270, 2440, 4, {3500, 3900, 3500, 3900}, {1020, 1020, 1420, 1420}};
+static const pose_t courseStart = {.x = 300, .y = 1220, .theta = 0};
+
+/// Posts further than this or behind the sensor aren't seen, mm
+#define SIM_PING_RANGE_MM 2500.0f
+/// Right wheel encoder reads this much long, which turns into heading drift
+#define SIM_RIGHT_SCALE 1.01f
+
+static uint32_t simSeed = 12345;
+
+/**
+ * Roughly unit normal noise for the simulation, kept apart from the filter's own generator
+ */
+static float simNoise(void) {
+    float sum = 0;
+    int i;
+    for (i = 0; i < 4; i++) {
+        simSeed = simSeed * 1664525u + 1013904223u;
+        sum += (simSeed >> 8) / (float)(1 << 24) - 0.5f;
+    }
+    return sum * 1.732f;
+}
+
+typedef struct {
+    pose_t truth;       // where the robot really is, course frame
+    float left;         // encoder distance so far, mm
+    float right;
+} sim_t;
+
+/**
+ * Move the robot forward while turning, and let odometry see the encoder counts
+ */
+static void simStep(sim_t *sim, float dist, float turn) {
+    float half = turn * ODOM_WHEEL_BASE_MM * 0.5f;
+    float mid = sim->truth.theta + turn * 0.5f;
+    sim->truth.x += dist * cosf(mid);
+    sim->truth.y += dist * sinf(mid);
+    sim->truth.theta = odom_wrapAngle(sim->truth.theta + turn);
+
+    sim->left += dist - half;
+    sim->right += (dist + half) * SIM_RIGHT_SCALE;
+    odom_update((int16_t)(int32_t)(sim->left / ODOM_MM_PER_TICK), (int16_t)(int32_t)(sim->right / ODOM_MM_PER_TICK));
+}
+
+/**
+ * Report every post a sweep from here would pick out, and move the filter on
+ * @return number of posts seen
+ */
+static int simSweep(const sim_t *sim) {
+    pose_t raw;
+    int i;
+    int seen = 0;
+
+    odom_getRawPose(&raw);
+    mcl_predict(&raw);
+    for (i = 0; i < course.numPosts; i++) {
+        float dx = course.postX[i] - sim->truth.x;
+        float dy = course.postY[i] - sim->truth.y;
+        float range = sqrtf(dx * dx + dy * dy);
+        float bearing = odom_wrapAngle(atan2f(dy, dx) - sim->truth.theta);
+        if (range > SIM_PING_RANGE_MM || fabsf(bearing) > SIM_PI / 2) {
+            continue;
+        }
+        mcl_observePost(range + 30.0f * simNoise(), bearing + 2.0f * DEG_TO_RAD * simNoise());
+        seen++;
+    }
+    mcl_update();
+    return seen;
+}
+
+/**
+ * The zone goal in the odometry frame, worked out from the filter the same way aimForZone() does
+ */
+static void zoneGoal(const mcl_estimate_t *est, float *gx, float *gy) {
+    pose_t now;
+    int i;
+    float zoneX = 0;
+    float zoneY = 0;
+    for (i = 0; i < course.numPosts; i++) {
+        zoneX += course.postX[i];
+        zoneY += course.postY[i];
+    }
+    zoneX = zoneX / course.numPosts - est->pose.x;
+    zoneY = zoneY / course.numPosts - est->pose.y;
+
+    odom_getPose(&now);
+    float rot = now.theta - est->pose.theta;
+    *gx = now.x + cosf(rot) * zoneX - sinf(rot) * zoneY;
+    *gy = now.y + sinf(rot) * zoneX + cosf(rot) * zoneY;
+}
+
+typedef struct {
+    float posErr;       // mm between the estimate and the truth at the end of the run
+    float headingErr;   // radians, absolute
+    float goalErr;      // mm between the zone goal and where the zone really is
+    int localizedAt;    // mm driven before the spread fell under 15cm, -1 if it never did
+    int goalSet;        // 1 if the planner took the zone goal and found a route to it
+    double us;          // host time per sweep
+} run_t;
+
+/**
+ * One run from a start somewhere in the start area towards the zone
+ */
+static run_t simRun(float x, float y, float theta) {
+    sim_t sim = {.truth = {.x = x, .y = y, .theta = theta}, .left = 0, .right = 0};
+    run_t run = {.localizedAt = -1};
+    mcl_estimate_t est;
+    pose_t start, now;
+    int sweeps = 0;
+    int i;
+
+    //A jump back to zero counts is thrown away as a corrupt packet, which reseeds the encoders
+    odom_update(0, 0);
+    odom_reset(0, 0, 0);
+    odom_getRawPose(&start);
+    mcl_initAround(&course, &start, &courseStart, 250, 0.3);
+    grid_clear();
+    plan_refreshCosts();
+
+    //Head for the near side of the zone, weaving a little, sweeping every 300mm
+    for (i = 1; i <= 80; i++) {
+        float aim = atan2f(1220 - sim.truth.y, 3000 - sim.truth.x) + 0.15f * sinf(i * 0.2f);
+        simStep(&sim, 30.0f, 0.3f * odom_wrapAngle(aim - sim.truth.theta));
+        if (i % 10 != 0) {
+            continue;
+        }
+
+        double t0 = check_micros();
+        simSweep(&sim);
+        run.us += check_micros() - t0;
+        sweeps++;
+
+        //Scan match and landmark corrections shift odometry about without the robot moving
+        odom_correct(50.0f * simNoise(), 50.0f * simNoise(), 0.02f * simNoise(), 2500, 0.001f);
+
+        mcl_getEstimate(&est);
+        if (run.localizedAt < 0 && est.pose.cov[0][0] + est.pose.cov[1][1] < 150.0f * 150.0f) {
+            run.localizedAt = i * 30;
+        }
+    }
+    run.us /= sweeps;
+
+    mcl_getEstimate(&est);
+    float ex = est.pose.x - sim.truth.x;
+    float ey = est.pose.y - sim.truth.y;
+    run.posErr = sqrtf(ex * ex + ey * ey);
+    run.headingErr = fabsf(odom_wrapAngle(est.pose.theta - sim.truth.theta));
+
+    //Where the zone really is in the odometry frame, carried over from the truth the same way
+    odom_getPose(&now);
+    float rot = now.theta - sim.truth.theta;
+    float zx = 3700 - sim.truth.x;
+    float zy = 1220 - sim.truth.y;
+    float wantX = now.x + cosf(rot) * zx - sinf(rot) * zy;
+    float wantY = now.y + sinf(rot) * zx + cosf(rot) * zy;
+
+    float gx, gy;
+    plan_path_t path;
+    zoneGoal(&est, &gx, &gy);
+    run.goalErr = sqrtf((gx - wantX) * (gx - wantX) + (gy - wantY) * (gy - wantY));
+    run.goalSet = plan_dstarSetGoal(gx, gy) == PLAN_OK && plan_dstarReplan(now.x, now.y, &path) == PLAN_OK && path.length > 1;
+    return run;
+}
+
+int main(void) {
+    int i;
+    int runs = 20;
+    float sumPos = 0, worstPos = 0, sumHeading = 0, worstHeading = 0, worstGoal = 0;
+    double us = 0;
+
+    for (i = 0; i < runs; i++) {
+        //Put down anywhere in the start area, within the spread Parking.c starts the filter with
+        run_t run = simRun(courseStart.x + 150.0f * simNoise(), courseStart.y + 150.0f * simNoise(), 0.15f * simNoise());
+        CHECK(run.localizedAt > 0);
+        CHECK(run.goalSet);
+        CHECK(run.posErr < 150.0f);
+        CHECK(run.goalErr < 200.0f);
+        sumPos += run.posErr;
+        sumHeading += run.headingErr;
+        worstPos = run.posErr > worstPos ? run.posErr : worstPos;
+        worstHeading = run.headingErr > worstHeading ? run.headingErr : worstHeading;
+        worstGoal = run.goalErr > worstGoal ? run.goalErr : worstGoal;
+        us += run.us;
+    }
+
+    //Replaying the odometry corrections as motion roughly doubles this
+    CHECK(sumPos / runs < 60.0f);
+
+    printf("  %d runs of 2.4m: off by %.0fmm (worst %.0fmm) and %.1fdeg (worst %.1fdeg), zone goal worst %.0fmm out\n",
+           runs, sumPos / runs, worstPos, sumHeading / runs / DEG_TO_RAD, worstHeading / DEG_TO_RAD, worstGoal);
+    printf("  %.0fus per sweep on the host for predict, sightings and update\n", us / runs);
+    return CHECK_DONE();
+}
@@ -0,0 +1,247 @@
+/**
+ * Host harness for the grid path planner
+ * @file test_plan.c
+ *
+ * Builds small maps straight into the occupancy grid and checks the routes
+ * A* and D* Lite read off them.
+ */
+
+#include <stdio.h>
+#include "check.h"
+#include "grid.h"
+#include "plan.h"
+
+/**
+ * Mark a straight run of map cells as confidently occupied
+ */
+static void wall(float x0, float y0, float x1, float y1) {
+    int i;
+    int steps = 100;
+    for (i = 0; i <= steps; i++) {
+        int cx, cy;
+        if (!grid_worldToCell(x0 + (x1 - x0) * i / steps, y0 + (y1 - y0) * i / steps, &cx, &cy)) {
+            continue;
+        }
+        while (!grid_isOccupied(cx, cy)) {
+            grid_rayCast(cx, cy, cx, cy, 1);
+        }
+    }
+}
+
+/**
+ * A route runs from the robot's node to the goal's node through neighbouring nodes none of which are blocked
+ */
+static int routeOk(const plan_path_t *path, float sx, float sy, float gx, float gy) {
+    int i;
+    if (path->length < 1 || path->node[0] != plan_nodeAt(sx, sy) || path->node[path->length - 1] != plan_nodeAt(gx, gy)) {
+        return 0;
+    }
+    for (i = 0; i < path->length; i++) {
+        if (plan_isBlocked(path->node[i])) {
+            return 0;
+        }
+        if (i > 0) {
+            int dx = path->node[i] % PLAN_SIZE_X - path->node[i - 1] % PLAN_SIZE_X;
+            int dy = path->node[i] / PLAN_SIZE_X - path->node[i - 1] / PLAN_SIZE_X;
+            if (dx < -1 || dx > 1 || dy < -1 || dy > 1) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * The grid has to reach the parking zone at the far end of the course, and nothing behind the start
+ */
+static void testCoverage(void) {
+    int cx, cy;
+    float x, y;
+
+    CHECK(grid_worldToCell(0, 0, &cx, &cy));
+    CHECK(grid_worldToCell(3400, 0, &cx, &cy));
+    CHECK(grid_worldToCell(3970, 1200, &cx, &cy));
+    CHECK(grid_worldToCell(-300, -1200, &cx, &cy));
+    CHECK(!grid_worldToCell(-600, 0, &cx, &cy));
+
+    //Nodes and cells agree on where the origin is
+    plan_nodeToWorld(plan_nodeAt(20, 20), &x, &y);
+    CHECK(x == PLAN_CELL_MM / 2 && y == PLAN_CELL_MM / 2);
+    plan_nodeToWorld(plan_nodeAt(-20, -20), &x, &y);
+    CHECK(x == -PLAN_CELL_MM / 2 && y == -PLAN_CELL_MM / 2);
+
+    grid_clear();
+    plan_refreshCosts();
+    CHECK(plan_dstarSetGoal(3400, 0) == PLAN_OK);
+    CHECK(plan_dstarSetGoal(6000, 0) == PLAN_OFF_MAP);
+}
+
+/**
+ * With nothing known, the whole course is one long straight route
+ */
+static void testOpenCourse(void) {
+    plan_path_t path;
+    plan_stats_t stats;
+
+    grid_clear();
+    plan_refreshCosts();
+    CHECK(plan_astar(0, 0, 3400, 0, &path) == PLAN_OK);
+    CHECK(routeOk(&path, 0, 0, 3400, 0));
+    CHECK(path.cost == (uint32_t)(path.length - 1) * PLAN_COST_UNKNOWN);
+
+    CHECK(plan_dstarSetGoal(3400, 0) == PLAN_OK);
+    CHECK(plan_dstarReplan(0, 0, &path) == PLAN_OK);
+    plan_getStats(&stats);
+    CHECK(routeOk(&path, 0, 0, 3400, 0));
+    CHECK(stats.openPeak <= PLAN_OPEN_MAX);
+    printf("  open course, D* Lite: %u expanded, open list peak %u of %d\n",
+           (unsigned)stats.expanded, stats.openPeak, PLAN_OPEN_MAX);
+
+    //Corner to corner is the longest search the course can ask for
+    CHECK(plan_dstarSetGoal(3900, 1200) == PLAN_OK);
+    CHECK(plan_dstarReplan(-300, -1200, &path) == PLAN_OK);
+    CHECK(routeOk(&path, -300, -1200, 3900, 1200));
+}
+
+/**
+ * A wall across the course with one gap in it has to be gone around through the gap
+ */
+static void testGap(void) {
+    plan_path_t path;
+    int i;
+
+    grid_clear();
+    wall(1500, -1600, 1500, 300);
+    wall(1500, 900, 1500, 1600);
+    plan_refreshCosts();
+
+    CHECK(plan_astar(0, 0, 3000, 0, &path) == PLAN_OK);
+    CHECK(routeOk(&path, 0, 0, 3000, 0));
+
+    int crossed = 0;
+    for (i = 0; i < path.length; i++) {
+        float x, y;
+        plan_nodeToWorld(path.node[i], &x, &y);
+        if (x > 1400 && x < 1600) {
+            crossed = 1;
+            CHECK(y > 300 + PLAN_INFLATE_MM - PLAN_CELL_MM && y < 900 - PLAN_INFLATE_MM + PLAN_CELL_MM);
+        }
+    }
+    CHECK(crossed);
+
+    //Close the gap too and there's no way through at all
+    wall(1500, 300, 1500, 900);
+    plan_refreshCosts();
+    CHECK(plan_astar(0, 0, 3000, 0, &path) == PLAN_NO_PATH);
+}
+
+/**
+ * D* Lite repairs its search when the map changes under the route, and ends up as good as planning from scratch
+ */
+static void testReplan(void) {
+    plan_path_t path, fresh;
+    plan_stats_t stats;
+    double t0, repairUs, scratchUs;
+
+    grid_clear();
+    wall(1200, -1600, 1200, -400);
+    plan_refreshCosts();
+    CHECK(plan_dstarSetGoal(3000, 0) == PLAN_OK);
+    CHECK(plan_dstarReplan(0, 0, &path) == PLAN_OK);
+    CHECK(routeOk(&path, 0, 0, 3000, 0));
+
+    //Drive a little way along, then find the route blocked
+    float sx, sy;
+    plan_nodeToWorld(path.node[4], &sx, &sy);
+    wall(2000, -600, 2000, 700);
+    CHECK(plan_refreshCosts() > 0);
+
+    t0 = check_micros();
+    CHECK(plan_dstarReplan(sx, sy, &path) == PLAN_OK);
+    repairUs = check_micros() - t0;
+    plan_getStats(&stats);
+    CHECK(routeOk(&path, sx, sy, 3000, 0));
+    uint32_t repaired = stats.expanded;
+
+    t0 = check_micros();
+    CHECK(plan_astar(sx, sy, 3000, 0, &fresh) == PLAN_OK);
+    scratchUs = check_micros() - t0;
+    plan_getStats(&stats);
+    CHECK(path.cost == fresh.cost);
+    //Everything between the robot and the new wall is searched twice over, but what's around the goal is kept
+    CHECK(repaired < stats.expanded);
+    printf("  repair after a new wall: D* Lite %u expanded (%.0fus), A* from scratch %u expanded (%.0fus)\n",
+           (unsigned)repaired, repairUs, (unsigned)stats.expanded, scratchUs);
+}
+
+/**
+ * Drive to the goal a sweep at a time, replanning after every sweep, and find the route blocked on the way
+ * @param incremental 1 to repair the D* Lite search, 0 to plan from scratch with A* every sweep
+ * @param expanded set to the nodes expanded over the whole drive
+ * @return host time spent planning, us
+ */
+static double drive(int incremental, uint32_t *expanded) {
+    plan_path_t path;
+    plan_stats_t stats;
+    float x = 0;
+    float y = 0;
+    double us = 0;
+    int sweep;
+
+    *expanded = 0;
+    grid_clear();
+    wall(1200, -1600, 1200, -400);
+    CHECK(!incremental || plan_dstarSetGoal(3000, 0) == PLAN_OK);
+    for (sweep = 0; sweep < 40; sweep++) {
+        if (sweep == 2) {
+            wall(2000, -600, 2000, 700);
+        }
+        plan_refreshCosts();
+
+        double t0 = check_micros();
+        int outcome = incremental ? plan_dstarReplan(x, y, &path) : plan_astar(x, y, 3000, 0, &path);
+        us += check_micros() - t0;
+        plan_getStats(&stats);
+        *expanded += stats.expanded;
+        CHECK(outcome == PLAN_OK && routeOk(&path, x, y, 3000, 0));
+        if (outcome != PLAN_OK || path.length <= 3) {
+            break;
+        }
+
+        //Sweeps are 300mm apart
+        plan_nodeToWorld(path.node[3], &x, &y);
+    }
+    CHECK(sweep < 40);
+    return us;
+}
+
+/**
+ * Over a whole drive, repairing the search after each sweep has to cost less than starting over each sweep
+ */
+static void testDrive(void) {
+    uint32_t dstarExpanded, astarExpanded;
+    double dstarUs = 1e9;
+    double astarUs = 1e9;
+    int i;
+
+    //Best of a few, the host has other things to do
+    for (i = 0; i < 5; i++) {
+        double us = drive(1, &dstarExpanded);
+        dstarUs = us < dstarUs ? us : dstarUs;
+        us = drive(0, &astarExpanded);
+        astarUs = us < astarUs ? us : astarUs;
+    }
+    CHECK(dstarExpanded < astarExpanded);
+    CHECK(dstarUs < astarUs);
+    printf("  drive past the new wall, replanning every 300mm: D* Lite %u expanded (%.0fus), A* %u expanded (%.0fus)\n",
+           (unsigned)dstarExpanded, dstarUs, (unsigned)astarExpanded, astarUs);
+}
+
+int main(void) {
+    testCoverage();
+    testOpenCourse();
+    testGap();
+    testReplan();
+    testDrive();
+    return CHECK_DONE();
+}
@@ -0,0 +1,120 @@
+/**
+ * Host harness for the correlative scan matcher
+ * @file test_scanmatch.c
+ *
+ * Sweeps are simulated by casting PING rays into a small walled area with a
+ * box and a jog in it. A map is built from sweeps at known poses, then a
+ * sweep taken with odometry off by a known error has to be pulled back.
+ */
+
+#include <math.h>
+#include "check.h"
+#include "grid.h"
+#include "scanmatch.h"
+#include "simsweep.h"
+
+/// The simulated world, line segments in mm
+static const float walls[][4] = {
+    {-400, -900, 2200, -900},
+    {2200, -900, 2200, 1000},
+    {2200, 1000, -400, 1000},
+    {-400, 1000, -400, -900},
+    {1200, 300, 1500, 300},
+    {1500, 300, 1500, 600},
+    {1500, 600, 1200, 600},
+    {1200, 600, 1200, 300},
+    {700, -900, 700, -550},
+    {700, -550, 950, -550},
+};
+#define NUM_WALLS ((int)(sizeof(walls) / sizeof(walls[0])))
+
+static pose_t pose(float x, float y, float thetaDeg) {
+    pose_t p = {.x = x, .y = y, .theta = thetaDeg * DEG_TO_RAD};
+    return p;
+}
+
+/**
+ * Map the area from a spread of poses and headings, the way the grid fills in over a run
+ */
+static void buildMap(void) {
+    int scan[181][2];
+    int i;
+    int j;
+
+    //Every map cell needs two hits to count as occupied, so it takes a few passes
+    grid_clear();
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < 12; i++) {
+            pose_t p = pose(100.0f * (i % 8), 100.0f * (i % 3) - 100, 30.0f * i);
+            sim_sweep(&p, scan);
+            grid_addSweep(scan, &p);
+        }
+    }
+}
+
+/**
+ * A sweep taken at truth but believed to be at truth plus an odometry error
+ * @return 1 if the match was accepted and put the pose back within a cell and one and a half steps of the truth
+ */
+static int recovers(pose_t truth, float ex, float ey, float etDeg, double *us) {
+    int scan[181][2];
+    match_result_t match;
+    pose_t odom = pose(truth.x + ex, truth.y + ey, truth.theta / DEG_TO_RAD + etDeg);
+
+    sim_sweep(&truth, scan);
+    double t0 = check_micros();
+    int ok = match_sweep(scan, &odom, &match);
+    if (us) {
+        *us = check_micros() - t0;
+    }
+    if (!ok) {
+        return 0;
+    }
+    float dx = odom.x + match.dx - truth.x;
+    float dy = odom.y + match.dy - truth.y;
+    float dt = (odom.theta + match.dtheta - truth.theta) / DEG_TO_RAD;
+    return fabsf(dx) <= GRID_CELL_MM && fabsf(dy) <= GRID_CELL_MM && fabsf(dt) <= 1.5f * MATCH_ANGLE_STEP_DEG;
+}
+
+int main(void) {
+    int scan[181][2];
+    match_result_t match;
+    double us, worst = 0;
+    int i;
+
+    //Nothing mapped yet, nothing to match against
+    sim_setWorld(walls, NUM_WALLS);
+    grid_clear();
+    pose_t start = pose(0, 0, 0);
+    sim_sweep(&start, scan);
+    CHECK(!match_sweep(scan, &start, &match));
+    CHECK(match.echoes >= MATCH_MIN_ECHOES);
+
+    buildMap();
+
+    //Odometry already right, the match should leave it there
+    pose_t here = pose(600, 150, 5);
+    sim_sweep(&here, scan);
+    CHECK(match_sweep(scan, &here, &match));
+    CHECK(fabsf(match.dx) <= GRID_CELL_MM && fabsf(match.dy) <= GRID_CELL_MM);
+    CHECK(fabsf(match.dtheta) <= MATCH_ANGLE_STEP_DEG * DEG_TO_RAD);
+
+    //Heading drift from turns and a little slip, well inside the window
+    CHECK(recovers(pose(600, 150, 5), 0, 0, 4, &us));
+    CHECK(recovers(pose(600, 150, 5), 0, 0, -5, &us));
+    CHECK(recovers(pose(800, -50, -15), 70, -60, 3, &us));
+    CHECK(recovers(pose(200, 300, 40), -90, 40, -4, &us));
+
+    //An error bigger than the window can't be trusted, better no correction than a wrong one
+    CHECK(!recovers(pose(600, 150, 5), 0, 0, 14, NULL));
+    CHECK(!recovers(pose(600, 150, 5), 400, 0, 0, NULL));
+
+    for (i = 0; i < 20; i++) {
+        recovers(pose(600, 150, 5), 60, -40, 3, &us);
+        if (us > worst) {
+            worst = us;
+        }
+    }
+    printf("  match_sweep: worst %.0fus on the host over 20 runs, %d echoes\n", worst, match.echoes);
+    return CHECK_DONE();
+}
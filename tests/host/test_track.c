@@ -0,0 +1,220 @@
+/**
+ * Host harness for the object tracker
+ * @file test_track.c
+ *
+ * Objects are put down in the odometry frame and seen from a pose the way
+ * findObjects() would list them: centre servo angle on the even degrees,
+ * PING range to the near face and width. Each case moves the robot or the
+ * objects between sweeps and checks which IDs come back.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "track.h"
+
+/// An object on the floor, mm and cm
+typedef struct {
+    float x;
+    float y;
+    int width_cm;
+} thing_t;
+
+static int objects[TRACK_MAX_DETECTIONS][4];
+static int ids[TRACK_MAX_DETECTIONS];
+static int scan[181][2];
+
+/**
+ * Fill scan[][] as a sweep that sampled every even angle from lo to hi
+ */
+static void sweepCovers(int lo, int hi) {
+    int a;
+    for (a = 0; a <= 180; a++) {
+        scan[a][0] = (a % 2 == 0 && a >= lo && a <= hi) ? 200 : 0;
+        scan[a][1] = 0;
+    }
+}
+
+/**
+ * List the things in front of pose as findObjects() would, in the order given, and hand them to the tracker
+ * @return objects listed
+ */
+static int see(const pose_t *pose, const thing_t *things, int n) {
+    int i;
+    int numObjs = 0;
+    for (i = 0; i < n; i++) {
+        float dx = things[i].x - pose->x;
+        float dy = things[i].y - pose->y;
+        float bearing = odom_wrapAngle(atan2f(dy, dx) - pose->theta) / DEG_TO_RAD;
+        int angle = (int)floorf((bearing + 90.0f) / 2.0f + 0.5f) * 2;
+        if (angle < 0 || angle > 180) {
+            continue;
+        }
+        objects[numObjs][0] = angle;
+        objects[numObjs][1] = (int)(sqrtf(dx * dx + dy * dy) / 10.0f - things[i].width_cm / 2.0f + 0.5f);
+        objects[numObjs][2] = things[i].width_cm;
+        objects[numObjs][3] = 0;
+        numObjs++;
+    }
+    track_update(pose, scan, objects, numObjs, ids);
+    return numObjs;
+}
+
+static void testMove(void) {
+    thing_t things[3] = {{500, -200, 5}, {600, 150, 12}, {400, 350, 5}};
+    thing_t reversed[3] = {things[2], things[1], things[0]};
+    pose_t start = {.x = 0, .y = 0, .theta = 0};
+    int first[3];
+    int i;
+
+    track_clear();
+    sweepCovers(0, 180);
+    CHECK(see(&start, things, 3) == 3);
+    CHECK(track_count() == 3);
+    for (i = 0; i < 3; i++) {
+        CHECK(ids[i] > 0);
+        first[i] = ids[i];
+    }
+    CHECK(first[0] != first[1] && first[1] != first[2] && first[0] != first[2]);
+
+    //Forward and turned left, everything is at new angles and ranges and listed the other way round
+    pose_t moved = {.x = 200, .y = 50, .theta = 20 * DEG_TO_RAD};
+    CHECK(see(&moved, reversed, 3) == 3);
+    CHECK(track_count() == 3);
+    CHECK(ids[0] == first[2] && ids[1] == first[1] && ids[2] == first[0]);
+
+    //Smoothed towards each sighting, close to where they are
+    track_t t;
+    CHECK(track_find(first[1], &t));
+    CHECK(t.sightings == 2 && t.missed == 0);
+    CHECK(fabsf(t.x - things[1].x) < 40.0f && fabsf(t.y - things[1].y) < 40.0f);
+    CHECK(fabsf(t.width_cm - 12) < 0.01f);
+
+    //Where the tracker expects to see it from here agrees with where it is
+    int angle, dist;
+    CHECK(track_predict(&t, &moved, &angle, &dist));
+    CHECK(abs(angle - objects[1][0]) <= 2 && abs(dist - objects[1][1]) <= 3);
+    printf("  after a move: ids %d %d %d kept\n", ids[2], ids[1], ids[0]);
+}
+
+static void testGate(void) {
+    pose_t pose = {.x = 0, .y = 0, .theta = 0};
+    thing_t one = {600, 0, 5};
+    track_t t;
+
+    track_clear();
+    sweepCovers(0, 180);
+    see(&pose, &one, 1);
+    int id = ids[0];
+
+    //Nudged inside the gate it's the same object
+    one.y = TRACK_GATE_MM - 60;
+    see(&pose, &one, 1);
+    CHECK(ids[0] == id);
+
+    //Jumped well outside it, something new. The old track isn't seen where it was, so it counts a miss
+    one.y += TRACK_GATE_MM + 100;
+    see(&pose, &one, 1);
+    CHECK(ids[0] != id);
+    CHECK(track_count() == 2);
+    CHECK(track_find(id, &t) && t.missed == 1);
+
+    //Two detections inside one track's gate, the closer gets it and the other starts its own
+    track_clear();
+    thing_t pair[2] = {{600, 0, 5}, {600, 0, 5}};
+    see(&pose, pair, 1);
+    id = ids[0];
+    pair[0].y = 150;
+    pair[1].y = -40;
+    see(&pose, pair, 2);
+    CHECK(ids[1] == id);
+    CHECK(ids[0] != id && ids[0] > 0);
+    printf("  gating: %d tracks after a jump and a split\n", track_count());
+}
+
+static void testMisses(void) {
+    pose_t pose = {.x = 0, .y = 0, .theta = 0};
+    thing_t things[3] = {{500, 0, 5}, {1500, 300, 5}, {400, 300, 5}};
+    track_t t;
+    int i;
+
+    track_clear();
+    sweepCovers(0, 180);
+    see(&pose, things, 3);
+    int nearId = ids[0];
+    int farId = ids[1];
+    int leftId = ids[2];
+
+    //Gone from sweeps that covered where it was, one miss each, until it's dropped
+    for (i = 1; i < TRACK_MAX_MISSES; i++) {
+        see(&pose, things + 1, 2);
+        CHECK(track_find(nearId, &t) && t.missed == i);
+    }
+
+    //Seen again in time, it's forgiven
+    see(&pose, things, 3);
+    CHECK(ids[0] == nearId);
+    CHECK(track_find(nearId, &t) && t.missed == 0);
+
+    for (i = 0; i < TRACK_MAX_MISSES; i++) {
+        see(&pose, things + 1, 2);
+    }
+    CHECK(!track_find(nearId, &t));
+
+    //Too far for the IR threshold to pick out, or where the sweep didn't look, isn't a miss
+    sweepCovers(0, 100);
+    for (i = 0; i < TRACK_MAX_MISSES + 2; i++) {
+        see(&pose, things, 0);
+    }
+    CHECK(track_find(farId, &t) && t.missed == 0);
+    CHECK(track_find(leftId, &t) && t.missed == 0);
+
+    //Nor is anything behind the servo
+    pose_t turned = {.x = 0, .y = 0, .theta = M_PI};
+    sweepCovers(0, 180);
+    see(&turned, things, 0);
+    CHECK(track_find(leftId, &t) && t.missed == 0);
+    printf("  misses: %d tracks left\n", track_count());
+}
+
+static void testFull(void) {
+    pose_t pose = {.x = 0, .y = 0, .theta = 0};
+    thing_t things[TRACK_MAX + 1];
+    int first[TRACK_MAX];
+    track_t t;
+    int i;
+
+    //A ring of things further apart than the gate, all but the first seen twice. They're too far out to be missed
+    track_clear();
+    sweepCovers(0, 180);
+    for (i = 0; i <= TRACK_MAX; i++) {
+        float a = (i * 15 - 90) * DEG_TO_RAD;
+        things[i].x = 1300 * cosf(a);
+        things[i].y = 1300 * sinf(a);
+        things[i].width_cm = 5;
+    }
+    see(&pose, things, TRACK_MAX);
+    for (i = 0; i < TRACK_MAX; i++) {
+        first[i] = ids[i];
+    }
+    see(&pose, things + 1, TRACK_MAX - 1);
+    CHECK(track_count() == TRACK_MAX);
+
+    //No room for one more, it pushes out the least seen
+    see(&pose, things + TRACK_MAX, 1);
+    CHECK(ids[0] > 0);
+    CHECK(track_count() == TRACK_MAX);
+    CHECK(!track_find(first[0], &t));
+    for (i = 1; i < TRACK_MAX; i++) {
+        CHECK(track_find(first[i], &t));
+    }
+    printf("  full: id %d made room for id %d\n", first[0], ids[0]);
+}
+
+int main(void) {
+    testMove();
+    testGate();
+    testMisses();
+    testFull();
+    return CHECK_DONE();
+}
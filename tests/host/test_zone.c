@@ -0,0 +1,181 @@
+/**
+ * Host harness for the parking zone fit
+ * @file test_zone.c
+ *
+ * The course's four posts are put down in the odometry frame around a known
+ * zone centre, turned a little off the axes, with the robot off to one side.
+ * Each case feeds zone_addPost() a few jittered sightings of some of them,
+ * and maybe a post that isn't there, then checks the centre, which way
+ * zone_fit() says to drive in, and how sure it is.
+ */
+
+#include <math.h>
+#include "check.h"
+#include "zone.h"
+
+/// The layout as Parking.c gives it, a 400mm square
+static const int16_t layoutX[4] = {3500, 3900, 3500, 3900};
+static const int16_t layoutY[4] = {1020, 1020, 1420, 1420};
+
+/// Where the zone really is in the odometry frame, and the robot looking at it from the -x side
+#define ZONE_X 3400.0f
+#define ZONE_Y 300.0f
+#define ZONE_ROT 0.3f
+static const pose_t robot = {.x = 0, .y = 0, .theta = 0};
+
+/// Sightings are this far off at most, mm
+#define JITTER_MM 30.0f
+
+static float wrap(float a) {
+    while (a > M_PI) {
+        a -= 2 * M_PI;
+    }
+    while (a < -M_PI) {
+        a += 2 * M_PI;
+    }
+    return a;
+}
+
+/**
+ * Post i of the layout in the odometry frame
+ */
+static void truePost(int i, float *x, float *y) {
+    float lx = layoutX[i] - 3700.0f;
+    float ly = layoutY[i] - 1220.0f;
+    *x = ZONE_X + cosf(ZONE_ROT) * lx - sinf(ZONE_ROT) * ly;
+    *y = ZONE_Y + sinf(ZONE_ROT) * lx + cosf(ZONE_ROT) * ly;
+}
+
+/**
+ * Sight a point a few times, each a little off in a different direction
+ */
+static void sight(float x, float y, int times) {
+    int k;
+    for (k = 0; k < times; k++) {
+        float a = k * 2.4f;
+        zone_addPost(x + JITTER_MM * cosf(a), y + JITTER_MM * sinf(a));
+    }
+}
+
+/**
+ * Sight the posts whose bits are set in mask, each the given number of times
+ */
+static void sightPosts(int mask, int times) {
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (mask & (1 << i)) {
+            float x, y;
+            truePost(i, &x, &y);
+            sight(x, y, times);
+        }
+    }
+}
+
+/**
+ * The fit is centred on the zone and says to drive in square through the side facing the robot, from outside it
+ */
+static void checkFit(const zone_t *z) {
+    float ex = z->x - ZONE_X;
+    float ey = z->y - ZONE_Y;
+    CHECK(sqrtf(ex * ex + ey * ey) < 40.0f);
+    CHECK(fabsf(wrap(z->entryHeading - ZONE_ROT)) < 0.1f);
+
+    //The standoff is from the posts, which sit 200mm either side of the centre
+    float dx = z->x - z->entryX;
+    float dy = z->y - z->entryY;
+    CHECK(fabsf(sqrtf(dx * dx + dy * dy) - (200.0f + ZONE_STANDOFF_MM)) < 20.0f);
+}
+
+static void testAllPosts(void) {
+    zone_t z;
+    zone_init(layoutX, layoutY, 4);
+    CHECK(!zone_fit(&robot, &z));
+
+    sightPosts(0xF, ZONE_FULL_SIGHTINGS);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.matched == 4);
+    CHECK(z.confidence == 100);
+    printf("  all four posts: centre %.0f,%.0f heading %.2f confidence %d\n", z.x, z.y, z.entryHeading, z.confidence);
+}
+
+static void testMissingPosts(void) {
+    zone_t z;
+
+    //One of the far posts hidden behind the others
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0x7, ZONE_FULL_SIGHTINGS);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.matched == 3);
+    CHECK(z.confidence == 75);
+    printf("  three posts: centre %.0f,%.0f confidence %d\n", z.x, z.y, z.confidence);
+
+    //Glimpsed only once each, the fit holds but counts for less
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0xF, 1);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.confidence == 100 / ZONE_FULL_SIGHTINGS);
+
+    //A single post proposes nothing
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0x1, ZONE_FULL_SIGHTINGS);
+    CHECK(!zone_fit(&robot, &z));
+}
+
+static void testFalsePost(void) {
+    zone_t z;
+    float x, y;
+
+    //Something skinny 400mm from a real post, the layout's own spacing, so it proposes fits of its own
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0xF, ZONE_FULL_SIGHTINGS);
+    truePost(0, &x, &y);
+    sight(x - 400.0f, y, 1);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.matched == 4);
+
+    //Just outside where a real post should be, it mustn't drag the centre over
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0x7, ZONE_FULL_SIGHTINGS);
+    truePost(3, &x, &y);
+    sight(x + ZONE_INLIER_MM * 1.5f, y, ZONE_FULL_SIGHTINGS);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.matched == 3);
+    printf("  false posts: centre %.0f,%.0f matched %d\n", z.x, z.y, z.matched);
+}
+
+static void testTwoPosts(void) {
+    zone_t z;
+
+    //Only the pair facing the robot. The same pair fits a zone on either side of them, the one that's there is the
+    //one behind them, the robot would have seen posts on its own side
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0x5, ZONE_FULL_SIGHTINGS);
+    CHECK(zone_fit(&robot, &z));
+    checkFit(&z);
+    CHECK(z.matched == 2);
+    CHECK(z.confidence == 50);
+
+    //The same from the far side, where the other pair faces us
+    pose_t behind = {.x = 6000, .y = 1000, .theta = M_PI};
+    zone_init(layoutX, layoutY, 4);
+    sightPosts(0xA, ZONE_FULL_SIGHTINGS);
+    CHECK(zone_fit(&behind, &z));
+    float ex = z.x - ZONE_X;
+    float ey = z.y - ZONE_Y;
+    CHECK(sqrtf(ex * ex + ey * ey) < 40.0f);
+    CHECK(fabsf(wrap(z.entryHeading - ZONE_ROT - M_PI)) < 0.1f);
+    printf("  facing pair only: centre %.0f,%.0f confidence %d\n", z.x, z.y, z.confidence);
+}
+
+int main(void) {
+    testAllPosts();
+    testMissingPosts();
+    testFalsePost();
+    testTwoPosts();
+    return CHECK_DONE();
+}